@@ -0,0 +1,272 @@
+/**
+ *  Batched spectrum throughput per NUMA node as workers are
+ *  added, with each worker's arena (input, fft_batch buffers
+ *  and plans) local to its node or on another one.
+ *
+ *  For every node with CPUs and 1, 2, 4 ... workers on it,
+ *  workers are pinned to that node's CPUs and stream windows
+ *  from their own input buffer through fft_batch for
+ *  BENCH_SECONDS.  "local" arenas are first touched from the
+ *  worker's CPU, "remote" ones from a CPU of the next node, and
+ *  "unpinned" runs leave threads and memory to the kernel.  A
+ *  final set of rows runs the same per node count on every
+ *  node at once, which is what many-channel hosts do.
+**/
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "fft_batch.h"
+#include "placement.h"
+
+#define BENCH_SECONDS       1.0
+#define BENCH_FRAME         2048
+#define BENCH_HOP           1024
+#define BENCH_BATCH         64
+/* 16 MB of input per worker, well past any cache */
+#define BENCH_INPUT_SAMPLES (4u << 20)
+
+typedef enum
+{
+    ARENA_LOCAL     = 0,
+    ARENA_REMOTE    = 1,
+    ARENA_UNPINNED  = 2
+
+} bench_arena;
+
+typedef struct
+{
+    int cpu;
+    float *p_input;
+    fft_batch batch;
+    atomic_int *p_go;
+    unsigned long frames;
+    double seconds;
+    pthread_t thread;
+
+} bench_worker;
+
+static const char *arena_names[] = { "local", "remote", "unpinned" };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *worker_main(void *arg)
+{
+    bench_worker *w = (bench_worker *) arg;
+    unsigned long pos = 0, span = (unsigned long) (BENCH_BATCH - 1) * BENCH_HOP + BENCH_FRAME;
+    double t0;
+
+    if(w->cpu >= 0)
+    {
+        placement_pin_self(w->cpu, NULL);
+    }
+    while(!atomic_load(w->p_go))
+    {
+        /* Start together so the workers compete for memory */
+    }
+
+    t0 = now();
+    do
+    {
+        fft_batch_gather(&w->batch, w->p_input + pos, span, BENCH_HOP);
+        w->frames += fft_batch_execute(&w->batch);
+        pos += (unsigned long) BENCH_BATCH * BENCH_HOP;
+        if(pos + span > BENCH_INPUT_SAMPLES)
+        {
+            pos = 0;
+        }
+        w->seconds = now() - t0;
+    }
+    while(w->seconds < BENCH_SECONDS);
+
+    return NULL;
+}
+
+/**
+ *  Builds every worker's arena from touch_cpus[i] (or from
+ *  wherever this thread is, for -1), runs them on cpus[i] and
+ *  returns total frames per second, or -1 on failure
+**/
+static double run(const int *cpus, const int *touch_cpus, unsigned int count)
+{
+    unsigned int i, j, started = 0;
+    int b_pinned;
+    double rate = 0.0;
+    placement_saved saved;
+    atomic_int go;
+    bench_worker *p_workers = (bench_worker *) calloc(count, sizeof(bench_worker));
+    int ok = p_workers != NULL;
+
+    atomic_init(&go, 0);
+
+    for(i = 0; ok && i < count; ++i)
+    {
+        b_pinned = touch_cpus[i] >= 0 && placement_pin_self(touch_cpus[i], &saved) == 0;
+        p_workers[i].cpu = cpus[i];
+        p_workers[i].p_go = &go;
+        p_workers[i].p_input = (float *) malloc(sizeof(float) * BENCH_INPUT_SAMPLES);
+        ok = p_workers[i].p_input
+             && fft_batch_init(&p_workers[i].batch, BENCH_FRAME, BENCH_BATCH, FFTW_ESTIMATE) == 0;
+        for(j = 0; ok && j < BENCH_INPUT_SAMPLES; ++j)
+        {
+            p_workers[i].p_input[j] = (float) sin(0.01 * j + i);
+        }
+
+        if(b_pinned)
+        {
+            placement_restore_self(&saved);
+        }
+    }
+
+    for(i = 0; ok && i < count; ++i, ++started)
+    {
+        if(pthread_create(&p_workers[i].thread, NULL, worker_main, &p_workers[i]))
+        {
+            ok = 0;
+        }
+    }
+    atomic_store(&go, 1);
+    for(i = 0; i < started; ++i)
+    {
+        pthread_join(p_workers[i].thread, NULL);
+        rate += p_workers[i].frames / p_workers[i].seconds;
+    }
+
+    for(i = 0; p_workers && i < count; ++i)
+    {
+        fft_batch_close(&p_workers[i].batch);
+        free(p_workers[i].p_input);
+    }
+    free(p_workers);
+
+    return ok ? rate : -1.0;
+}
+
+/* The node after node that has CPUs, node itself if none */
+static int other_node(const placement_topology *topo, int node)
+{
+    unsigned int k;
+    int n;
+
+    for(k = 1; k < topo->num_nodes; ++k)
+    {
+        n = (int) ((node + k) % topo->num_nodes);
+        if(topo->node_cpus[n])
+        {
+            return n;
+        }
+    }
+
+    return node;
+}
+
+static void report(const char *nodes, const char *arena, unsigned int count, double rate, double base)
+{
+    if(rate < 0.0)
+    {
+        printf("%-6s %-9s %7u %14s\n", nodes, arena, count, "failed");
+        return;
+    }
+
+    printf("%-6s %-9s %7u %14.0f %12.0f %9.2fx\n", nodes, arena, count, rate, rate / count,
+           base > 0.0 ? rate / base : 1.0);
+}
+
+int main(void)
+{
+    placement_topology topo;
+    unsigned int count, i, k, per_node, busiest = 0;
+    int node, remote, a;
+    int cpus[PLACEMENT_MAX_CPUS], touch[PLACEMENT_MAX_CPUS];
+    double rate, base[3], base_all = 0.0;
+    char label[16];
+
+    if(placement_topology_read(&topo))
+    {
+        fprintf(stderr, "cannot read the CPU topology\n");
+        return 1;
+    }
+
+    printf("%u nodes, %u CPUs; %d point frames, %d per batch, %.1f s per row\n",
+           topo.num_nodes, topo.num_cpus, BENCH_FRAME, BENCH_BATCH, BENCH_SECONDS);
+    printf("%-6s %-9s %7s %14s %12s %10s\n", "node", "arena", "workers", "frames/s", "per worker", "scaling");
+
+    for(node = 0; (unsigned int) node < topo.num_nodes; ++node)
+    {
+        if(!topo.node_cpus[node])
+        {
+            continue;
+        }
+        busiest = topo.node_cpus[node] > busiest ? topo.node_cpus[node] : busiest;
+        remote = other_node(&topo, node);
+        snprintf(label, sizeof(label), "%d", node);
+
+        for(a = ARENA_LOCAL; a <= ARENA_UNPINNED; ++a)
+        {
+            if(a == ARENA_REMOTE && remote == node)
+            {
+                continue;
+            }
+
+            for(count = 1; ; count = count * 2 < topo.node_cpus[node] ? count * 2 : topo.node_cpus[node])
+            {
+                for(i = 0; i < count; ++i)
+                {
+                    cpus[i] = a == ARENA_UNPINNED ? -1 : placement_cpu(&topo, PLACEMENT_COMPACT, i, node);
+                    touch[i] = a == ARENA_LOCAL ? cpus[i]
+                             : a == ARENA_REMOTE ? placement_cpu(&topo, PLACEMENT_COMPACT, i, remote) : -1;
+                }
+
+                rate = run(cpus, touch, count);
+                if(count == 1)
+                {
+                    base[a] = rate;
+                }
+                report(label, arena_names[a], count, rate, base[a]);
+
+                if(count == topo.node_cpus[node])
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Every node at once, arenas local */
+    for(per_node = 1; topo.num_nodes > 1; per_node = per_node * 2 < busiest ? per_node * 2 : busiest)
+    {
+        for(count = 0, node = 0; (unsigned int) node < topo.num_nodes; ++node)
+        {
+            for(k = 0; k < per_node && k < topo.node_cpus[node]; ++k, ++count)
+            {
+                cpus[count] = touch[count] = placement_cpu(&topo, PLACEMENT_COMPACT, k, node);
+            }
+        }
+
+        /* Scaling against one worker's share of the first row */
+        rate = run(cpus, touch, count);
+        if(per_node == 1)
+        {
+            base_all = rate / count;
+        }
+        report("all", arena_names[ARENA_LOCAL], count, rate, base_all);
+
+        if(per_node == busiest)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ *  Compares a zero padded real FFT done the usual way (pad the
+ *  window to N and run fftw_plan_dft_r2c_1d) against the pruned
+ *  transform in pruned_fft.c, for a range of window / padded
+ *  sizes.  Also reports the largest difference between the two.
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "fftw3.h"
+#include "pruned_fft.h"
+
+#define BENCH_MIN_SECONDS   0.5
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    static const unsigned int sizes[][2] =
+    {
+        {   256,  8192 },
+        {  1024, 16384 },
+        {  1024, 65536 },
+        {  4096, 65536 },
+        { 16384, 65536 },
+    };
+    unsigned int s, i, M, N, iters;
+    double *p_window, *p_padded, t0, t_full, t_pruned, err, d;
+    fftw_complex *p_full, *p_out;
+    fftw_plan plan;
+    pruned_fft pruned;
+
+    printf("%8s %8s %14s %14s %8s %10s\n", "window", "padded", "full (us)", "pruned (us)", "speedup", "max err");
+
+    for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        M = sizes[s][0];
+        N = sizes[s][1];
+
+        p_window = (double *) fftw_malloc(sizeof(double) * M);
+        p_padded = (double *) fftw_malloc(sizeof(double) * N);
+        p_full = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * (N / 2 + 1));
+        p_out = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * (N / 2 + 1));
+
+        plan = fftw_plan_dft_r2c_1d(N, p_padded, p_full, FFTW_MEASURE);
+        if(pruned_fft_init(&pruned, M, N, FFTW_MEASURE) < 0)
+        {
+            fprintf(stderr, "pruned_fft_init failed for %u / %u\n", M, N);
+            return 1;
+        }
+
+        for(i = 0; i < M; ++i)
+        {
+            p_window[i] = sin(2 * M_PI * 0.123 * i) + 0.01 * (rand() / (double) RAND_MAX - 0.5);
+        }
+
+        /* Full transform, including the copy and padding */
+        iters = 0;
+        t0 = now();
+        do
+        {
+            memcpy(p_padded, p_window, sizeof(double) * M);
+            memset(p_padded + M, 0, sizeof(double) * (N - M));
+            fftw_execute(plan);
+            ++iters;
+        } while(now() - t0 < BENCH_MIN_SECONDS);
+        t_full = (now() - t0) / iters;
+
+        iters = 0;
+        t0 = now();
+        do
+        {
+            pruned_fft_execute(&pruned, p_window, p_out);
+            ++iters;
+        } while(now() - t0 < BENCH_MIN_SECONDS);
+        t_pruned = (now() - t0) / iters;
+
+        err = 0.0;
+        for(i = 0; i <= N / 2; ++i)
+        {
+            d = fabs(p_full[i][0] - p_out[i][0]) + fabs(p_full[i][1] - p_out[i][1]);
+            err = d > err ? d : err;
+        }
+
+        printf("%8u %8u %14.2f %14.2f %8.2f %10.2e\n", M, N, t_full * 1e6, t_pruned * 1e6,
+               t_full / t_pruned, err);
+
+        pruned_fft_close(&pruned);
+        fftw_destroy_plan(plan);
+        fftw_free(p_window);
+        fftw_free(p_padded);
+        fftw_free(p_full);
+        fftw_free(p_out);
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ *  Throughput and accuracy of every resampler preset for the
+ *  conversions fft_block meets in practice.  Input is pushed in
+ *  fft_block sized pieces of a 997 Hz sine at half scale;
+ *  accuracy is the SNR of the output against the ideal sine at
+ *  the output rate, once the filter has settled.
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "resampler.h"
+
+#define BENCH_MIN_SECONDS   0.5
+#define BENCH_BLOCK         512
+#define BENCH_TONE_HZ       997.0
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    static const unsigned int rates[][2] =
+    {
+        { 44100, 48000 },
+        { 48000, 44100 },
+        { 96000, 48000 },
+        { 16000, 48000 },
+        { 22050, 48000 },
+    };
+    static const char *names[] = { "fast", "medium", "best" };
+    unsigned int r, q;
+    unsigned long i, j, k, n, total_in, total_out;
+    double t0, seconds, t, e, err, sig;
+    float *p_in, *p_out;
+    resampler rs;
+
+    printf("%6s %6s %7s %5s %10s %14s %14s %9s\n", "in", "out", "preset", "taps", "delay (ms)",
+           "in (Msamp/s)", "out (Msamp/s)", "SNR (dB)");
+
+    for(r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r)
+    {
+        for(q = RESAMPLER_FAST; q <= RESAMPLER_BEST; ++q)
+        {
+            if(resampler_init(&rs, rates[r][0], rates[r][1], (resampler_quality) q, BENCH_BLOCK) < 0)
+            {
+                fprintf(stderr, "resampler_init failed for %u -> %u\n", rates[r][0], rates[r][1]);
+                return 1;
+            }
+
+            /* One second of input, replayed for timing */
+            p_in = (float *) malloc(sizeof(float) * rates[r][0]);
+            p_out = (float *) malloc(sizeof(float) * resampler_max_out(&rs, BENCH_BLOCK));
+            for(i = 0; i < rates[r][0]; ++i)
+            {
+                p_in[i] = (float) (0.5 * sin(2 * M_PI * BENCH_TONE_HZ * i / rates[r][0]));
+            }
+
+            /* Accuracy over the first second */
+            err = 0.0;
+            sig = 0.0;
+            for(i = 0, k = 0; i + BENCH_BLOCK <= rates[r][0]; i += BENCH_BLOCK)
+            {
+                n = resampler_process(&rs, p_in + i, BENCH_BLOCK, p_out);
+                for(j = 0; j < n; ++j, ++k)
+                {
+                    if(k < 4 * rs.delay)
+                    {
+                        continue;
+                    }
+                    t = (k - rs.delay) / rates[r][1];
+                    e = p_out[j] - 0.5 * sin(2 * M_PI * BENCH_TONE_HZ * t);
+                    err += e * e;
+                    sig += 0.125;
+                }
+            }
+
+            /* Throughput */
+            resampler_reset(&rs);
+            total_in = 0;
+            total_out = 0;
+            t0 = now();
+            do
+            {
+                for(i = 0; i + BENCH_BLOCK <= rates[r][0]; i += BENCH_BLOCK)
+                {
+                    total_out += resampler_process(&rs, p_in + i, BENCH_BLOCK, p_out);
+                    total_in += BENCH_BLOCK;
+                }
+            } while((seconds = now() - t0) < BENCH_MIN_SECONDS);
+
+            printf("%6u %6u %7s %5u %10.3f %14.1f %14.1f %9.1f\n", rates[r][0], rates[r][1], names[q], rs.taps,
+                   rs.delay * 1e3 / rates[r][1], total_in / seconds * 1e-6, total_out / seconds * 1e-6,
+                   10.0 * log10(sig / err));
+
+            resampler_close(&rs);
+            free(p_in);
+            free(p_out);
+        }
+    }
+
+    return 0;
+}
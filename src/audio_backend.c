@@ -0,0 +1,417 @@
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "audio_backend.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#endif
+
+/* ------------------------ Function Prototypes --------------------------- */
+static int pa_start(audio_backend *be);
+static int pa_stop(audio_backend *be);
+static void pa_close(audio_backend *be);
+static int pa_callback(const void *input, void *output, unsigned long framesPerBuffer,
+                       const PaStreamCallbackTimeInfo *time_info, PaStreamCallbackFlags flags, void *userData);
+static int sim_start(audio_backend *be);
+static int sim_stop(audio_backend *be);
+static void sim_close(audio_backend *be);
+static void record_callback(audio_backend *be, double callback_us);
+/* ------------------------------------------------------------------------ */
+
+static const audio_backend_ops pa_ops = { "portaudio", pa_start, pa_stop, pa_close };
+static const audio_backend_ops sim_ops = { "sim", sim_start, sim_stop, sim_close };
+
+
+void audio_sim_default_config(audio_sim_config *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->samplerate = 48000;
+    config->frames_per_buffer = 256;
+    config->tone_freq = 1000.0;
+    config->tone_level = 0.5;
+    config->b_realtime = 1;
+}
+
+int audio_backend_open_portaudio
+(
+    audio_backend *be
+    ,unsigned int samplerate
+    ,unsigned int frames_per_buffer
+    ,audio_backend_callback callback
+    ,void *userData
+)
+{
+    if(!be || !callback || !samplerate)
+    {
+        return -1;
+    }
+
+    memset(be, 0, sizeof(*be));
+    be->ops = &pa_ops;
+    be->samplerate = samplerate;
+    be->frames_per_buffer = frames_per_buffer;
+    be->callback = callback;
+    be->userData = userData;
+
+    if(Pa_Initialize() != paNoError)
+    {
+        return -1;
+    }
+
+    if(Pa_OpenDefaultStream(&be->stream
+                            ,1
+                            ,1
+                            ,paFloat32
+                            ,samplerate
+                            ,frames_per_buffer
+                            ,pa_callback
+                            ,be) != paNoError)
+    {
+        Pa_Terminate();
+        return -1;
+    }
+
+    return 0;
+}
+
+int audio_backend_start(audio_backend *be)
+{
+    return be->ops->start(be);
+}
+
+int audio_backend_stop(audio_backend *be)
+{
+    return be->ops->stop(be);
+}
+
+void audio_backend_close(audio_backend *be)
+{
+    if(be && be->ops)
+    {
+        be->ops->close(be);
+        be->ops = NULL;
+    }
+}
+
+int audio_backend_finished(const audio_backend *be)
+{
+    return atomic_load(&be->b_finished);
+}
+
+static void record_callback(audio_backend *be, double callback_us)
+{
+    ++be->stats.callbacks;
+    be->stats.callback_sum_us += callback_us;
+    if(callback_us > be->stats.callback_max_us)
+    {
+        be->stats.callback_max_us = callback_us;
+    }
+}
+
+/* ------------------------------ portaudio ------------------------------- */
+
+static int pa_start(audio_backend *be)
+{
+    return Pa_StartStream(be->stream) == paNoError ? 0 : -1;
+}
+
+static int pa_stop(audio_backend *be)
+{
+    return Pa_StopStream(be->stream) == paNoError ? 0 : -1;
+}
+
+static void pa_close(audio_backend *be)
+{
+    Pa_CloseStream(be->stream);
+    Pa_Terminate();
+    be->stream = NULL;
+}
+
+static int pa_callback
+(
+    const void *input
+    ,void *output
+    ,unsigned long framesPerBuffer
+    ,const PaStreamCallbackTimeInfo *time_info
+    ,PaStreamCallbackFlags flags
+    ,void *userData
+)
+{
+    int result;
+    audio_backend *be = (audio_backend *) userData;
+
+    if(flags & (paInputOverflow | paOutputUnderflow))
+    {
+        ++be->stats.xruns;
+    }
+
+    be->input_time = time_info->inputBufferAdcTime;
+    if(be->p_latency)
+    {
+        be->p_latency->input_age_ns = (long long) ((time_info->currentTime - time_info->inputBufferAdcTime) * 1e9);
+    }
+    result = be->callback((const float *) input, (float *) output, framesPerBuffer, be->userData);
+    record_callback(be, (Pa_GetStreamTime(be->stream) - time_info->currentTime) * 1e6);
+
+    return result;
+}
+
+/* ------------------------------ simulated ------------------------------- */
+
+#ifndef _WIN32
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ull + (unsigned long long) ts.tv_nsec;
+}
+
+static void sleep_until_ns(unsigned long long t)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t) (t / 1000000000ull);
+    ts.tv_nsec = (long) (t % 1000000000ull);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+        /* Interrupted: sleep the rest */
+    }
+}
+
+/* xorshift32, uniform in [0, 1) */
+static double sim_random(audio_backend *be)
+{
+    be->rng ^= be->rng << 13;
+    be->rng ^= be->rng >> 17;
+    be->rng ^= be->rng << 5;
+    return be->rng / 4294967296.0;
+}
+
+/**
+ *  Produce one buffer of input.  Returns the number of frames,
+ *  less than a full buffer only when the source runs out
+**/
+static unsigned long sim_fill(audio_backend *be)
+{
+    unsigned long i, j, take;
+    long got;
+    const unsigned long n = be->frames_per_buffer;
+    const double w = 2 * M_PI * be->sim.tone_freq / be->samplerate;
+    pcm_source *src = be->sim.p_source;
+
+    if(src)
+    {
+        /* Reads come in the source's block size; hand out the rest later */
+        for(i = 0; i < n; i += take)
+        {
+            if(be->src_pos == be->src_avail)
+            {
+                got = pcm_source_read(src);
+                if(got <= 0)
+                {
+                    break;
+                }
+                be->src_pos = 0;
+                be->src_avail = (unsigned long) got;
+            }
+
+            take = be->src_avail - be->src_pos < n - i ? be->src_avail - be->src_pos : n - i;
+            for(j = 0; j < take; ++j)
+            {
+                be->p_in[i + j] = src->p_frames[(be->src_pos + j) * src->channels];
+            }
+            be->src_pos += take;
+        }
+        return i;
+    }
+
+    for(i = 0; i < n; ++i)
+    {
+        be->p_in[i] = (float) (be->sim.tone_level * sin(be->phase)
+                               + be->sim.noise_level * (2.0 * sim_random(be) - 1.0));
+        be->phase += w;
+        if(be->phase >= 2 * M_PI)
+        {
+            be->phase -= 2 * M_PI;
+        }
+    }
+
+    return n;
+}
+
+static void *sim_main(void *arg)
+{
+    audio_backend *be = (audio_backend *) arg;
+    const unsigned long long period = (unsigned long long) be->frames_per_buffer * 1000000000ull / be->samplerate;
+    unsigned long long t_start, due, t0, t1, k = 0;
+    unsigned long n;
+    int result;
+
+    t_start = now_ns();
+
+    while(atomic_load(&be->b_running))
+    {
+        if(be->sim.max_frames && be->frames >= be->sim.max_frames)
+        {
+            break;
+        }
+
+        /* Buffer k is complete at the end of its period */
+        due = t_start + (k + 1) * period;
+        if(be->sim.b_realtime)
+        {
+            sleep_until_ns(due + (unsigned long long) (sim_random(be) * be->sim.jitter_us * 1000.0));
+        }
+
+        n = sim_fill(be);
+        if(!n)
+        {
+            break;
+        }
+
+        t0 = now_ns();
+        if(be->sim.b_realtime && t0 > due && (t0 - due) / 1000.0 > be->stats.wakeup_max_us)
+        {
+            be->stats.wakeup_max_us = (t0 - due) / 1000.0;
+        }
+
+        be->input_time = (double) (k * period) / 1e9;
+        if(be->p_latency)
+        {
+            /* The buffer's first sample arrived one period before due */
+            be->p_latency->input_age_ns = (long long) (t0 - (due - period));
+        }
+        result = be->callback(be->p_in, be->p_out, n, be->userData);
+        t1 = now_ns();
+        record_callback(be, (t1 - t0) / 1000.0);
+
+        be->frames += n;
+        ++k;
+
+        /**
+         *  The next buffer was due while we were still busy: a
+         *  real device would have dropped it.  Count an xrun and
+         *  skip ahead the way the hardware clock would
+        **/
+        if(be->sim.b_realtime && t1 > due + period)
+        {
+            ++be->stats.xruns;
+            k = (t1 - t_start) / period;
+        }
+
+        if(result != paContinue || n < be->frames_per_buffer)
+        {
+            break;
+        }
+    }
+
+    atomic_store(&be->b_finished, 1);
+
+    return NULL;
+}
+
+int audio_backend_open_sim
+(
+    audio_backend *be
+    ,const audio_sim_config *config
+    ,audio_backend_callback callback
+    ,void *userData
+)
+{
+    if(!be || !config || !callback || !config->samplerate || !config->frames_per_buffer)
+    {
+        return -1;
+    }
+
+    memset(be, 0, sizeof(*be));
+    be->ops = &sim_ops;
+    be->samplerate = config->samplerate;
+    be->frames_per_buffer = config->frames_per_buffer;
+    be->callback = callback;
+    be->userData = userData;
+    be->sim = *config;
+    be->rng = 2463534242u;
+
+    be->p_in = (float *) calloc(config->frames_per_buffer, sizeof(float));
+    be->p_out = (float *) calloc(config->frames_per_buffer, sizeof(float));
+    be->p_thread = malloc(sizeof(pthread_t));
+    if(!be->p_in || !be->p_out || !be->p_thread)
+    {
+        sim_close(be);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int sim_start(audio_backend *be)
+{
+    if(atomic_load(&be->b_running))
+    {
+        return -1;
+    }
+
+    atomic_store(&be->b_finished, 0);
+    atomic_store(&be->b_running, 1);
+    if(pthread_create((pthread_t *) be->p_thread, NULL, sim_main, be))
+    {
+        atomic_store(&be->b_running, 0);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int sim_stop(audio_backend *be)
+{
+    if(!atomic_exchange(&be->b_running, 0))
+    {
+        return -1;
+    }
+
+    pthread_join(*(pthread_t *) be->p_thread, NULL);
+    return 0;
+}
+
+static void sim_close(audio_backend *be)
+{
+    if(atomic_load(&be->b_running))
+    {
+        sim_stop(be);
+    }
+
+    free(be->p_in);
+    free(be->p_out);
+    free(be->p_thread);
+    be->p_in = NULL;
+    be->p_out = NULL;
+    be->p_thread = NULL;
+}
+
+#else /* _WIN32 */
+
+int audio_backend_open_sim
+(
+    audio_backend *be
+    ,const audio_sim_config *config
+    ,audio_backend_callback callback
+    ,void *userData
+)
+{
+    /* Needs POSIX threads and clocks */
+    (void) be; (void) config; (void) callback; (void) userData;
+    return -1;
+}
+
+static int sim_start(audio_backend *be) { (void) be; return -1; }
+static int sim_stop(audio_backend *be) { (void) be; return -1; }
+static void sim_close(audio_backend *be) { (void) be; }
+
+#endif /* _WIN32 */
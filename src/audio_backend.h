@@ -0,0 +1,192 @@
+#ifndef AUDIO_BACKEND_H
+#define AUDIO_BACKEND_H
+
+#include <stdatomic.h>
+
+#include "portaudio.h"
+#include "pcm_source.h"
+#include "latency_stats.h"
+
+/**
+ *  Where audio comes from.  Every backend calls the same
+ *  callback (fft_block_process fits as is) with mono float
+ *  buffers of frames_per_buffer samples:
+ *
+ *      portaudio   the default input / output device
+ *      sim         a thread that wakes on a clock at the
+ *                  buffer rate, with optional jitter, and
+ *                  delivers a synthetic tone plus noise or
+ *                  samples from a pcm_source.  Needs no
+ *                  audio hardware, so works on CI machines
+ *
+ *  Both keep the same statistics.  A callback that has not
+ *  returned by the time the next buffer is due counts as an
+ *  xrun, as do overflow / underflow flags from PortAudio.
+**/
+typedef int (*audio_backend_callback)
+(
+    const float *input
+    ,float *output
+    ,unsigned long framesPerBuffer
+    ,void *userData
+);
+
+typedef struct
+{
+    unsigned long callbacks;
+    unsigned long xruns;
+
+    /** Time spent inside the callback **/
+    double callback_sum_us;
+    double callback_max_us;
+
+    /**
+     * How late the callback started after its buffer was
+     * complete (simulated backend only)
+    **/
+    double wakeup_max_us;
+
+} audio_backend_stats;
+
+typedef struct
+{
+    unsigned int samplerate;
+    unsigned int frames_per_buffer;
+
+    /** Random extra wakeup delay, 0 .. jitter_us **/
+    double jitter_us;
+
+    /** Synthetic input: a sine plus uniform noise **/
+    double tone_freq;
+    double tone_level;
+    double noise_level;
+
+    /**
+     * Read input from here instead (channel 0); the run
+     * ends with the source.  Owned by the caller
+    **/
+    pcm_source *p_source;
+
+    /** Stop after this many frames, 0 to run until stopped **/
+    unsigned long long max_frames;
+
+    /** 0 delivers buffers as fast as the callback allows **/
+    int b_realtime;
+
+} audio_sim_config;
+
+typedef struct audio_backend audio_backend;
+
+typedef struct
+{
+    const char *name;
+    int (*start)(audio_backend *be);
+    int (*stop)(audio_backend *be);
+    void (*close)(audio_backend *be);
+
+} audio_backend_ops;
+
+struct audio_backend
+{
+    const audio_backend_ops *ops;
+
+    unsigned int samplerate;
+    unsigned int frames_per_buffer;
+    audio_backend_callback callback;
+    void *userData;
+
+    audio_backend_stats stats;
+
+    /**
+     * Stream time in seconds at which the first sample of the
+     * buffer being processed was captured.  Valid inside the
+     * callback
+    **/
+    double input_time;
+
+    /**
+     * When set, input_age_ns is updated before every
+     * callback so frame latencies count from capture
+    **/
+    latency_stats *p_latency;
+
+    /** portaudio **/
+    PaStream *stream;
+
+    /** sim **/
+    audio_sim_config sim;
+    void *p_thread;
+    atomic_int b_running;
+    atomic_int b_finished;
+    float *p_in;
+    float *p_out;
+    unsigned long long frames;
+    unsigned long src_pos;
+    unsigned long src_avail;
+    double phase;
+    unsigned int rng;
+};
+
+/** ------------------------------------------
+ *  audio_sim_default_config
+ *  ------------------------------------------
+ *      48 kHz, 256 frame buffers, real time,
+ *      no jitter, a 1 kHz tone at -6 dBFS
+ *  ==========================================
+**/
+void audio_sim_default_config(audio_sim_config *config);
+
+/** ----------------------------------------------------
+ *  audio_backend_open_portaudio
+ *  ----------------------------------------------------
+ *      Opens the default device with one input and one
+ *      output channel.  Returns 0 on success, -1 on
+ *      failure
+ *  ====================================================
+**/
+int audio_backend_open_portaudio
+(
+    audio_backend *be
+    ,unsigned int samplerate
+    ,unsigned int frames_per_buffer
+    ,audio_backend_callback callback
+    ,void *userData
+);
+
+/** ----------------------------------------------------
+ *  audio_backend_open_sim
+ *  ----------------------------------------------------
+ *      Prepares the simulated device.  Returns 0 on
+ *      success, -1 on failure (or on platforms without
+ *      POSIX threads)
+ *  ====================================================
+**/
+int audio_backend_open_sim
+(
+    audio_backend *be
+    ,const audio_sim_config *config
+    ,audio_backend_callback callback
+    ,void *userData
+);
+
+/** ------------------------------------------
+ *  audio_backend_start / stop / close
+ *  ------------------------------------------
+ *      Start and stop return 0 on success,
+ *      -1 on failure
+ *  ==========================================
+**/
+int audio_backend_start(audio_backend *be);
+int audio_backend_stop(audio_backend *be);
+void audio_backend_close(audio_backend *be);
+
+/** ------------------------------------------
+ *  audio_backend_finished
+ *  ------------------------------------------
+ *      Non zero once a simulated run reached
+ *      max_frames or the end of its source
+ *  ==========================================
+**/
+int audio_backend_finished(const audio_backend *be);
+
+#endif
@@ -0,0 +1,513 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fft_batch.h"
+#include "batch_driver.h"
+
+/** One run of consecutive frames from one file **/
+typedef struct
+{
+    unsigned int file;
+    unsigned long first_frame;
+    unsigned int num_frames;
+
+} batch_shard;
+
+typedef struct
+{
+    int in_fd;
+    int out_fd;
+    unsigned long frames;
+
+} batch_file;
+
+/**
+ *  State shared by all workers; group_next and failed under lock.
+ *  Shards are grouped by the node of their file: group 0 for
+ *  files on no node, group n + 1 for node n.  Group g holds
+ *  shards [group_next[g], group_end[g]) still to be taken
+**/
+typedef struct
+{
+    const batch_driver_config *config;
+    batch_file *p_files;
+    batch_shard *p_shards;
+    unsigned long num_shards;
+
+    pthread_mutex_t lock;
+    unsigned long group_next[PLACEMENT_MAX_NODES + 1];
+    unsigned long group_end[PLACEMENT_MAX_NODES + 1];
+    int failed;
+
+} batch_job;
+
+typedef struct
+{
+    batch_job *job;
+    fft_batch batch;
+    pthread_t thread;
+
+    /** One shard's input samples and output rows **/
+    float *p_samples;
+    float *p_rows;
+
+    batch_driver_worker_stats stats;
+    unsigned long long bytes_read;
+
+} batch_worker;
+
+/* ------------------------ Function Prototypes --------------------------- */
+static double batch_now(void);
+static int batch_read_full(int fd, void *buf, size_t length, off_t offset);
+static int batch_write_full(int fd, const void *buf, size_t length, off_t offset);
+static unsigned int batch_file_group(const batch_driver_config *config, unsigned int file);
+static const batch_shard *batch_take_shard(batch_worker *worker);
+static int batch_worker_shard(batch_worker *worker, const batch_shard *shard);
+static void *batch_worker_main(void *arg);
+/* ------------------------------------------------------------------------ */
+
+
+void batch_driver_default_config(batch_driver_config *config)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    config->frame_length = 2048;
+    config->hop = 1024;
+    config->num_threads = cpus > 0 ? (unsigned int) cpus : 1;
+    config->shard_frames = 256;
+    config->suffix = ".spec";
+    config->placement = PLACEMENT_NONE;
+    config->p_file_nodes = NULL;
+}
+
+int batch_driver_run
+(
+    const batch_driver_config *config
+    ,const char * const *paths
+    ,unsigned int num_paths
+    ,batch_driver_stats *p_stats
+)
+{
+    unsigned int i, g, num_workers = 0, started = 0;
+    unsigned int bins, row_bytes;
+    unsigned long frames, f, s, file_shards;
+    unsigned long num_samples;
+    unsigned long fill[PLACEMENT_MAX_NODES + 1];
+    unsigned long long total_frames = 0;
+    size_t shard_samples;
+    char *p_out_path;
+    struct stat st;
+    batch_job job;
+    batch_worker *p_workers = NULL;
+    placement_topology topo;
+    placement_policy policy = PLACEMENT_NONE;
+    placement_saved saved;
+    int cpu, b_pinned;
+    double t_start;
+    int status = 0;
+
+    if(!config || !config->frame_length || !config->hop || config->hop > config->frame_length
+       || !config->shard_frames || !config->suffix || (num_paths && !paths))
+    {
+        return -1;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.config = config;
+    bins = config->frame_length / 2 + 1;
+    row_bytes = bins * sizeof(float);
+
+    job.p_files = (batch_file *) malloc(sizeof(batch_file) * (num_paths ? num_paths : 1));
+    if(!job.p_files)
+    {
+        return -1;
+    }
+    for(i = 0; i < num_paths; ++i)
+    {
+        job.p_files[i].in_fd = -1;
+        job.p_files[i].out_fd = -1;
+    }
+
+    /**
+     *  First pass: open everything, size the outputs and count
+     *  shards, so a bad path fails before any work starts
+    **/
+    for(i = 0; i < num_paths && !status; ++i)
+    {
+        job.p_files[i].in_fd = open(paths[i], O_RDONLY);
+        if(job.p_files[i].in_fd < 0 || fstat(job.p_files[i].in_fd, &st))
+        {
+            status = -1;
+            break;
+        }
+
+        p_out_path = (char *) malloc(strlen(paths[i]) + strlen(config->suffix) + 1);
+        if(!p_out_path)
+        {
+            status = -1;
+            break;
+        }
+        strcpy(p_out_path, paths[i]);
+        strcat(p_out_path, config->suffix);
+        job.p_files[i].out_fd = open(p_out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        free(p_out_path);
+
+        num_samples = (unsigned long) st.st_size / sizeof(float);
+        frames = num_samples >= config->frame_length ? (num_samples - config->frame_length) / config->hop + 1 : 0;
+
+        if(job.p_files[i].out_fd < 0
+           || ftruncate(job.p_files[i].out_fd, (off_t) frames * row_bytes))
+        {
+            status = -1;
+            break;
+        }
+
+        job.p_files[i].frames = frames;
+        file_shards = (frames + config->shard_frames - 1) / config->shard_frames;
+        job.num_shards += file_shards;
+        job.group_end[batch_file_group(config, i)] += file_shards;
+        total_frames += frames;
+    }
+
+    if(!status && job.num_shards)
+    {
+        job.p_shards = (batch_shard *) malloc(sizeof(batch_shard) * job.num_shards);
+        if(!job.p_shards)
+        {
+            status = -1;
+        }
+    }
+
+    /* Groups follow each other in the shard array */
+    for(g = 0, s = 0; g <= PLACEMENT_MAX_NODES; ++g)
+    {
+        job.group_next[g] = fill[g] = s;
+        s += job.group_end[g];
+        job.group_end[g] = s;
+    }
+
+    /* Second pass: lay the shards out file by file within each group */
+    for(i = 0; i < num_paths && !status && job.p_shards; ++i)
+    {
+        frames = job.p_files[i].frames;
+        g = batch_file_group(config, i);
+        for(f = 0; f < frames; f += config->shard_frames)
+        {
+            s = fill[g]++;
+            job.p_shards[s].file = i;
+            job.p_shards[s].first_frame = f;
+            job.p_shards[s].num_frames = frames - f < config->shard_frames ? (unsigned int) (frames - f) : config->shard_frames;
+        }
+    }
+
+    /* No point in more workers than shards */
+    num_workers = config->num_threads ? config->num_threads : 1;
+    if(num_workers > BATCH_DRIVER_MAX_THREADS)
+    {
+        num_workers = BATCH_DRIVER_MAX_THREADS;
+    }
+    if(num_workers > job.num_shards)
+    {
+        num_workers = job.num_shards ? (unsigned int) job.num_shards : 1;
+    }
+
+    if(!status)
+    {
+        p_workers = (batch_worker *) calloc(num_workers, sizeof(batch_worker));
+        if(!p_workers)
+        {
+            status = -1;
+        }
+    }
+
+    if(config->placement != PLACEMENT_NONE && placement_topology_read(&topo) == 0)
+    {
+        policy = config->placement;
+    }
+
+    /**
+     *  Plans are made here, one thread at a time.  For a pinned
+     *  worker this thread moves to the worker's CPU meanwhile,
+     *  so the pages it first touches land on the worker's node
+    **/
+    shard_samples = (size_t) (config->shard_frames - 1) * config->hop + config->frame_length;
+    for(i = 0; i < num_workers && !status; ++i)
+    {
+        cpu = policy != PLACEMENT_NONE ? placement_cpu(&topo, policy, i, -1) : -1;
+        b_pinned = cpu >= 0 && placement_pin_self(cpu, &saved) == 0;
+
+        p_workers[i].job = &job;
+        p_workers[i].stats.cpu = b_pinned ? cpu : -1;
+        p_workers[i].stats.node = b_pinned ? placement_node_of(&topo, cpu) : -1;
+        p_workers[i].p_samples = (float *) malloc(sizeof(float) * shard_samples);
+        p_workers[i].p_rows = (float *) malloc((size_t) row_bytes * config->shard_frames);
+        if(!p_workers[i].p_samples || !p_workers[i].p_rows
+           || fft_batch_init(&p_workers[i].batch, config->frame_length, config->shard_frames, FFTW_MEASURE))
+        {
+            status = -1;
+        }
+        else if(b_pinned)
+        {
+            placement_touch(p_workers[i].p_samples, sizeof(float) * shard_samples);
+            placement_touch(p_workers[i].p_rows, (size_t) row_bytes * config->shard_frames);
+        }
+
+        if(b_pinned)
+        {
+            placement_restore_self(&saved);
+        }
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    t_start = batch_now();
+
+    for(i = 0; i < num_workers && !status && job.num_shards; ++i)
+    {
+        if(pthread_create(&p_workers[i].thread, NULL, batch_worker_main, &p_workers[i]))
+        {
+            pthread_mutex_lock(&job.lock);
+            job.failed = 1;
+            pthread_mutex_unlock(&job.lock);
+            break;
+        }
+        ++started;
+    }
+    for(i = 0; i < started; ++i)
+    {
+        pthread_join(p_workers[i].thread, NULL);
+    }
+
+    if(job.failed)
+    {
+        status = -1;
+    }
+
+    if(p_stats)
+    {
+        memset(p_stats, 0, sizeof(*p_stats));
+        p_stats->files = num_paths;
+        p_stats->shards = job.num_shards;
+        p_stats->frames = (unsigned long) total_frames;
+        p_stats->wall_seconds = batch_now() - t_start;
+        p_stats->num_workers = p_workers ? num_workers : 0;
+        for(i = 0; p_workers && i < num_workers; ++i)
+        {
+            p_stats->workers[i] = p_workers[i].stats;
+            p_stats->bytes_read += p_workers[i].bytes_read;
+        }
+    }
+
+    pthread_mutex_destroy(&job.lock);
+
+    for(i = 0; p_workers && i < num_workers; ++i)
+    {
+        fft_batch_close(&p_workers[i].batch);
+        free(p_workers[i].p_samples);
+        free(p_workers[i].p_rows);
+    }
+    free(p_workers);
+
+    for(i = 0; i < num_paths; ++i)
+    {
+        if(job.p_files[i].in_fd >= 0)
+        {
+            close(job.p_files[i].in_fd);
+        }
+        if(job.p_files[i].out_fd >= 0)
+        {
+            close(job.p_files[i].out_fd);
+        }
+    }
+    free(job.p_files);
+    free(job.p_shards);
+
+    return status;
+}
+
+static double batch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int batch_read_full(int fd, void *buf, size_t length, off_t offset)
+{
+    ssize_t n;
+
+    while(length)
+    {
+        n = pread(fd, buf, length, offset);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            return -1;
+        }
+        buf = (char *) buf + n;
+        length -= (size_t) n;
+        offset += n;
+    }
+
+    return 0;
+}
+
+static int batch_write_full(int fd, const void *buf, size_t length, off_t offset)
+{
+    ssize_t n;
+
+    while(length)
+    {
+        n = pwrite(fd, buf, length, offset);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            return -1;
+        }
+        buf = (const char *) buf + n;
+        length -= (size_t) n;
+        offset += n;
+    }
+
+    return 0;
+}
+
+/**
+ *  Shard group of a file: its node + 1, or 0 if it has none
+**/
+static unsigned int batch_file_group(const batch_driver_config *config, unsigned int file)
+{
+    int node = config->p_file_nodes ? config->p_file_nodes[file] : -1;
+
+    return node >= 0 && node < PLACEMENT_MAX_NODES ? (unsigned int) node + 1 : 0;
+}
+
+/**
+ *  Next shard for a worker, under the job lock: its own
+ *  node's group, then group 0, then any other.  NULL when
+ *  all are taken or the job failed
+**/
+static const batch_shard *batch_take_shard(batch_worker *worker)
+{
+    batch_job *job = worker->job;
+    const unsigned int own = worker->stats.node >= 0 ? (unsigned int) worker->stats.node + 1 : 0;
+    unsigned int g;
+
+    if(job->failed)
+    {
+        return NULL;
+    }
+
+    if(job->group_next[own] < job->group_end[own])
+    {
+        return &job->p_shards[job->group_next[own]++];
+    }
+    if(job->group_next[0] < job->group_end[0])
+    {
+        return &job->p_shards[job->group_next[0]++];
+    }
+
+    for(g = 1; g <= PLACEMENT_MAX_NODES; ++g)
+    {
+        if(job->group_next[g] < job->group_end[g])
+        {
+            worker->stats.remote_shards += own != 0;
+            return &job->p_shards[job->group_next[g]++];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  Read the shard plus its seam, transform and write its rows
+ *  where they belong in the output
+**/
+static int batch_worker_shard(batch_worker *worker, const batch_shard *shard)
+{
+    unsigned int r, k;
+    const batch_driver_config *config = worker->job->config;
+    const batch_file *file = &worker->job->p_files[shard->file];
+    const unsigned int bins = worker->batch.num_bins;
+    const size_t count = (size_t) (shard->num_frames - 1) * config->hop + config->frame_length;
+    const double *p_mag;
+    float *p_row;
+
+    if(batch_read_full(file->in_fd, worker->p_samples, count * sizeof(float)
+                       ,(off_t) shard->first_frame * config->hop * sizeof(float)))
+    {
+        return -1;
+    }
+    worker->bytes_read += count * sizeof(float);
+
+    if(fft_batch_gather(&worker->batch, worker->p_samples, count, config->hop) != shard->num_frames)
+    {
+        return -1;
+    }
+    fft_batch_execute(&worker->batch);
+
+    for(r = 0; r < shard->num_frames; ++r)
+    {
+        p_mag = worker->batch.p_mag + (size_t) r * worker->batch.out_stride;
+        p_row = worker->p_rows + (size_t) r * bins;
+        for(k = 0; k < bins; ++k)
+        {
+            p_row[k] = (float) p_mag[k];
+        }
+    }
+
+    return batch_write_full(file->out_fd, worker->p_rows, (size_t) shard->num_frames * bins * sizeof(float)
+                            ,(off_t) shard->first_frame * bins * sizeof(float));
+}
+
+static void *batch_worker_main(void *arg)
+{
+    batch_worker *worker = (batch_worker *) arg;
+    batch_job *job = worker->job;
+    const batch_shard *shard;
+    double t0;
+
+    /* Same CPU the arena was touched from */
+    if(worker->stats.cpu >= 0 && placement_pin_self(worker->stats.cpu, NULL))
+    {
+        worker->stats.cpu = -1;
+        worker->stats.node = -1;
+    }
+
+    for(;;)
+    {
+        pthread_mutex_lock(&job->lock);
+        shard = batch_take_shard(worker);
+        pthread_mutex_unlock(&job->lock);
+        if(!shard)
+        {
+            break;
+        }
+
+        t0 = batch_now();
+        if(batch_worker_shard(worker, shard))
+        {
+            pthread_mutex_lock(&job->lock);
+            job->failed = 1;
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        worker->stats.busy_seconds += batch_now() - t0;
+        worker->stats.frames += shard->num_frames;
+        ++worker->stats.shards;
+    }
+
+    return NULL;
+}
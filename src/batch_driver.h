@@ -0,0 +1,101 @@
+#ifndef BATCH_DRIVER_H
+#define BATCH_DRIVER_H
+
+#include "placement.h"
+
+/**
+ *  Offline spectra for a list of recordings, spread over a pool
+ *  of threads.
+ *
+ *  Inputs are raw mono float32 files.  Every file is cut into
+ *  shards of up to shard_frames frames; a shard re-reads the
+ *  frame_length - hop samples before its first hop so frames
+ *  across the seam are identical to an unsharded run.  Workers
+ *  each own an fft_batch (plans are made up front, on the
+ *  calling thread, as FFTW's planner is not thread safe) and
+ *  take shards from a shared counter.
+ *
+ *  For each input <path> the output <path><suffix> holds float32
+ *  dB magnitudes, one row of frame_length / 2 + 1 bins per
+ *  frame.  Every shard writes its rows at an offset fixed by its
+ *  first frame, so the output does not depend on thread count
+ *  or scheduling.
+ *
+ *  With a placement policy every worker is pinned to a CPU, and
+ *  its buffers and plans are allocated and first touched from
+ *  that CPU so they sit on its NUMA node.  When the node of
+ *  each input is known (p_file_nodes), workers take shards of
+ *  their own node's files first, then of files on no node in
+ *  particular, and only then steal from other nodes.
+**/
+
+#define BATCH_DRIVER_MAX_THREADS    64
+
+typedef struct
+{
+    unsigned int frame_length;
+    unsigned int hop;
+    unsigned int num_threads;
+    unsigned int shard_frames;
+    const char *suffix;
+
+    placement_policy placement;
+    /** Node nearest every input, -1 for none; NULL if unknown **/
+    const int *p_file_nodes;
+
+} batch_driver_config;
+
+typedef struct
+{
+    unsigned long shards;
+    unsigned long frames;
+    double busy_seconds;
+
+    /** Where the worker ran, -1 if unpinned **/
+    int cpu;
+    int node;
+    /** Shards taken from another node's inputs **/
+    unsigned long remote_shards;
+
+} batch_driver_worker_stats;
+
+typedef struct
+{
+    unsigned long files;
+    unsigned long shards;
+    unsigned long frames;
+    unsigned long long bytes_read;
+    double wall_seconds;
+    unsigned int num_workers;
+    batch_driver_worker_stats workers[BATCH_DRIVER_MAX_THREADS];
+
+} batch_driver_stats;
+
+/** ------------------------------------------
+ *  batch_driver_default_config
+ *  ------------------------------------------
+ *      2048 point frames, 50% overlap, one
+ *      thread per online CPU, no placement
+ *  ==========================================
+**/
+void batch_driver_default_config(batch_driver_config *config);
+
+/** ----------------------------------------------------
+ *  batch_driver_run
+ *  ----------------------------------------------------
+ *      Processes num_paths input files and fills
+ *      p_stats (may be NULL).  Files shorter than one
+ *      frame produce an empty output.
+ *      Returns 0 on success, -1 if any file could not
+ *      be read or written
+ *  ====================================================
+**/
+int batch_driver_run
+(
+    const batch_driver_config *config
+    ,const char * const *paths
+    ,unsigned int num_paths
+    ,batch_driver_stats *p_stats
+);
+
+#endif
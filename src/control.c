@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "control.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#ifdef MSG_NOSIGNAL
+#define CONTROL_SEND_FLAGS  MSG_NOSIGNAL
+#else
+#define CONTROL_SEND_FLAGS  0
+#endif
+
+/* A client that stops reading is dropped after this long */
+#define CONTROL_SEND_TIMEOUT_S  1
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void *control_main(void *arg);
+static void serve_client(control_server *ctl, int fd);
+static int serve_line(control_server *ctl, int fd, char *line, int b_overlong);
+static int send_all(int fd, const char *p_data, size_t bytes);
+/* ------------------------------------------------------------------------ */
+
+
+int control_open
+(
+    control_server *ctl
+    ,const char *path
+    ,control_handler handler
+    ,void *userData
+)
+{
+    struct sockaddr_un addr;
+
+    if(!ctl || !path || !handler || strlen(path) >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+
+    memset(ctl, 0, sizeof(*ctl));
+    ctl->handler = handler;
+    ctl->user_data = userData;
+    strcpy(ctl->path, path);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    ctl->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(ctl->listen_fd < 0)
+    {
+        return -1;
+    }
+
+    /* A socket file left behind by a previous run would block bind */
+    unlink(path);
+
+    ctl->p_thread = malloc(sizeof(pthread_t));
+    if(!ctl->p_thread
+       || bind(ctl->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+       || listen(ctl->listen_fd, 1) < 0)
+    {
+        control_close(ctl);
+        return -1;
+    }
+
+    atomic_store(&ctl->b_running, 1);
+    if(pthread_create((pthread_t *) ctl->p_thread, NULL, control_main, ctl))
+    {
+        atomic_store(&ctl->b_running, 0);
+        control_close(ctl);
+        return -1;
+    }
+
+    return 0;
+}
+
+void control_close(control_server *ctl)
+{
+    if(!ctl)
+    {
+        return;
+    }
+
+    if(atomic_exchange(&ctl->b_running, 0))
+    {
+        pthread_join(*(pthread_t *) ctl->p_thread, NULL);
+    }
+
+    if(ctl->listen_fd >= 0)
+    {
+        close(ctl->listen_fd);
+        unlink(ctl->path);
+    }
+    free(ctl->p_thread);
+    memset(ctl, 0, sizeof(*ctl));
+    ctl->listen_fd = -1;
+}
+
+static void *control_main(void *arg)
+{
+    control_server *ctl = (control_server *) arg;
+    struct pollfd pfd;
+    int fd;
+
+    pfd.fd = ctl->listen_fd;
+    pfd.events = POLLIN;
+
+    while(atomic_load(&ctl->b_running))
+    {
+        if(poll(&pfd, 1, CONTROL_POLL_MS) <= 0 || !(pfd.revents & POLLIN))
+        {
+            continue;
+        }
+
+        fd = accept(ctl->listen_fd, NULL, NULL);
+        if(fd >= 0)
+        {
+            serve_client(ctl, fd);
+            close(fd);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  Answers requests until the client hangs up, says quit or
+ *  the server is stopped
+**/
+static void serve_client(control_server *ctl, int fd)
+{
+    char line[CONTROL_MAX_LINE];
+    size_t length = 0;
+    int b_overlong = 0, b_open = 1;
+    ssize_t got;
+    char c;
+    struct pollfd pfd;
+    struct timeval tv;
+
+#ifdef SO_NOSIGPIPE
+    {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    }
+#endif
+    tv.tv_sec = CONTROL_SEND_TIMEOUT_S;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while(b_open && atomic_load(&ctl->b_running))
+    {
+        if(poll(&pfd, 1, CONTROL_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        /* Requests are short; a byte at a time keeps this simple */
+        got = read(fd, &c, 1);
+        if(got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(got <= 0)
+        {
+            break;
+        }
+
+        if(c != '\n')
+        {
+            if(length < sizeof(line) - 1)
+            {
+                line[length++] = c;
+            }
+            else
+            {
+                b_overlong = 1;
+            }
+            continue;
+        }
+
+        line[length] = '\0';
+        b_open = serve_line(ctl, fd, line, b_overlong) == 0;
+        length = 0;
+        b_overlong = 0;
+    }
+}
+
+/**
+ *  Splits one request into words, runs it and sends the reply.
+ *  Returns -1 when the connection should end
+**/
+static int serve_line(control_server *ctl, int fd, char *line, int b_overlong)
+{
+    char *argv[CONTROL_MAX_ARGS];
+    int argc = 0, result = -1;
+    char *p_word, *p_save, *p_reply = NULL;
+    size_t reply_bytes = 0;
+    FILE *fp;
+
+    for(p_word = strtok_r(line, " \t\r", &p_save); p_word; p_word = strtok_r(NULL, " \t\r", &p_save))
+    {
+        if(argc == CONTROL_MAX_ARGS)
+        {
+            b_overlong = 1;
+            break;
+        }
+        argv[argc++] = p_word;
+    }
+
+    if(!argc && !b_overlong)
+    {   /* Blank line */
+        return 0;
+    }
+    if(argc && strcmp(argv[0], "quit") == 0)
+    {
+        return -1;
+    }
+
+    ++ctl->requests;
+
+    /* The reply is collected first so a slow client never holds stdio */
+    fp = open_memstream(&p_reply, &reply_bytes);
+    if(fp)
+    {
+        if(b_overlong)
+        {
+            fprintf(fp, "request too long\n");
+        }
+        else
+        {
+            result = ctl->handler(argc, argv, fp, ctl->user_data);
+        }
+        fprintf(fp, result == 0 ? "ok\n" : "error\n");
+        fclose(fp);
+    }
+
+    result = p_reply ? send_all(fd, p_reply, reply_bytes) : send_all(fd, "error\n", 6);
+    free(p_reply);
+
+    return result;
+}
+
+static int send_all(int fd, const char *p_data, size_t bytes)
+{
+    ssize_t sent;
+
+    while(bytes)
+    {
+        sent = send(fd, p_data, bytes, CONTROL_SEND_FLAGS);
+        if(sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(sent <= 0)
+        {
+            return -1;
+        }
+        p_data += sent;
+        bytes -= (size_t) sent;
+    }
+
+    return 0;
+}
+
+#else /* _WIN32 */
+
+/* Unix domain sockets and POSIX threads only */
+
+int control_open
+(
+    control_server *ctl
+    ,const char *path
+    ,control_handler handler
+    ,void *userData
+)
+{
+    (void) ctl; (void) path; (void) handler; (void) userData;
+    return -1;
+}
+
+void control_close(control_server *ctl) { (void) ctl; }
+
+#endif /* _WIN32 */
@@ -0,0 +1,76 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+/**
+ *  Runtime control socket.
+ *
+ *  A thread listens on a Unix domain socket and serves one
+ *  client at a time with a line protocol: every request is one
+ *  line of words separated by blanks, handed to the handler as
+ *  argc/argv.  Whatever the handler prints is sent back,
+ *  followed by a line "ok" or, when it fails, "error".  "quit"
+ *  ends the connection.  For example
+ *
+ *      $ echo stats | nc -U /tmp/fft_block.ctl
+ *
+ *  The handler runs on the control thread, so it may plan and
+ *  switch (fft_block_switch) but must not block for long.
+**/
+#define CONTROL_MAX_LINE    256
+#define CONTROL_MAX_ARGS    8
+
+/* How often an idle server looks at b_running */
+#define CONTROL_POLL_MS     200
+
+/**
+ *  Prints its reply to fp.  Returns 0 on success, -1 to
+ *  have the request answered with "error"
+**/
+typedef int (*control_handler)(int argc, char **argv, FILE *fp, void *userData);
+
+typedef struct
+{
+    int listen_fd;
+    char path[108];
+
+    control_handler handler;
+    void *user_data;
+
+    void *p_thread;
+    atomic_int b_running;
+
+    /** Requests served, counted by the control thread **/
+    unsigned long requests;
+
+} control_server;
+
+/** ------------------------------------------
+ *  control_open
+ *  ------------------------------------------
+ *      Listens at path (replacing a stale
+ *      socket file) and starts the control
+ *      thread.  Returns 0 on success, -1 on
+ *      failure
+ *  ==========================================
+**/
+int control_open
+(
+    control_server *ctl
+    ,const char *path
+    ,control_handler handler
+    ,void *userData
+);
+
+/** ------------------------------------------
+ *  control_close
+ *  ------------------------------------------
+ *      Stops the thread, dropping a connected
+ *      client, and removes the socket file
+ *  ==========================================
+**/
+void control_close(control_server *ctl);
+
+#endif
@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "cross_spectrum.h"
+
+/* Rows are padded to a multiple of this many bins (64 bytes) */
+#define CROSS_SPECTRUM_BIN_ALIGN    4
+
+/* Keeps log10 finite for empty bins */
+#define CROSS_SPECTRUM_FLOOR        1e-30
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void cross_spectrum_frame(cross_spectrum *cs);
+/* ------------------------------------------------------------------------ */
+
+
+int cross_spectrum_init
+(
+    cross_spectrum *cs
+    ,unsigned int samplerate
+    ,unsigned int num_channels
+    ,unsigned int frame_length
+    ,unsigned int hop
+    ,const cross_spectrum_pair *pairs
+    ,unsigned int num_pairs
+)
+{
+    unsigned int i, c;
+    int n;
+
+    if(!cs || !samplerate || !num_channels || frame_length < 2
+       || !hop || hop > frame_length || (num_pairs && !pairs))
+    {
+        return -1;
+    }
+
+    for(i = 0; i < num_pairs; ++i)
+    {
+        if(pairs[i].x >= num_channels || pairs[i].y >= num_channels)
+        {
+            return -1;
+        }
+    }
+
+    memset(cs, 0, sizeof(*cs));
+    cs->samplerate = samplerate;
+    cs->num_channels = num_channels;
+    cs->num_pairs = num_pairs;
+    cs->frame_length = frame_length;
+    cs->hop = hop;
+    cs->num_bins = frame_length / 2 + 1;
+    cs->stride = (cs->num_bins + CROSS_SPECTRUM_BIN_ALIGN - 1) / CROSS_SPECTRUM_BIN_ALIGN * CROSS_SPECTRUM_BIN_ALIGN;
+
+    cs->p_pairs = (cross_spectrum_pair *) malloc(sizeof(cross_spectrum_pair) * (num_pairs ? num_pairs : 1));
+    cs->p_window = (double *) malloc(sizeof(double) * frame_length);
+    cs->p_pcm = (double *) malloc(sizeof(double) * frame_length * num_channels);
+    cs->p_in = (double *) fftw_malloc(sizeof(double) * frame_length * num_channels);
+    cs->p_spec = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * cs->stride * num_channels);
+    cs->p_rows = (const fftw_complex **) malloc(sizeof(fftw_complex *) * num_channels);
+    cs->p_gxx = (double *) fftw_malloc(sizeof(double) * cs->stride * num_channels);
+    cs->p_gxy = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * cs->stride * (num_pairs ? num_pairs : 1));
+
+    if(!cs->p_pairs || !cs->p_window || !cs->p_pcm || !cs->p_in || !cs->p_spec
+       || !cs->p_rows || !cs->p_gxx || !cs->p_gxy)
+    {
+        cross_spectrum_close(cs);
+        return -1;
+    }
+
+    /* Every channel in one batched transform */
+    n = (int) frame_length;
+    cs->plan = fftw_plan_many_dft_r2c(1, &n, (int) num_channels
+                                      ,cs->p_in, NULL, 1, n
+                                      ,cs->p_spec, NULL, 1, (int) cs->stride
+                                      ,FFTW_ESTIMATE);
+    if(!cs->plan)
+    {
+        cross_spectrum_close(cs);
+        return -1;
+    }
+
+    if(num_pairs)
+    {
+        memcpy(cs->p_pairs, pairs, sizeof(cross_spectrum_pair) * num_pairs);
+    }
+
+    for(c = 0; c < num_channels; ++c)
+    {
+        cs->p_rows[c] = cs->p_spec + (size_t) c * cs->stride;
+    }
+
+    for(i = 0; i < frame_length; ++i)
+    {
+        cs->p_window[i] = 0.5 * (1.0 - cos(2 * M_PI * i / frame_length));
+    }
+
+    cross_spectrum_reset(cs);
+
+    return 0;
+}
+
+void cross_spectrum_close(cross_spectrum *cs)
+{
+    if(!cs)
+    {
+        return;
+    }
+
+    if(cs->plan)
+    {
+        fftw_destroy_plan(cs->plan);
+    }
+    free(cs->p_pairs);
+    free(cs->p_window);
+    free(cs->p_pcm);
+    fftw_free(cs->p_in);
+    fftw_free(cs->p_spec);
+    free((void *) cs->p_rows);
+    fftw_free(cs->p_gxx);
+    fftw_free(cs->p_gxy);
+    memset(cs, 0, sizeof(*cs));
+}
+
+void cross_spectrum_reset(cross_spectrum *cs)
+{
+    memset(cs->p_pcm, 0, sizeof(double) * cs->frame_length * cs->num_channels);
+    memset(cs->p_gxx, 0, sizeof(double) * cs->stride * cs->num_channels);
+    memset(cs->p_gxy, 0, sizeof(fftw_complex) * cs->stride * (cs->num_pairs ? cs->num_pairs : 1));
+    cs->fill = 0;
+    cs->num_averages = 0;
+}
+
+void cross_spectrum_process
+(
+    cross_spectrum *cs
+    ,const float *input
+    ,unsigned long framesPerBuffer
+)
+{
+    unsigned long i;
+    unsigned int c;
+    const unsigned int channels = cs->num_channels;
+
+    for(i = 0; i < framesPerBuffer; ++i)
+    {
+        for(c = 0; c < channels; ++c)
+        {
+            cs->p_pcm[(size_t) c * cs->frame_length + cs->fill] = input[i * channels + c];
+        }
+
+        if(++cs->fill == cs->frame_length)
+        {
+            cross_spectrum_frame(cs);
+        }
+    }
+}
+
+void cross_spectrum_accumulate
+(
+    cross_spectrum *cs
+    ,const fftw_complex * const *p_spectra
+)
+{
+    unsigned int c, p, k;
+    const unsigned int bins = cs->num_bins;
+    const fftw_complex * restrict p_x;
+    const fftw_complex * restrict p_y;
+    double * restrict p_xx;
+    fftw_complex * restrict p_xy;
+
+    /**
+     *  Plain multiply-accumulate loops over contiguous bins,
+     *  which the compiler vectorizes
+    **/
+    for(c = 0; c < cs->num_channels; ++c)
+    {
+        p_x = p_spectra[c];
+        p_xx = cs->p_gxx + (size_t) c * cs->stride;
+        for(k = 0; k < bins; ++k)
+        {
+            p_xx[k] += p_x[k][0] * p_x[k][0] + p_x[k][1] * p_x[k][1];
+        }
+    }
+
+    /* conj(X) * Y */
+    for(p = 0; p < cs->num_pairs; ++p)
+    {
+        p_x = p_spectra[cs->p_pairs[p].x];
+        p_y = p_spectra[cs->p_pairs[p].y];
+        p_xy = cs->p_gxy + (size_t) p * cs->stride;
+        for(k = 0; k < bins; ++k)
+        {
+            p_xy[k][0] += p_x[k][0] * p_y[k][0] + p_x[k][1] * p_y[k][1];
+            p_xy[k][1] += p_x[k][0] * p_y[k][1] - p_x[k][1] * p_y[k][0];
+        }
+    }
+
+    ++cs->num_averages;
+}
+
+unsigned long cross_spectrum_coherence
+(
+    const cross_spectrum *cs
+    ,unsigned int pair
+    ,double *p_out
+)
+{
+    unsigned int k;
+    double den;
+    const double *p_xx, *p_yy;
+    const fftw_complex *p_xy;
+
+    if(pair >= cs->num_pairs || !cs->num_averages)
+    {
+        return 0;
+    }
+
+    p_xx = cs->p_gxx + (size_t) cs->p_pairs[pair].x * cs->stride;
+    p_yy = cs->p_gxx + (size_t) cs->p_pairs[pair].y * cs->stride;
+    p_xy = cs->p_gxy + (size_t) pair * cs->stride;
+
+    for(k = 0; k < cs->num_bins; ++k)
+    {
+        den = p_xx[k] * p_yy[k];
+        p_out[k] = den > 0.0 ? (p_xy[k][0] * p_xy[k][0] + p_xy[k][1] * p_xy[k][1]) / den : 0.0;
+    }
+
+    return cs->num_averages;
+}
+
+unsigned long cross_spectrum_transfer
+(
+    const cross_spectrum *cs
+    ,unsigned int pair
+    ,double *p_gain_db
+    ,double *p_phase
+)
+{
+    unsigned int k;
+    const double *p_xx;
+    const fftw_complex *p_xy;
+
+    if(pair >= cs->num_pairs || !cs->num_averages)
+    {
+        return 0;
+    }
+
+    p_xx = cs->p_gxx + (size_t) cs->p_pairs[pair].x * cs->stride;
+    p_xy = cs->p_gxy + (size_t) pair * cs->stride;
+
+    /* H1 = Gxy / Gxx; Gxx is real so only the gain needs dividing */
+    for(k = 0; k < cs->num_bins; ++k)
+    {
+        if(p_gain_db)
+        {
+            p_gain_db[k] = 20.0 * log10(sqrt(p_xy[k][0] * p_xy[k][0] + p_xy[k][1] * p_xy[k][1])
+                                        / (p_xx[k] + CROSS_SPECTRUM_FLOOR) + CROSS_SPECTRUM_FLOOR);
+        }
+        if(p_phase)
+        {
+            p_phase[k] = atan2(p_xy[k][1], p_xy[k][0]);
+        }
+    }
+
+    return cs->num_averages;
+}
+
+/**
+ *  Window and transform the full frame in p_pcm, accumulate it
+ *  and keep the last frame_length - hop samples for the next one
+**/
+static void cross_spectrum_frame(cross_spectrum *cs)
+{
+    unsigned int c, i;
+    const unsigned int n = cs->frame_length;
+    const unsigned int keep = n - cs->hop;
+    double *p_row;
+
+    for(c = 0; c < cs->num_channels; ++c)
+    {
+        p_row = cs->p_pcm + (size_t) c * n;
+        for(i = 0; i < n; ++i)
+        {
+            cs->p_in[(size_t) c * n + i] = p_row[i] * cs->p_window[i];
+        }
+        memmove(p_row, p_row + cs->hop, sizeof(double) * keep);
+    }
+
+    fftw_execute(cs->plan);
+    cross_spectrum_accumulate(cs, cs->p_rows);
+
+    cs->fill = keep;
+}
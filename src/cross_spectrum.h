@@ -0,0 +1,163 @@
+#ifndef CROSS_SPECTRUM_H
+#define CROSS_SPECTRUM_H
+
+#include "fftw3.h"
+
+/** Channel x is the reference (input), y the response (output) **/
+typedef struct
+{
+    unsigned int x;
+    unsigned int y;
+
+} cross_spectrum_pair;
+
+/**
+ *  Averaged auto and cross spectra between channels.
+ *
+ *  Every channel is windowed and transformed by one batched r2c
+ *  plan, then per frame
+ *      Gxx[c] += |X_c|^2           for every channel
+ *      Gxy[p] += conj(X_x) * X_y   for every pair
+ *  From the sums come coherence |Gxy|^2 / (Gxx Gyy) and the H1
+ *  transfer function estimate Gxy / Gxx.
+**/
+typedef struct
+{
+    unsigned int samplerate;
+    unsigned int num_channels;
+    unsigned int num_pairs;
+    unsigned int frame_length;
+    unsigned int hop;
+    unsigned int num_bins;
+
+    /**
+     * Distance between channels in p_spec, p_gxx and p_gxy,
+     * rounded up so each channel keeps the buffer alignment
+    **/
+    unsigned int stride;
+
+    cross_spectrum_pair *p_pairs;
+
+    /** Hann window, frame_length long **/
+    double *p_window;
+
+    /**
+     * De-interleaved input, one frame_length row per channel,
+     * filled up to fill; a full frame is transformed and then
+     * shifted down by hop
+    **/
+    double *p_pcm;
+    unsigned int fill;
+
+    /** Windowed copy of p_pcm, the plan's input **/
+    double *p_in;
+    fftw_complex *p_spec;
+    fftw_plan plan;
+
+    /** Row pointers into p_spec for cross_spectrum_accumulate **/
+    const fftw_complex **p_rows;
+
+    /** Running sums: Gxx per channel, Gxy per pair **/
+    double *p_gxx;
+    fftw_complex *p_gxy;
+    unsigned long num_averages;
+
+} cross_spectrum;
+
+/** ------------------------------------------
+ *  cross_spectrum_init
+ *  ------------------------------------------
+ *      Analyses num_channels interleaved
+ *      channels in frames of frame_length
+ *      taken every hop samples, for the
+ *      num_pairs channel pairs in pairs.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int cross_spectrum_init
+(
+    cross_spectrum *cs
+    ,unsigned int samplerate
+    ,unsigned int num_channels
+    ,unsigned int frame_length
+    ,unsigned int hop
+    ,const cross_spectrum_pair *pairs
+    ,unsigned int num_pairs
+);
+
+/** ------------------------------------------
+ *  cross_spectrum_close
+ *  ------------------------------------------
+ *      Destroys the plan and frees buffers
+ *  ==========================================
+**/
+void cross_spectrum_close(cross_spectrum *cs);
+
+/** ------------------------------------------
+ *  cross_spectrum_reset
+ *  ------------------------------------------
+ *      Clears the input and the averages
+ *  ==========================================
+**/
+void cross_spectrum_reset(cross_spectrum *cs);
+
+/** ----------------------------------------------------
+ *  cross_spectrum_process
+ *  ----------------------------------------------------
+ *      Feeds framesPerBuffer frames of interleaved
+ *      input (num_channels samples per frame)
+ *  ====================================================
+**/
+void cross_spectrum_process
+(
+    cross_spectrum *cs
+    ,const float *input
+    ,unsigned long framesPerBuffer
+);
+
+/** ----------------------------------------------------
+ *  cross_spectrum_accumulate
+ *  ----------------------------------------------------
+ *      Adds one frame of spectra computed elsewhere,
+ *      e.g. fft_block's fft_out_cmplx.  p_spectra
+ *      holds num_channels pointers to num_bins bins
+ *  ====================================================
+**/
+void cross_spectrum_accumulate
+(
+    cross_spectrum *cs
+    ,const fftw_complex * const *p_spectra
+);
+
+/** ----------------------------------------------------
+ *  cross_spectrum_coherence
+ *  ----------------------------------------------------
+ *      Magnitude squared coherence of pair, 0..1 per
+ *      bin.  Returns the number of averages, 0 if
+ *      p_out was not written
+ *  ====================================================
+**/
+unsigned long cross_spectrum_coherence
+(
+    const cross_spectrum *cs
+    ,unsigned int pair
+    ,double *p_out
+);
+
+/** ----------------------------------------------------
+ *  cross_spectrum_transfer
+ *  ----------------------------------------------------
+ *      H1 estimate of pair as gain in dB and phase in
+ *      radians; either output may be NULL.  Returns
+ *      the number of averages, 0 if nothing was written
+ *  ====================================================
+**/
+unsigned long cross_spectrum_transfer
+(
+    const cross_spectrum *cs
+    ,unsigned int pair
+    ,double *p_gain_db
+    ,double *p_phase
+);
+
+#endif
@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "fft_batch.h"
+#include "fft_window.h"
+
+/* Rows are padded to 64 bytes: 8 samples, 4 bins */
+#define FFT_BATCH_IN_ALIGN      8
+#define FFT_BATCH_OUT_ALIGN     4
+
+
+int fft_batch_init
+(
+    fft_batch *batch
+    ,unsigned int frame_length
+    ,unsigned int max_frames
+    ,unsigned int flags
+)
+{
+    int n;
+    size_t in_count, out_count;
+
+    if(!batch || frame_length < 2 || !max_frames)
+    {
+        return -1;
+    }
+
+    memset(batch, 0, sizeof(*batch));
+    batch->frame_length = frame_length;
+    batch->num_bins = frame_length / 2 + 1;
+    batch->max_frames = max_frames;
+    batch->in_stride = (frame_length + FFT_BATCH_IN_ALIGN - 1) / FFT_BATCH_IN_ALIGN * FFT_BATCH_IN_ALIGN;
+    batch->out_stride = (batch->num_bins + FFT_BATCH_OUT_ALIGN - 1) / FFT_BATCH_OUT_ALIGN * FFT_BATCH_OUT_ALIGN;
+
+    in_count = (size_t) batch->in_stride * max_frames;
+    out_count = (size_t) batch->out_stride * max_frames;
+
+    batch->p_window = (double *) malloc(sizeof(double) * frame_length);
+    batch->p_in = (double *) fftw_malloc(sizeof(double) * in_count);
+    batch->p_out = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * out_count);
+    batch->p_mag = (double *) fftw_malloc(sizeof(double) * out_count);
+
+    if(!batch->p_window || !batch->p_in || !batch->p_out || !batch->p_mag)
+    {
+        fft_batch_close(batch);
+        return -1;
+    }
+
+    /* Planning with FFTW_MEASURE scribbles on the arrays; fill after */
+    n = (int) frame_length;
+    batch->plan = fftw_plan_many_dft_r2c(1, &n, (int) max_frames
+                                         ,batch->p_in, NULL, 1, (int) batch->in_stride
+                                         ,batch->p_out, NULL, 1, (int) batch->out_stride
+                                         ,flags);
+    batch->row_plan = fftw_plan_dft_r2c_1d(n, batch->p_in, batch->p_out, flags);
+
+    if(!batch->plan || !batch->row_plan)
+    {
+        fft_batch_close(batch);
+        return -1;
+    }
+
+    /* The window code fft_block uses, so spectra match */
+    fill_window(batch->p_window, frame_length, FFT_BLOCK_WINDOW_HANN);
+
+    /* Padding is never written by loads; keep it defined */
+    memset(batch->p_in, 0, sizeof(double) * in_count);
+
+    return 0;
+}
+
+void fft_batch_close(fft_batch *batch)
+{
+    if(!batch)
+    {
+        return;
+    }
+
+    if(batch->plan)
+    {
+        fftw_destroy_plan(batch->plan);
+    }
+    if(batch->row_plan)
+    {
+        fftw_destroy_plan(batch->row_plan);
+    }
+    free(batch->p_window);
+    fftw_free(batch->p_in);
+    fftw_free(batch->p_out);
+    fftw_free(batch->p_mag);
+    memset(batch, 0, sizeof(*batch));
+}
+
+int fft_batch_load(fft_batch *batch, const float *samples)
+{
+    unsigned int i;
+    double * restrict p_row;
+    const double * restrict p_win = batch->p_window;
+
+    if(batch->num_frames == batch->max_frames)
+    {
+        return -1;
+    }
+
+    p_row = batch->p_in + (size_t) batch->num_frames * batch->in_stride;
+    for(i = 0; i < batch->frame_length; ++i)
+    {
+        p_row[i] = samples[i] * p_win[i];
+    }
+
+    return (int) batch->num_frames++;
+}
+
+unsigned int fft_batch_gather
+(
+    fft_batch *batch
+    ,const float *samples
+    ,unsigned long num_samples
+    ,unsigned int hop
+)
+{
+    unsigned int loaded = 0;
+    unsigned long pos = 0;
+
+    if(!hop)
+    {
+        return 0;
+    }
+
+    while(pos + batch->frame_length <= num_samples
+          && fft_batch_load(batch, samples + pos) >= 0)
+    {
+        ++loaded;
+        pos += hop;
+    }
+
+    return loaded;
+}
+
+unsigned int fft_batch_execute(fft_batch *batch)
+{
+    unsigned int r, k;
+    const unsigned int rows = batch->num_frames;
+    const unsigned int bins = batch->num_bins;
+    const fftw_complex * restrict p_x;
+    double * restrict p_m;
+
+    if(!rows)
+    {
+        return 0;
+    }
+
+    /**
+     *  A full batch is one plan call.  A short one (end of a
+     *  file) runs the single row plan on each loaded row rather
+     *  than transforming stale rows
+    **/
+    if(rows == batch->max_frames)
+    {
+        fftw_execute(batch->plan);
+    }
+    else
+    {
+        for(r = 0; r < rows; ++r)
+        {
+            fftw_execute_dft_r2c(batch->row_plan
+                                 ,batch->p_in + (size_t) r * batch->in_stride
+                                 ,batch->p_out + (size_t) r * batch->out_stride);
+        }
+    }
+
+    /**
+     *  Power first in a branch free pass the compiler vectorizes,
+     *  then dB in place.  10 log10 |X|^2 == 20 log10 |X|, as
+     *  convert_mag computes it
+    **/
+    for(r = 0; r < rows; ++r)
+    {
+        p_x = batch->p_out + (size_t) r * batch->out_stride;
+        p_m = batch->p_mag + (size_t) r * batch->out_stride;
+        for(k = 0; k < bins; ++k)
+        {
+            p_m[k] = p_x[k][0] * p_x[k][0] + p_x[k][1] * p_x[k][1];
+        }
+        for(k = 0; k < bins; ++k)
+        {
+            p_m[k] = 10.0 * log10(p_m[k]);
+        }
+    }
+
+    batch->num_frames = 0;
+
+    return rows;
+}
@@ -0,0 +1,109 @@
+#ifndef FFT_BATCH_H
+#define FFT_BATCH_H
+
+#include "fftw3.h"
+
+/**
+ *  Throughput oriented spectra for offline work.
+ *
+ *  Up to max_frames windows are gathered as rows of one matrix
+ *  and transformed by a single batched r2c plan, after which
+ *  magnitudes are taken over the whole matrix in one pass.  Rows
+ *  are padded to 64 bytes so every row has the alignment the
+ *  plan was made for.  Windowing and dB scaling match
+ *  fft_block_process, so results are interchangeable.
+**/
+typedef struct
+{
+    unsigned int frame_length;
+    unsigned int num_bins;
+    unsigned int max_frames;
+
+    /** Row distances in p_in (samples) and p_out / p_mag (bins) **/
+    unsigned int in_stride;
+    unsigned int out_stride;
+
+    /** Hann window, the same one fft_block applies **/
+    double *p_window;
+
+    double *p_in;
+    fftw_complex *p_out;
+
+    /** dB magnitudes, max_frames rows of out_stride **/
+    double *p_mag;
+
+    /**
+     * Plan over all max_frames rows, plus a single row plan
+     * for batches that come up short
+    **/
+    fftw_plan plan;
+    fftw_plan row_plan;
+
+    /** Rows loaded since the last execute **/
+    unsigned int num_frames;
+
+} fft_batch;
+
+/** ------------------------------------------
+ *  fft_batch_init
+ *  ------------------------------------------
+ *      Prepares batches of up to max_frames
+ *      windows of frame_length samples.
+ *      flags are FFTW planner flags.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int fft_batch_init
+(
+    fft_batch *batch
+    ,unsigned int frame_length
+    ,unsigned int max_frames
+    ,unsigned int flags
+);
+
+/** ------------------------------------------
+ *  fft_batch_close
+ *  ------------------------------------------
+ *      Destroys plans and frees buffers
+ *  ==========================================
+**/
+void fft_batch_close(fft_batch *batch);
+
+/** ----------------------------------------------------
+ *  fft_batch_load
+ *  ----------------------------------------------------
+ *      Windows frame_length samples into the next free
+ *      row, for gathering frames from several sources.
+ *      Returns the row index, -1 if the batch is full
+ *  ====================================================
+**/
+int fft_batch_load(fft_batch *batch, const float *samples);
+
+/** ----------------------------------------------------
+ *  fft_batch_gather
+ *  ----------------------------------------------------
+ *      Loads as many frames starting every hop samples
+ *      as fit both in the batch and in num_samples.
+ *      Returns the number of frames loaded
+ *  ====================================================
+**/
+unsigned int fft_batch_gather
+(
+    fft_batch *batch
+    ,const float *samples
+    ,unsigned long num_samples
+    ,unsigned int hop
+);
+
+/** ----------------------------------------------------
+ *  fft_batch_execute
+ *  ----------------------------------------------------
+ *      Transforms the loaded rows and fills p_mag.
+ *      Row i of p_out / p_mag starts at i * out_stride.
+ *      Returns the number of rows, after which the
+ *      batch is empty again
+ *  ====================================================
+**/
+unsigned int fft_batch_execute(fft_batch *batch);
+
+#endif
@@ -1,4 +1,6 @@
 #include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -7,7 +9,7 @@
 #include "gnuplot_i.h"
 
 #define FFT_BLOCK_DEFAULT_FFT_LENGTH    65536
-#define FFT_BLOCK_DEFAULT_SAMPLE_RATE   48000
+#define FFT_BLOCK_DEFAULT_SAMPLE_RATE   FFT_BLOCK_ANALYSIS_RATE
 
 
 /** 
@@ -22,73 +24,175 @@ static fft_block_ctx *_this = &gCTX;
 static gnuplot_ctrl *_ctrl;
 static unsigned int b_initialized = 0;
 
+/**
+ *  Layout handoff with fft_block_switch.  The control thread
+ *  publishes in gPending; the callback takes it only while
+ *  gRetired is empty and leaves the layout it replaced there
+ *  for the control thread to free
+**/
+static _Atomic(fft_block_layout *) gPending;
+static _Atomic(fft_block_layout *) gRetired;
+
+/* Hop for the next frame, set from any thread; 0 for one window */
+static atomic_uint gHop;
+
+/**
+ *  Settings of the live layout for fft_block_get_status.  The
+ *  callback rewrites them whenever it takes a layout, with
+ *  gStatusSequence odd while it does; readers retry until
+ *  they see the same even sequence before and after
+**/
+static atomic_uint gStatusSequence;
+static atomic_uint gStatusFftLength;
+static atomic_uint gStatusWindowLength;
+static atomic_int gStatusWindow;
+
+/**
+ *  Bin ranges from fft_block_request_bins.  The control thread
+ *  edits gRanges and mirrors it into gRangeLo/gRangeHi (hi 0
+ *  for a free slot) with gRangeSequence odd while it does.  The
+ *  callback copies them to mag_ranges only when it sees the
+ *  same even sequence before and after; otherwise it keeps the
+ *  ranges it has and looks again next callback
+**/
+static fft_block_range gRanges[FFT_BLOCK_MAX_RANGES];
+static atomic_uint gRangeSequence;
+static atomic_uint gRangeLo[FFT_BLOCK_MAX_RANGES];
+static atomic_uint gRangeHi[FFT_BLOCK_MAX_RANGES];
+
+/* Sequence of the ranges in mag_ranges; callback only */
+static unsigned int gRangeTaken;
+
+/**
+ *  Pipeline handoff with fft_block_set_pipeline, taken by the
+ *  callback like a layout; gNoPipeline asks it to detach.  Each
+ *  request and the attached pipeline hold one attach_count
+**/
+static _Atomic(pipeline *) gPipelinePending;
+static pipeline gNoPipeline;
+
+/* Frame length of the last pipeline requested, 0 for none; control thread only */
+static unsigned int gPipelineLength;
+
 /* ------------------------ Function Prototypes --------------------------- */
-void hanning(double *samples, const unsigned length);
 void convert_mag(const fftw_complex *in, double *out, const unsigned length);
+static int layout_init(fft_block_layout *layout, unsigned int fftlength, unsigned int window_length, fft_block_window window, unsigned int flags);
+static void layout_close(fft_block_layout *layout);
+static void layout_free(fft_block_layout *layout);
+static void layout_swap(fft_block_layout *layout);
+static void layout_take(void);
+static void status_publish(void);
+static void ranges_publish(void);
+static void ranges_take(void);
+static void pipeline_take(void);
+static void analyse(const float *samples, unsigned long n, double first, double step);
 /* ------------------------------------------------------------------------ */
 
 
+void fft_block_default_config(fft_block_config *config)
+{
+    config->samplerate = FFT_BLOCK_DEFAULT_SAMPLE_RATE;
+    config->fft_length = FFT_BLOCK_DEFAULT_FFT_LENGTH;
+    config->window_length = 0;
+    config->window = FFT_BLOCK_WINDOW_HANN;
+    config->hop = 0;
+    config->plan_flags = FFTW_ESTIMATE;
+    config->resample_quality = RESAMPLER_MEDIUM;
+
+#if defined(_WIN32) || defined(__APPLE__)
+    config->use_gnuplot = 1;
+#else
+    /* gnuplot's window needs an X display */
+    config->use_gnuplot = getenv("DISPLAY") != NULL;
+#endif
+}
+
 int fft_block_init
 (
     unsigned int samplerate
     ,unsigned int fftlength
 )
+{
+    fft_block_config config;
+
+    fft_block_default_config(&config);
+    config.samplerate = samplerate;
+    config.fft_length = fftlength;
+
+    return fft_block_init_config(&config);
+}
+
+int fft_block_init_config(const fft_block_config *config)
 {
     unsigned i;
+    fft_block_layout layout;
 
-    if(b_initialized || samplerate != 48000)
+    if(b_initialized || !config->samplerate
+       || layout_init(&layout, config->fft_length, config->window_length, config->window, config->plan_flags) < 0)
     {
         return -1;
     }
 
+    /* Other device rates are converted before they reach the block buffer */
+    _this->input_rate = config->samplerate;
+    _this->b_resample = config->samplerate != FFT_BLOCK_ANALYSIS_RATE;
+    if(_this->b_resample)
+    {
+        if(resampler_init(&_this->resample, config->samplerate, FFT_BLOCK_ANALYSIS_RATE,
+                          config->resample_quality, FFT_BLOCK_RESAMPLE_BLOCK) < 0)
+        {
+            layout_close(&layout);
+            return -1;
+        }
+        _this->p_resampled = (float *) malloc(sizeof(float) * resampler_max_out(&_this->resample, FFT_BLOCK_RESAMPLE_BLOCK));
+        if(!_this->p_resampled)
+        {
+            resampler_close(&_this->resample);
+            layout_close(&layout);
+            return -1;
+        }
+    }
+
     /* Avoid double initializing */
     b_initialized = 1;
 
-    /* Init SIZES */
+    /* Init SIZES and buffers; the ctx was empty, so is layout now */
+    layout_swap(&layout);
+    status_publish();
     _this->num_samples = 0;
-    _this->pcm_length = fftlength;
-    _this->fft_length = fftlength / 2 + 1; /* real to complex concatenation */
-
-    /* Init PORTAUDIO */
-    _this->p_pcm_samples = (double *) malloc(sizeof(double) * _this->pcm_length);
-    _this->p_fft_mag = (double *) malloc(sizeof(double) * _this->fft_length );
-
-    /* Init FFTW */
-    _this->fft_out_cmplx = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * _this->fft_length );
-    _this->p_freq_bins = (double *) malloc(sizeof(double) * _this->fft_length );
-    _this->plan = fftw_plan_dft_r2c_1d(fftlength
-                                       ,_this->p_pcm_samples
-                                       ,_this->fft_out_cmplx
-                                       ,FFTW_ESTIMATE
-                                       );
+    _this->skip = 0;
+    atomic_store(&_this->frames, 0);
+    atomic_store(&_this->plan_flags, config->plan_flags);
+    atomic_store(&gHop, config->hop);
+
+    /* Nothing converted yet: stamps start behind mag_frame */
+    _this->mag_frame = 1;
+    for(i = 0; i < FFT_BLOCK_MAX_RANGES; ++i)
+    {
+        gRanges[i].in_use = 0;
+    }
+    ranges_publish();
+    ranges_take();
 
     /* Init GNUPLOT and setup window */
-    _ctrl = gnuplot_init();
+    _ctrl = config->use_gnuplot ? gnuplot_init() : NULL;
 
-#ifdef _WIN32
-	gnuplot_cmd(_ctrl, "set term wxt title \"FFT Block Window\"");
+    if(_ctrl)
+    {
+#if defined(_WIN32)
+        gnuplot_cmd(_ctrl, "set term wxt title \"FFT Block Window\"");
+#elif defined(__APPLE__)
+        gnuplot_cmd(_ctrl, "set term aqua title \"FFT Block Window\"");
 #else
-    gnuplot_cmd(_ctrl, "set term aqua title \"FFT Block Window\"");
+        gnuplot_cmd(_ctrl, "set term x11 title \"FFT Block Window\"");
 #endif
-    gnuplot_cmd(_ctrl, "set title \"Microphone Audio Spectrum\"");
-    gnuplot_cmd(_ctrl, "set logscale x");
-    gnuplot_cmd(_ctrl, "set yrange [0:100]");
-    gnuplot_cmd(_ctrl, "set xrange [20:20000]");
-    gnuplot_cmd(_ctrl, "set ylabel \"Magnitude (dB)\"");
-    gnuplot_cmd(_ctrl, "set xlabel \"Frequency (Hz)\"");
-    gnuplot_setstyle(_ctrl, "lines");
-
-    /** ------------------------------------------------------
-     *  Fill Frequency bins
-     *  ------------------------------------------------------
-     *  Each bin will be: (Sample Rate) / (FFT Length) Hz wide
-     *  ie:  Sample Rate: 48 kHz, FFT Length: 8192
-     *          48000 / 8192 = 5.86 Hz
-     *  ======================================================
-    **/
-    for(i = 0; i < _this->fft_length; ++i)
-    {
-        _this->p_freq_bins[i] = (i * ((float) FFT_BLOCK_DEFAULT_SAMPLE_RATE) / _this->pcm_length);
+        gnuplot_cmd(_ctrl, "set title \"Microphone Audio Spectrum\"");
+        gnuplot_cmd(_ctrl, "set logscale x");
+        gnuplot_cmd(_ctrl, "set yrange [0:100]");
+        gnuplot_cmd(_ctrl, "set xrange [20:20000]");
+        gnuplot_cmd(_ctrl, "set ylabel \"Magnitude (dB)\"");
+        gnuplot_cmd(_ctrl, "set xlabel \"Frequency (Hz)\"");
+        gnuplot_setstyle(_ctrl, "lines");
     }
 
     return 0;
@@ -96,19 +200,50 @@ int fft_block_init
 
 void fft_block_close()
 {
+    fft_block_layout layout;
+
     if(!b_initialized)
     {
         return;
     }
 
-    /* Free dynamic memory. 4 malloc's == 4 free's */
-    free(_this->p_pcm_samples);
-    free(_this->p_fft_mag);
-    free(_this->p_freq_bins);
-    fftw_free(_this->fft_out_cmplx);
+    /* Drop a switch still in flight, then the live layout */
+    layout_free(atomic_exchange(&gPending, NULL));
+    fft_block_set_pipeline(NULL);
+    pipeline_take();
+    fft_block_reclaim();
+
+    memset(&layout, 0, sizeof(layout));
+    layout_swap(&layout);
+    layout_close(&layout);
 
     /* Close GNUPLOT handle */
-    gnuplot_close(_ctrl);
+    if(_ctrl)
+    {
+        gnuplot_close(_ctrl);
+        _ctrl = NULL;
+    }
+
+    if(_this->b_resample)
+    {
+        resampler_close(&_this->resample);
+        free(_this->p_resampled);
+        _this->p_resampled = NULL;
+        _this->b_resample = 0;
+    }
+
+    _this->p_tones = NULL;
+    _this->p_psd = NULL;
+    _this->p_features = NULL;
+    _this->p_pub = NULL;
+    _this->p_shm = NULL;
+    _this->p_render = NULL;
+    _this->p_fir = NULL;
+    _this->p_latency = NULL;
+    _this->p_history = NULL;
+    _this->p_archive = NULL;
+    _this->p_trigger = NULL;
+    _this->p_pitch = NULL;
 
     /* Now we can initialize again */
     b_initialized = 0;
@@ -122,71 +257,453 @@ int fft_block_process
     ,void *userData
 )
 {
-    unsigned long i;
+    unsigned long i, n, m;
+    double step;
+
+    (void) userData;
 
     if(!b_initialized)
     {   /* Trying to process before initializing */
         return paAbort;
     }
 
-    for(i = 0; i < framesPerBuffer; ++i)
+    if(_this->p_latency)
     {
-        /* Copy input to p_pcm_samples and passthrough to output */
-        *output++ = _this->p_pcm_samples[_this->num_samples++] = *input++;
+        latency_stats_buffer(_this->p_latency, framesPerBuffer);
+    }
+
+    /* Pick up a new length or window between frames */
+    if(atomic_load_explicit(&gPending, memory_order_relaxed))
+    {
+        layout_take();
+    }
+    if(atomic_load_explicit(&gPipelinePending, memory_order_relaxed))
+    {
+        pipeline_take();
+    }
+    if(atomic_load_explicit(&gRangeSequence, memory_order_relaxed) != gRangeTaken)
+    {
+        ranges_take();
+    }
+
+    /* Passthrough at the device rate */
+    if(output != input)
+    {
+        memcpy(output, input, sizeof(float) * framesPerBuffer);
+    }
+
+    if(!_this->b_resample)
+    {
+        analyse(input, framesPerBuffer, 0.0, 1.0);
+    }
+    else
+    {
+        /**
+         *  Convert in pieces the resampler was sized for.  A
+         *  piece's last output is about its last input, held
+         *  back by the filter delay; outputs are step inputs apart
+        **/
+        step = (double) _this->resample.down / _this->resample.up;
+        for(i = 0; i < framesPerBuffer; i += n)
+        {
+            n = framesPerBuffer - i < FFT_BLOCK_RESAMPLE_BLOCK ? framesPerBuffer - i : FFT_BLOCK_RESAMPLE_BLOCK;
+            m = resampler_process(&_this->resample, input + i, n, _this->p_resampled);
+            analyse(_this->p_resampled, m, (double) (i + n - 1) - (_this->resample.delay + m - 1) * step, step);
+        }
+    }
+
+    /* Long filters on the passthrough, one block of latency */
+    if(_this->p_fir)
+    {
+        fir_conv_process(_this->p_fir, output, output, framesPerBuffer);
+    }
+
+    /* Everything worked fine */
+    return paContinue;
+}
+
+/**
+ *  Runs n samples at the analysis rate through the trackers and
+ *  the block buffer, transforming every full window.  Sample i
+ *  was captured at position first + i * step of the current
+ *  callback's input
+**/
+static void analyse(const float *samples, unsigned long n, double first, double step)
+{
+    unsigned long i;
+    unsigned int j, hop = 0, keep = 0;
+    int b_chain;
+    unsigned long long capture_ns = 0;
+    unsigned long long stage_ns[LATENCY_NUM_STAGES];
+    latency_stats *p_lat = _this->p_latency;
+
+    /* Tone trackers see every sample, not just full blocks */
+    if(_this->p_tones)
+    {
+        sdft_bank_process(_this->p_tones, samples, n, NULL);
+    }
+    if(_this->p_psd)
+    {
+        welch_psd_process(_this->p_psd, samples, n);
+    }
+    if(_this->p_trigger)
+    {
+        trigger_push(_this->p_trigger, samples, n);
+    }
+
+    for(i = 0; i < n; ++i)
+    {
+        /* Hop past the window: these samples start no frame */
+        if(_this->skip)
+        {
+            --_this->skip;
+            continue;
+        }
+
+        /* Copy input to p_pcm_samples */
+        _this->p_pcm_samples[_this->num_samples++] = samples[i];
 
         /* Check if we've buffered enough samples */
-        if(_this->num_samples == _this->pcm_length)
+        if(_this->num_samples == _this->window_length)
         {
-            /* Apply Hanning Window */
-            hanning(_this->p_pcm_samples, _this->pcm_length);
+            /**
+             *  The stage chain brings its own window.  When it has an
+             *  FFT of the block's length, its spectrum is the frame's
+             *  and the window and FFT below are skipped
+            **/
+            b_chain = _this->p_pipeline && pipeline_process(_this->p_pipeline, _this->p_pcm_samples) == 0
+                      && _this->p_pipeline->p_spectrum && _this->p_pipeline->spectrum_length == _this->fft_length;
+
+            /* Overlapping: keep the next frame's start unwindowed */
+            hop = atomic_load_explicit(&gHop, memory_order_relaxed);
+            hop = hop ? hop : _this->window_length;
+            keep = hop < _this->window_length ? _this->window_length - hop : 0;
+            if(keep)
+            {
+                memcpy(_this->p_overlap, _this->p_pcm_samples + hop, sizeof(double) * keep);
+            }
+
+            /* Apply the precomputed window */
+            if(!b_chain)
+            {
+                for(j = 0; j < _this->window_length; ++j)
+                {
+                    _this->p_pcm_samples[j] *= _this->p_window[j];
+                }
+            }
+
+            /* Frame age counts from its newest sample, samples[i] */
+            if(p_lat)
+            {
+                capture_ns = latency_stats_capture_ns(p_lat, first + i * step);
+                stage_ns[LATENCY_STAGE_WINDOW] = latency_now_ns();
+            }
             
             /* Perform FFT */
-            fftw_execute(_this->plan);
-            
-            /* Convert complex numbers into magnitudes */
-            convert_mag(_this->fft_out_cmplx, _this->p_fft_mag, _this->fft_length);
+            if(b_chain)
+            {
+                memcpy(_this->fft_out_cmplx, _this->p_pipeline->p_spectrum, sizeof(fftw_complex) * _this->fft_length);
+            }
+            else if(_this->plan)
+            {
+                fftw_execute(_this->plan);
+            }
+            else
+            {
+                pruned_fft_execute(&_this->pruned, _this->p_pcm_samples, _this->fft_out_cmplx);
+            }
+
+            if(p_lat)
+            {
+                stage_ns[LATENCY_STAGE_FFT] = latency_now_ns();
+            }
             
-            /* Clear gnuplot */
-            gnuplot_resetplot(_ctrl);
+            /* New frame: every magnitude chunk is now stale */
+            ++_this->mag_frame;
+            atomic_store_explicit(&_this->frames, atomic_load_explicit(&_this->frames, memory_order_relaxed) + 1,
+                                  memory_order_relaxed);
+
+            /* Convert the bins consumers registered for */
+            for(j = 0; j < FFT_BLOCK_MAX_RANGES; ++j)
+            {
+                if(_this->mag_ranges[j].in_use)
+                {
+                    fft_block_magnitude(_this->mag_ranges[j].lo, _this->mag_ranges[j].hi);
+                }
+            }
+
+            if(p_lat)
+            {
+                stage_ns[LATENCY_STAGE_MAGNITUDE] = latency_now_ns();
+            }
+
+            /* Events are judged on the frame; samples[i] is its newest */
+            if(_this->p_trigger)
+            {
+                fft_block_magnitude(0, _this->fft_length);
+                trigger_frame(_this->p_trigger, _this->p_fft_mag, _this->fft_length,
+                              (double) FFT_BLOCK_ANALYSIS_RATE / _this->pcm_length,
+                              _this->p_trigger->written - (n - 1 - i));
+            }
+
+            /* Extract compact features for downstream consumers */
+            if(_this->p_features)
+            {
+                spectral_features_process(_this->p_features, _this->fft_out_cmplx, &_this->features);
+            }
+
+            /* One inverse transform of the same spectrum */
+            if(_this->p_pitch)
+            {
+                pitch_process(_this->p_pitch, _this->fft_out_cmplx, &_this->pitch);
+            }
+
+            /* Hand the frame to shared memory readers */
+            if(_this->p_shm && _this->p_shm->p_header->bins == _this->fft_length)
+            {
+                fft_block_magnitude(0, _this->fft_length);
+                spectrum_shm_publish(_this->p_shm, _this->p_fft_mag, _this->fft_length);
+            }
+
+            /* Keep a compact record of past frames */
+            if(_this->p_history && _this->p_history->bins == _this->fft_length)
+            {
+                fft_block_magnitude(0, _this->fft_length);
+                spec_history_push(_this->p_history, _this->p_fft_mag);
+            }
+            if(_this->p_archive && _this->p_archive->bins == _this->fft_length)
+            {
+                fft_block_magnitude(0, _this->fft_length);
+                spec_archive_append(_this->p_archive, spec_archive_clock_ns(), _this->p_fft_mag);
+            }
+
+            /* Stream to subscribing processes */
+            if(_this->p_pub)
+            {
+                if(_this->p_pub->content & SPECTRUM_PUB_SEND_SPECTRUM)
+                {
+                    fft_block_magnitude(0, _this->fft_length);
+                    spectrum_pub_spectrum(_this->p_pub, _this->p_fft_mag, _this->fft_length);
+                }
+                if(_this->p_pub->content & (SPECTRUM_PUB_SEND_SPECTRUM_U8 | SPECTRUM_PUB_SEND_SPECTRUM_U16))
+                {
+                    fft_block_magnitude(0, _this->fft_length);
+                    spectrum_pub_spectrum_quant(_this->p_pub, _this->p_fft_mag, _this->fft_length,
+                        (_this->p_pub->content & SPECTRUM_PUB_SEND_SPECTRUM_U8) ? SPEC_QUANT_U8 : SPEC_QUANT_U16);
+                }
+                if(_this->p_features)
+                {
+                    spectrum_pub_features(_this->p_pub, &_this->features);
+                }
+            }
             
-            /* Plot magnitudes vs. frequencies */
-            gnuplot_plot_xy(_ctrl, _this->p_freq_bins, _this->p_fft_mag, _this->fft_length, "");
+            if(_ctrl)
+            {
+                /* Clear gnuplot */
+                gnuplot_resetplot(_ctrl);
 
-            /* Wrap around to start of p_pcm_samples */
-            _this->num_samples -= _this->pcm_length;
+                /* Plot magnitudes vs. frequencies, visible range only */
+                fft_block_magnitude(_this->plot_lo, _this->plot_hi);
+                gnuplot_plot_xy(_ctrl
+                                ,_this->p_freq_bins + _this->plot_lo
+                                ,_this->p_fft_mag + _this->plot_lo
+                                ,_this->plot_hi - _this->plot_lo
+                                ,"");
+            }
+
+            /* Draw without an external process */
+            if(_this->p_render)
+            {
+                fft_block_magnitude(_this->p_render->p_col_lo[0],
+                                    _this->p_render->p_col_hi[_this->p_render->width - 1]);
+                spectrum_render_frame(_this->p_render, _this->p_fft_mag, _this->fft_length);
+            }
+
+            if(p_lat)
+            {
+                stage_ns[LATENCY_STAGE_OUTPUT] = latency_now_ns();
+                latency_stats_frame(p_lat, capture_ns, stage_ns);
+            }
+
+            /* Start the next frame hop samples on */
+            if(keep)
+            {
+                memcpy(_this->p_pcm_samples, _this->p_overlap, sizeof(double) * keep);
+            }
+            _this->num_samples = keep;
+            _this->skip = hop > _this->window_length ? hop - _this->window_length : 0;
         }
     }
+}
 
-    /* Everything worked fine */
-    return paContinue;
+void fft_block_set_tone_bank(sdft_bank *bank)
+{
+    _this->p_tones = bank;
+}
+
+void fft_block_set_psd(welch_psd *psd)
+{
+    _this->p_psd = psd;
+}
+
+int fft_block_set_features(spectral_features_ctx *features)
+{
+    if(features && (features->pcm_length != _this->pcm_length
+                    || spectral_features_set_window(features, _this->p_window, _this->window_length) < 0))
+    {
+        return -1;
+    }
+
+    _this->p_features = features;
+    return 0;
+}
+
+void fft_block_set_publisher(spectrum_pub *pub)
+{
+    _this->p_pub = pub;
+}
+
+void fft_block_set_shm(spectrum_shm *shm)
+{
+    _this->p_shm = shm;
+}
+
+void fft_block_set_renderer(spectrum_render *render)
+{
+    _this->p_render = render;
+}
+
+void fft_block_set_fir(fir_conv *fir)
+{
+    _this->p_fir = fir;
+}
+
+void fft_block_set_latency(latency_stats *lat)
+{
+    _this->p_latency = lat;
+}
+
+void fft_block_set_history(spec_history *hist)
+{
+    _this->p_history = hist;
+}
+
+void fft_block_set_archive(spec_archive *arch)
+{
+    _this->p_archive = arch;
+}
+
+void fft_block_set_trigger(trigger_engine *trig)
+{
+    _this->p_trigger = trig;
+}
+
+int fft_block_set_pitch(pitch_tracker *pt)
+{
+    if(pt && (pt->pcm_length != _this->pcm_length
+              || pitch_set_window(pt, _this->p_window, _this->window_length) < 0))
+    {
+        return -1;
+    }
+
+    _this->p_pitch = pt;
+    return 0;
+}
+
+int fft_block_set_pipeline(pipeline *p)
+{
+    pipeline *old;
+
+    if(p && (!b_initialized || !p->b_built || p->frame_length != _this->window_length))
+    {
+        return -1;
+    }
+
+    if(p)
+    {
+        atomic_fetch_add(&p->attach_count, 1);
+    }
+    gPipelineLength = p ? p->frame_length : 0;
+
+    /* A request the callback has not picked up yet is dropped */
+    old = atomic_exchange_explicit(&gPipelinePending, p ? p : &gNoPipeline, memory_order_acq_rel);
+    if(old && old != &gNoPipeline)
+    {
+        atomic_fetch_sub_explicit(&old->attach_count, 1, memory_order_release);
+    }
+
+    return 0;
+}
+
+int fft_block_request_bins(unsigned int lo, unsigned int hi)
+{
+    int i;
+    fft_block_status status;
+
+    /* The live length comes from the status, not the fields the callback swaps */
+    if(fft_block_get_status(&status) < 0 || lo >= hi || hi > status.fft_length / 2 + 1)
+    {
+        return -1;
+    }
+
+    for(i = 0; i < FFT_BLOCK_MAX_RANGES; ++i)
+    {
+        if(!gRanges[i].in_use)
+        {
+            gRanges[i].lo = lo;
+            gRanges[i].hi = hi;
+            gRanges[i].in_use = 1;
+            ranges_publish();
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void fft_block_release_bins(int handle)
+{
+    if(handle >= 0 && handle < FFT_BLOCK_MAX_RANGES && gRanges[handle].in_use)
+    {
+        gRanges[handle].in_use = 0;
+        ranges_publish();
+    }
 }
 
 /**
- *  Apply Hanning window to samples to smooth edges of sample blocks
- *  More info here: http://en.wikipedia.org/wiki/Hann_function
+ *  Convert whichever chunks overlapping [lo, hi) have not been
+ *  converted for this frame.  Overlapping requests therefore
+ *  never convert a bin twice
 **/
-void hanning
-(
-    double *samples
-    ,const unsigned length
-)
+const double *fft_block_magnitude(unsigned int lo, unsigned int hi)
 {
-    unsigned i;
-    double mult;
-    int N = length - 1;
-    
-    
-    for (i = 0; i < length; ++i) {
-        /* Calculate Hanning multiplier w(n) and scale the sample by it */
-        mult = 0.5 * (1.0 - cos(2 * M_PI * i / N));
-        samples[i] = mult * samples[i];
+    unsigned int c, start, end;
+
+    if(hi > _this->fft_length)
+    {
+        hi = _this->fft_length;
     }
+
+    for(c = lo / FFT_BLOCK_MAG_CHUNK; c * FFT_BLOCK_MAG_CHUNK < hi; ++c)
+    {
+        if(_this->p_mag_stamp[c] == _this->mag_frame)
+        {
+            continue;
+        }
+
+        start = c * FFT_BLOCK_MAG_CHUNK;
+        end = start + FFT_BLOCK_MAG_CHUNK < _this->fft_length ? start + FFT_BLOCK_MAG_CHUNK : _this->fft_length;
+        convert_mag(_this->fft_out_cmplx + start, _this->p_fft_mag + start, end - start);
+        _this->p_mag_stamp[c] = _this->mag_frame;
+    }
+
+    return _this->p_fft_mag;
 }
 
 /**
  *  Convert complex numbers to magnitudes.  This is done
  *  by taking the square root of the sum of squares of
- *  real and imaginary parts.  20 * log(n) => dB
+ *  real and imaginary parts.  20 * log10(n) => dB
 **/
 void convert_mag
 (
@@ -203,6 +720,410 @@ void convert_mag
         real = in[i][0];
         imag = in[i][1];
         /* Calculate magnitude */
-        out[i] = 20.0f * log(sqrt(real*real + imag*imag));
+        out[i] = 20.0 * log10(sqrt(real*real + imag*imag));
+    }
+}
+
+int fft_block_switch
+(
+    unsigned int fftlength
+    ,unsigned int window_length
+    ,fft_block_window window
+)
+{
+    fft_block_layout *layout;
+    fft_block_status status;
+
+    /* The callback may be swapping layouts: compare with the status, not the live fields */
+    if(fft_block_get_status(&status) < 0
+       || (_this->p_features && _this->p_features->pcm_length != fftlength)
+       || (_this->p_shm && _this->p_shm->p_header->pcm_length != fftlength)
+       || (_this->p_pitch && (_this->p_pitch->pcm_length != fftlength
+                              || (window_length ? window_length : fftlength) != status.window_length
+                              || window != status.window))
+       || (gPipelineLength && gPipelineLength != (window_length ? window_length : fftlength)))
+    {
+        return -1;
+    }
+
+    fft_block_reclaim();
+
+    layout = (fft_block_layout *) malloc(sizeof(fft_block_layout));
+    if(!layout || layout_init(layout, fftlength, window_length, window, atomic_load(&_this->plan_flags)) < 0)
+    {
+        free(layout);
+        return -1;
+    }
+
+    /* Replaces a switch the callback has not picked up yet */
+    layout_free(atomic_exchange_explicit(&gPending, layout, memory_order_acq_rel));
+
+    return 0;
+}
+
+void fft_block_reclaim(void)
+{
+    layout_free(atomic_exchange_explicit(&gRetired, NULL, memory_order_acquire));
+}
+
+int fft_block_set_hop(unsigned int hop)
+{
+    if(!b_initialized)
+    {
+        return -1;
+    }
+
+    atomic_store_explicit(&gHop, hop, memory_order_relaxed);
+    return 0;
+}
+
+int fft_block_set_plan_flags(unsigned int flags)
+{
+    if(!b_initialized)
+    {
+        return -1;
+    }
+
+    atomic_store(&_this->plan_flags, flags);
+    return 0;
+}
+
+int fft_block_get_status(fft_block_status *status)
+{
+    unsigned int hop = atomic_load_explicit(&gHop, memory_order_relaxed);
+    unsigned int sequence;
+
+    if(!b_initialized)
+    {
+        return -1;
+    }
+
+    do
+    {
+        sequence = atomic_load_explicit(&gStatusSequence, memory_order_acquire);
+        status->fft_length = atomic_load_explicit(&gStatusFftLength, memory_order_relaxed);
+        status->window_length = atomic_load_explicit(&gStatusWindowLength, memory_order_relaxed);
+        status->window = (fft_block_window) atomic_load_explicit(&gStatusWindow, memory_order_relaxed);
+
+        /* Order the reads above before the re-check */
+        atomic_thread_fence(memory_order_acquire);
+    }
+    while((sequence & 1) || atomic_load_explicit(&gStatusSequence, memory_order_relaxed) != sequence);
+
+    status->input_rate = _this->input_rate;
+    status->hop = hop ? hop : status->window_length;
+    status->plan_flags = atomic_load(&_this->plan_flags);
+    status->frames = atomic_load_explicit(&_this->frames, memory_order_relaxed);
+
+    return 0;
+}
+
+/**
+ *  Allocate and plan everything for one FFT length and window.
+ *  Everything is zeroed first so layout_close can clean up
+ *  after a partial failure
+**/
+static int layout_init
+(
+    fft_block_layout *layout
+    ,unsigned int fftlength
+    ,unsigned int window_length
+    ,fft_block_window window
+    ,unsigned int flags
+)
+{
+    unsigned int i;
+
+    memset(layout, 0, sizeof(*layout));
+
+    if(fftlength < 2 || window_length > fftlength
+       || (window_length && fftlength % window_length))
+    {
+        return -1;
+    }
+
+    layout->pcm_length = fftlength;
+    layout->fft_length = fftlength / 2 + 1; /* real to complex concatenation */
+    layout->window_length = window_length ? window_length : fftlength;
+    layout->window = window;
+
+    layout->p_window = (double *) malloc(sizeof(double) * layout->window_length);
+    layout->p_pcm_samples = (double *) fftw_malloc(sizeof(double) * layout->window_length);
+    layout->p_overlap = (double *) malloc(sizeof(double) * layout->window_length);
+    layout->fft_out_cmplx = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * layout->fft_length);
+    layout->p_fft_mag = (double *) malloc(sizeof(double) * layout->fft_length);
+    layout->p_mag_stamp = (unsigned int *) calloc((layout->fft_length + FFT_BLOCK_MAG_CHUNK - 1) / FFT_BLOCK_MAG_CHUNK,
+                                                  sizeof(unsigned int));
+    layout->p_freq_bins = (double *) malloc(sizeof(double) * layout->fft_length);
+
+    if(!layout->p_window || !layout->p_pcm_samples || !layout->p_overlap || !layout->fft_out_cmplx
+       || !layout->p_fft_mag || !layout->p_mag_stamp || !layout->p_freq_bins)
+    {
+        layout_close(layout);
+        return -1;
+    }
+    if(layout->window_length < layout->pcm_length)
+    {   /* Zero padded: skip the padding instead of transforming it */
+        if(pruned_fft_init(&layout->pruned, layout->window_length, fftlength, flags) < 0)
+        {
+            layout_close(layout);
+            return -1;
+        }
+    }
+    else
+    {
+        layout->plan = fftw_plan_dft_r2c_1d(fftlength
+                                            ,layout->p_pcm_samples
+                                            ,layout->fft_out_cmplx
+                                            ,flags
+                                            );
+        if(!layout->plan)
+        {
+            layout_close(layout);
+            return -1;
+        }
+    }
+
+    /* Measuring planners scribble on the buffers; clear after */
+    memset(layout->fft_out_cmplx, 0, sizeof(fftw_complex) * layout->fft_length);
+    fill_window(layout->p_window, layout->window_length, window);
+
+    /** ------------------------------------------------------
+     *  Fill Frequency bins
+     *  ------------------------------------------------------
+     *  Each bin will be: (Sample Rate) / (FFT Length) Hz wide
+     *  ie:  Sample Rate: 48 kHz, FFT Length: 8192
+     *          48000 / 8192 = 5.86 Hz
+     *  ======================================================
+    **/
+    for(i = 0; i < layout->fft_length; ++i)
+    {
+        layout->p_freq_bins[i] = (i * ((float) FFT_BLOCK_ANALYSIS_RATE) / layout->pcm_length);
+    }
+
+    /* Only the bins gnuplot shows need converting for it */
+    layout->plot_lo = (unsigned int) (20.0 * layout->pcm_length / FFT_BLOCK_ANALYSIS_RATE);
+    layout->plot_hi = (unsigned int) (20000.0 * layout->pcm_length / FFT_BLOCK_ANALYSIS_RATE) + 2;
+    if(layout->plot_hi > layout->fft_length)
+    {
+        layout->plot_hi = layout->fft_length;
+    }
+
+    return 0;
+}
+
+static void layout_close(fft_block_layout *layout)
+{
+    if(layout->plan)
+    {
+        fftw_destroy_plan(layout->plan);
+    }
+    pruned_fft_close(&layout->pruned);
+
+    free(layout->p_window);
+    fftw_free(layout->p_pcm_samples);
+    free(layout->p_overlap);
+    fftw_free(layout->fft_out_cmplx);
+    free(layout->p_fft_mag);
+    free(layout->p_mag_stamp);
+    free(layout->p_freq_bins);
+    memset(layout, 0, sizeof(*layout));
+}
+
+static void layout_free(fft_block_layout *layout)
+{
+    if(layout)
+    {
+        layout_close(layout);
+        free(layout);
+    }
+}
+
+/**
+ *  Exchange the ctx's length dependent fields with layout
+**/
+static void layout_swap(fft_block_layout *layout)
+{
+    fft_block_layout old;
+
+    old.pcm_length = _this->pcm_length;
+    old.fft_length = _this->fft_length;
+    old.window_length = _this->window_length;
+    old.window = _this->window;
+    old.p_window = _this->p_window;
+    old.p_pcm_samples = _this->p_pcm_samples;
+    old.p_overlap = _this->p_overlap;
+    old.fft_out_cmplx = _this->fft_out_cmplx;
+    old.p_fft_mag = _this->p_fft_mag;
+    old.p_mag_stamp = _this->p_mag_stamp;
+    old.p_freq_bins = _this->p_freq_bins;
+    old.plan = _this->plan;
+    old.pruned = _this->pruned;
+    old.plot_lo = _this->plot_lo;
+    old.plot_hi = _this->plot_hi;
+
+    _this->pcm_length = layout->pcm_length;
+    _this->fft_length = layout->fft_length;
+    _this->window_length = layout->window_length;
+    _this->window = layout->window;
+    _this->p_window = layout->p_window;
+    _this->p_pcm_samples = layout->p_pcm_samples;
+    _this->p_overlap = layout->p_overlap;
+    _this->fft_out_cmplx = layout->fft_out_cmplx;
+    _this->p_fft_mag = layout->p_fft_mag;
+    _this->p_mag_stamp = layout->p_mag_stamp;
+    _this->p_freq_bins = layout->p_freq_bins;
+    _this->plan = layout->plan;
+    _this->pruned = layout->pruned;
+    _this->plot_lo = layout->plot_lo;
+    _this->plot_hi = layout->plot_hi;
+
+    *layout = old;
+}
+
+/**
+ *  Runs on the audio thread: switch to the pending layout if
+ *  the last one has been reclaimed.  No allocation or planning
+ *  happens here, only copies and pointer swaps
+**/
+static void layout_take(void)
+{
+    unsigned int keep;
+    fft_block_layout *layout;
+
+    /* Retired slot still full: try again next callback */
+    if(atomic_load_explicit(&gRetired, memory_order_acquire))
+    {
+        return;
+    }
+
+    layout = atomic_exchange_explicit(&gPending, NULL, memory_order_acq_rel);
+    if(!layout)
+    {
+        return;
+    }
+
+    /* Carry the newest samples over so no audio is dropped */
+    keep = _this->num_samples < layout->window_length ? _this->num_samples : layout->window_length - 1;
+    memcpy(layout->p_pcm_samples, _this->p_pcm_samples + _this->num_samples - keep, sizeof(double) * keep);
+
+    layout_swap(layout);
+    status_publish();
+    _this->num_samples = keep;
+
+    /* Padding and window may have changed; the RMS estimate follows them */
+    if(_this->p_features)
+    {
+        spectral_features_set_window(_this->p_features, _this->p_window, _this->window_length);
+    }
+
+    /* Fresh stamps are all 0, so nothing reads as converted */
+    if(!++_this->mag_frame)
+    {
+        ++_this->mag_frame;
+    }
+
+    if(_this->p_render)
+    {
+        spectrum_render_map(_this->p_render, FFT_BLOCK_ANALYSIS_RATE, _this->pcm_length);
+    }
+
+    atomic_store_explicit(&gRetired, layout, memory_order_release);
+}
+
+/**
+ *  Copies the live layout's settings out for
+ *  fft_block_get_status.  Only the thread that swaps layouts
+ *  writes them
+**/
+static void status_publish(void)
+{
+    unsigned int sequence = atomic_load_explicit(&gStatusSequence, memory_order_relaxed);
+
+    /* Odd sequence: readers retry */
+    atomic_store_explicit(&gStatusSequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&gStatusFftLength, _this->pcm_length, memory_order_relaxed);
+    atomic_store_explicit(&gStatusWindowLength, _this->window_length, memory_order_relaxed);
+    atomic_store_explicit(&gStatusWindow, (int) _this->window, memory_order_relaxed);
+
+    atomic_store_explicit(&gStatusSequence, sequence + 2, memory_order_release);
+}
+
+/**
+ *  Mirrors gRanges for the callback.  Only the control thread
+ *  writes them
+**/
+static void ranges_publish(void)
+{
+    unsigned int i, sequence = atomic_load_explicit(&gRangeSequence, memory_order_relaxed);
+
+    /* Odd sequence: the callback keeps its copy */
+    atomic_store_explicit(&gRangeSequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for(i = 0; i < FFT_BLOCK_MAX_RANGES; ++i)
+    {
+        atomic_store_explicit(&gRangeLo[i], gRanges[i].lo, memory_order_relaxed);
+        atomic_store_explicit(&gRangeHi[i], gRanges[i].in_use ? gRanges[i].hi : 0, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&gRangeSequence, sequence + 2, memory_order_release);
+}
+
+/**
+ *  Runs on the audio thread: copy the published ranges to
+ *  mag_ranges.  Never waits on the control thread; a copy that
+ *  raced an update is dropped and retried next callback
+**/
+static void ranges_take(void)
+{
+    unsigned int i, hi;
+    fft_block_range ranges[FFT_BLOCK_MAX_RANGES];
+    unsigned int sequence = atomic_load_explicit(&gRangeSequence, memory_order_acquire);
+
+    if(sequence & 1)
+    {
+        return;
+    }
+
+    for(i = 0; i < FFT_BLOCK_MAX_RANGES; ++i)
+    {
+        hi = atomic_load_explicit(&gRangeHi[i], memory_order_relaxed);
+        ranges[i].lo = atomic_load_explicit(&gRangeLo[i], memory_order_relaxed);
+        ranges[i].hi = hi;
+        ranges[i].in_use = hi != 0;
+    }
+
+    /* Order the reads above before the re-check */
+    atomic_thread_fence(memory_order_acquire);
+    if(atomic_load_explicit(&gRangeSequence, memory_order_relaxed) != sequence)
+    {
+        return;
+    }
+
+    memcpy(_this->mag_ranges, ranges, sizeof(ranges));
+    gRangeTaken = sequence;
+}
+
+/**
+ *  Runs on the audio thread: attach the requested pipeline and
+ *  let go of the one it replaces
+**/
+static void pipeline_take(void)
+{
+    pipeline *old = _this->p_pipeline;
+    pipeline *p = atomic_exchange_explicit(&gPipelinePending, NULL, memory_order_acq_rel);
+
+    if(!p)
+    {
+        return;
+    }
+
+    _this->p_pipeline = p == &gNoPipeline ? NULL : p;
+    if(old)
+    {
+        atomic_fetch_sub_explicit(&old->attach_count, 1, memory_order_release);
     }
 }
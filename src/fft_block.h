@@ -3,6 +3,75 @@
 
 #include "fftw3.h"
 #include "gnuplot_i.h"
+#include "sdft_bank.h"
+#include "welch_psd.h"
+#include "spectral_features.h"
+#include "spectrum_pub.h"
+#include "spectrum_shm.h"
+#include "spectrum_render.h"
+#include "pruned_fft.h"
+#include "fir_conv.h"
+#include "latency_stats.h"
+#include "spec_quant.h"
+#include "spec_archive.h"
+#include "resampler.h"
+#include "trigger.h"
+#include "pitch.h"
+#include "pipeline.h"
+#include "fft_window.h"
+
+/**
+ *  Magnitudes are converted in chunks of this many bins
+ *  and at most FFT_BLOCK_MAX_RANGES bin ranges can be
+ *  registered with fft_block_request_bins
+**/
+#define FFT_BLOCK_MAG_CHUNK     64
+#define FFT_BLOCK_MAX_RANGES    16
+
+/**
+ *  Every input is analysed at this rate; other device rates
+ *  are resampled to it ahead of the block buffer, in pieces
+ *  of at most FFT_BLOCK_RESAMPLE_BLOCK input samples
+**/
+#define FFT_BLOCK_ANALYSIS_RATE     48000
+#define FFT_BLOCK_RESAMPLE_BLOCK    512
+
+typedef struct
+{
+    unsigned int lo;
+    unsigned int hi;
+    int in_use;
+
+} fft_block_range;
+
+/**
+ *  Everything that depends on the FFT length and window.
+ *  fft_block_switch builds one of these away from the audio
+ *  thread; fft_block_process swaps it with the live fields of
+ *  the ctx at the start of a callback
+**/
+typedef struct
+{
+    unsigned int pcm_length;
+    unsigned int fft_length;
+    unsigned int window_length;
+    fft_block_window window;
+    double *p_window;
+
+    double *p_pcm_samples;
+    double *p_overlap;
+    fftw_complex *fft_out_cmplx;
+    double *p_fft_mag;
+    unsigned int *p_mag_stamp;
+    double *p_freq_bins;
+
+    fftw_plan plan;
+    pruned_fft pruned;
+
+    unsigned int plot_lo;
+    unsigned int plot_hi;
+
+} fft_block_layout;
 
 typedef struct
 {
@@ -21,9 +90,29 @@ typedef struct
     /**
      * Magnitude converted samples
      * ie. sqrt(re^2 + im^2) of fft_out_cmplx
+     * Only the bins someone asked for are valid, see
+     * fft_block_magnitude
     **/
     double *p_fft_mag;
 
+    /**
+     * Lazy magnitude bookkeeping.  p_mag_stamp holds, for
+     * every chunk of FFT_BLOCK_MAG_CHUNK bins, the frame
+     * number it was last converted for; mag_frame is the
+     * current frame.  Registered ranges are converted
+     * eagerly after every FFT; mag_ranges is the
+     * callback's copy of them, see fft_block_request_bins
+    **/
+    unsigned int *p_mag_stamp;
+    unsigned int mag_frame;
+    fft_block_range mag_ranges[FFT_BLOCK_MAX_RANGES];
+
+    /**
+     * Bins inside the plotted 20 Hz - 20 kHz range
+    **/
+    unsigned int plot_lo;
+    unsigned int plot_hi;
+
     /**
      * Frequency bins for fft in Hz
     **/
@@ -39,23 +128,193 @@ typedef struct
     unsigned int fft_length;
 
     /**
-     * FFT plan from FFTW library
+     * Samples per analysis window.  Equal to pcm_length
+     * unless the window is zero padded, in which case
+     * p_pcm_samples only holds window_length samples and
+     * the pruned transform replaces the plan
+    **/
+    unsigned int window_length;
+    pruned_fft pruned;
+
+    /**
+     * Window applied before every transform, precomputed
+     * for window_length samples
+    **/
+    fft_block_window window;
+    double *p_window;
+
+    /**
+     * FFT plan from FFTW library, and the planner flags
+     * every later layout is made with
     **/
     fftw_plan plan;
+    atomic_uint plan_flags;
+
+    /**
+     * Overlapping frames: the unwindowed samples the
+     * next frame starts with are kept here while the
+     * window and FFT run in place.  skip counts input
+     * samples left out when the hop exceeds the window
+    **/
+    double *p_overlap;
+    unsigned long skip;
+
+    /**
+     * Frames transformed since fft_block_init, counted
+     * by the callback
+    **/
+    atomic_ulong frames;
 
     /**
      * GNUPLOT vars
     **/
     gnuplot_ctrl *ctrl;
 
+    /**
+     * Input rate, and the converter to the analysis rate
+     * with its output buffer when the two differ
+    **/
+    unsigned int input_rate;
+    int b_resample;
+    resampler resample;
+    float *p_resampled;
+
+    /**
+     * Optional sliding DFT bank fed with every input
+     * sample, at the analysis rate.  NULL when no tones
+     * are being tracked
+    **/
+    sdft_bank *p_tones;
+
+    /**
+     * Optional Welch PSD estimate, also fed with every
+     * input sample.  NULL when not averaging
+    **/
+    welch_psd *p_psd;
+
+    /**
+     * Optional feature extraction run on every FFT frame
+     * and the most recent record it produced
+    **/
+    spectral_features_ctx *p_features;
+    spectral_features features;
+
+    /**
+     * Optional socket publisher for other processes
+    **/
+    spectrum_pub *p_pub;
+
+    /**
+     * Optional shared memory ring for co-located readers
+    **/
+    spectrum_shm *p_shm;
+
+    /**
+     * Optional built-in renderer, used instead of (or
+     * as well as) gnuplot on machines without a display
+    **/
+    spectrum_render *p_render;
+
+    /**
+     * Optional FIR applied to the passthrough output
+    **/
+    fir_conv *p_fir;
+
+    /**
+     * Optional per frame latency accounting
+    **/
+    latency_stats *p_latency;
+
+    /**
+     * Optional quantized spectrogram history
+    **/
+    spec_history *p_history;
+
+    /**
+     * Optional on-disk spectrogram archive
+    **/
+    spec_archive *p_archive;
+
+    /**
+     * Optional event capture, fed every analysis sample
+     * and checked on every frame
+    **/
+    trigger_engine *p_trigger;
+
+    /**
+     * Optional pitch tracker and its latest estimate
+    **/
+    pitch_tracker *p_pitch;
+    pitch_estimate pitch;
+
+    /**
+     * Optional stage chain, handed every frame before the
+     * window is applied.  Set by the callback from
+     * fft_block_set_pipeline requests
+    **/
+    pipeline *p_pipeline;
+
 } fft_block_ctx;
 
+typedef struct
+{
+    unsigned int samplerate;
+    unsigned int fft_length;
+
+    /**
+     * Launch gnuplot for a live plot window.  Defaults to
+     * off when there is no display to open it on
+    **/
+    int use_gnuplot;
+
+    /**
+     * Analysis window in samples, zero padded up to
+     * fft_length.  0 means no padding.  fft_length must be
+     * a multiple of it
+    **/
+    unsigned int window_length;
+
+    /** Analysis window, Hann by default **/
+    fft_block_window window;
+
+    /**
+     * Samples between the starts of consecutive frames.
+     * Less than the window overlaps frames, more skips
+     * samples.  0 means one window (no overlap)
+    **/
+    unsigned int hop;
+
+    /** FFTW planner flags, FFTW_ESTIMATE by default **/
+    unsigned int plan_flags;
+
+    /**
+     * Converter quality used when samplerate is not
+     * FFT_BLOCK_ANALYSIS_RATE.  Medium by default
+    **/
+    resampler_quality resample_quality;
+
+} fft_block_config;
+
+/** Snapshot of the running block, see fft_block_get_status **/
+typedef struct
+{
+    unsigned int input_rate;
+    unsigned int fft_length;
+    unsigned int window_length;
+    fft_block_window window;
+    unsigned int hop;
+    unsigned int plan_flags;
+    unsigned long frames;
+
+} fft_block_status;
+
 /** ------------------------------------------
  *  fft_block_init
  *  ------------------------------------------
  *      Takes a sample rate and an fft length
  *      configures the static ctx instance and
- *      returns a pointer to it
+ *      returns a pointer to it.  Any rate the
+ *      resampler supports is accepted
  *  ==========================================
 **/
 //fft_block_ctx *fft_block_init
@@ -65,6 +324,24 @@ int fft_block_init
     ,unsigned int fftlength
 );
 
+/** ------------------------------------------
+ *  fft_block_default_config
+ *  ------------------------------------------
+ *      Fills config with the defaults used by
+ *      fft_block_init
+ *  ==========================================
+**/
+void fft_block_default_config(fft_block_config *config);
+
+/** ------------------------------------------
+ *  fft_block_init_config
+ *  ------------------------------------------
+ *      Same as fft_block_init but takes every
+ *      setting from config
+ *  ==========================================
+**/
+int fft_block_init_config(const fft_block_config *config);
+
 /** -----------------------------------------------
  *  fft_block_close 
  *  -----------------------------------------------
@@ -79,7 +356,8 @@ void fft_block_close();
  *  ----------------------------------------------------
  *      Called every time Portaudio calls our callback
  *      This will passthrough audio after making a
- *      local copy of it in the instance's p_pcm_samples
+ *      local copy of it in the instance's p_pcm_samples,
+ *      resampled to the analysis rate if need be
  *  ====================================================
 **/
 int fft_block_process
@@ -90,4 +368,272 @@ int fft_block_process
     ,void *userData
 );
 
+/** ----------------------------------------------------
+ *  fft_block_set_tone_bank
+ *  ----------------------------------------------------
+ *      Attaches a sliding DFT bank that is updated with
+ *      every sample passed to fft_block_process.  The
+ *      bank is owned by the caller; pass NULL to detach
+ *  ====================================================
+**/
+void fft_block_set_tone_bank(sdft_bank *bank);
+
+/** ----------------------------------------------------
+ *  fft_block_set_psd
+ *  ----------------------------------------------------
+ *      Attaches a Welch PSD estimator fed with every
+ *      sample passed to fft_block_process.  Owned by
+ *      the caller; pass NULL to detach
+ *  ====================================================
+**/
+void fft_block_set_psd(welch_psd *psd);
+
+/** ----------------------------------------------------
+ *  fft_block_set_features
+ *  ----------------------------------------------------
+ *      Attaches a feature extraction stage that runs
+ *      on every FFT frame.  It must be configured for
+ *      the block's fft length, and is given the
+ *      block's window and padding, now and after every
+ *      fft_block_switch.  The context is owned by the
+ *      caller; pass NULL to detach.
+ *      Returns 0 on success, -1 on size mismatch
+ *  ====================================================
+**/
+int fft_block_set_features(spectral_features_ctx *features);
+
+/** ----------------------------------------------------
+ *  fft_block_set_publisher
+ *  ----------------------------------------------------
+ *      Streams every frame to the publisher's
+ *      subscribers.  What is sent is selected by the
+ *      publisher's content flags.  The publisher is
+ *      owned by the caller; pass NULL to detach
+ *  ====================================================
+**/
+void fft_block_set_publisher(spectrum_pub *pub);
+
+/** ----------------------------------------------------
+ *  fft_block_set_shm
+ *  ----------------------------------------------------
+ *      Writes every magnitude frame into a shared
+ *      memory ring created with spectrum_shm_create.
+ *      The segment's header is fixed, so frames are
+ *      only written while the FFT length matches its
+ *      pcm_length and bins, and fft_block_switch
+ *      refuses to change it.  The segment is owned by
+ *      the caller; pass NULL to detach
+ *  ====================================================
+**/
+void fft_block_set_shm(spectrum_shm *shm);
+
+/** ----------------------------------------------------
+ *  fft_block_set_renderer
+ *  ----------------------------------------------------
+ *      Draws every magnitude frame with the built-in
+ *      renderer.  The renderer is owned by the caller;
+ *      pass NULL to detach
+ *  ====================================================
+**/
+void fft_block_set_renderer(spectrum_render *render);
+
+/** ----------------------------------------------------
+ *  fft_block_set_fir
+ *  ----------------------------------------------------
+ *      Filters the passthrough audio written to output
+ *      by fft_block_process.  Analysis still sees the
+ *      unfiltered input.  The filter is owned by the
+ *      caller; pass NULL to detach
+ *  ====================================================
+**/
+void fft_block_set_fir(fir_conv *fir);
+
+/** ----------------------------------------------------
+ *  fft_block_set_latency
+ *  ----------------------------------------------------
+ *      Attaches latency accounting: every frame is
+ *      stamped after windowing, FFT, magnitudes and
+ *      outputs.  Owned by the caller; pass NULL to
+ *      detach
+ *  ====================================================
+**/
+void fft_block_set_latency(latency_stats *lat);
+
+/** ----------------------------------------------------
+ *  fft_block_set_history
+ *  ----------------------------------------------------
+ *      Records every frame's dB magnitudes in a
+ *      quantized history.  Frames whose length differs
+ *      from the history's bins (after a switch) are
+ *      skipped.  Owned by the caller; pass NULL to
+ *      detach
+ *  ====================================================
+**/
+void fft_block_set_history(spec_history *hist);
+
+/** ----------------------------------------------------
+ *  fft_block_set_archive
+ *  ----------------------------------------------------
+ *      Appends every frame to an archive, stamped
+ *      with the wall clock.  As with the history,
+ *      frames of another length are skipped.  The
+ *      callback only hands frames to the archive; its
+ *      writer thread encodes and writes each chunk of
+ *      chunk_frames frames.  Owned by the caller; pass
+ *      NULL to detach
+ *  ====================================================
+**/
+void fft_block_set_archive(spec_archive *arch);
+
+/** ----------------------------------------------------
+ *  fft_block_set_trigger
+ *  ----------------------------------------------------
+ *      Feeds an event trigger the samples at the
+ *      analysis rate and the dB magnitudes of every
+ *      frame.  Owned by the caller; pass NULL to
+ *      detach
+ *  ====================================================
+**/
+void fft_block_set_trigger(trigger_engine *trig);
+
+/** ----------------------------------------------------
+ *  fft_block_set_pitch
+ *  ----------------------------------------------------
+ *      Attaches a pitch tracker that reuses every
+ *      FFT frame.  It must be configured for the
+ *      block's fft length and is given the block's
+ *      window here.  Owned by the caller; pass NULL
+ *      to detach.
+ *      Returns 0 on success, -1 on size mismatch
+ *  ====================================================
+**/
+int fft_block_set_pitch(pitch_tracker *pt);
+
+/** ----------------------------------------------------
+ *  fft_block_set_pipeline
+ *  ----------------------------------------------------
+ *      Runs a built stage chain on every frame of
+ *      window_length raw samples.  When the chain has
+ *      an FFT stage giving the block's number of bins,
+ *      its spectrum replaces the block's own window
+ *      and FFT for every consumer above; otherwise
+ *      the chain runs alongside them.  The change is
+ *      picked up at the next callback, and the chain
+ *      may be rebuilt while attached.  Owned by the
+ *      caller, which must not close it while its
+ *      attach_count is above 0; pass NULL to detach.
+ *      Returns 0 on success, -1 if the chain takes
+ *      another frame length or is not built
+ *  ====================================================
+**/
+int fft_block_set_pipeline(pipeline *p);
+
+/** ----------------------------------------------------
+ *  fft_block_request_bins
+ *  ----------------------------------------------------
+ *      Registers interest in bins [lo, hi) so their
+ *      magnitudes are converted right after every
+ *      FFT, starting with the next callback.  Call
+ *      from one control thread.  Returns a handle for
+ *      fft_block_release_bins, or -1 if the range is
+ *      invalid or the table is full
+ *  ====================================================
+**/
+int fft_block_request_bins(unsigned int lo, unsigned int hi);
+
+/** ----------------------------------------------------
+ *  fft_block_release_bins
+ *  ----------------------------------------------------
+ *      Drops a range registered with
+ *      fft_block_request_bins
+ *  ====================================================
+**/
+void fft_block_release_bins(int handle);
+
+/** ----------------------------------------------------
+ *  fft_block_magnitude
+ *  ----------------------------------------------------
+ *      Makes sure bins [lo, hi) of the current frame
+ *      are converted, converting any that are not yet,
+ *      and returns p_fft_mag.  Bins outside the range
+ *      may hold stale values
+ *  ====================================================
+**/
+const double *fft_block_magnitude(unsigned int lo, unsigned int hi);
+
+/** ----------------------------------------------------
+ *  fft_block_switch
+ *  ----------------------------------------------------
+ *      Changes FFT length, padding (window_length, 0
+ *      for none) and window while audio keeps running.
+ *      Buffers and plans are prepared on the calling
+ *      thread and picked up by fft_block_process at
+ *      the start of its next callback, carrying over
+ *      the samples already collected.  Call from one
+ *      control thread, not concurrently with other
+ *      FFTW planning.  Bin ranges from
+ *      fft_block_request_bins and the hop are kept
+ *      as is; the plan uses the current plan flags.
+ *      Returns -1 if the settings are invalid, an
+ *      attached feature stage or shared memory ring
+ *      needs the old length, a pitch tracker the old
+ *      length and window, or a pipeline the old
+ *      window length
+ *  ====================================================
+**/
+int fft_block_switch
+(
+    unsigned int fftlength
+    ,unsigned int window_length
+    ,fft_block_window window
+);
+
+/** ----------------------------------------------------
+ *  fft_block_reclaim
+ *  ----------------------------------------------------
+ *      Frees buffers fft_block_process has switched
+ *      away from.  fft_block_switch and
+ *      fft_block_close do this too; a control thread
+ *      may call it any time.  A switch requested
+ *      before the previous one was reclaimed waits
+ *      for it
+ *  ====================================================
+**/
+void fft_block_reclaim(void);
+
+/** ----------------------------------------------------
+ *  fft_block_set_hop
+ *  ----------------------------------------------------
+ *      Samples between frame starts from the next
+ *      frame on, 0 for one window.  Safe to call while
+ *      audio runs.  Returns 0, or -1 if not initialized
+ *  ====================================================
+**/
+int fft_block_set_hop(unsigned int hop);
+
+/** ----------------------------------------------------
+ *  fft_block_set_plan_flags
+ *  ----------------------------------------------------
+ *      FFTW planner flags (FFTW_ESTIMATE, FFTW_MEASURE
+ *      ...) for the layouts later fft_block_switch
+ *      calls build; switch to the same length to
+ *      replan it.  Call from the control thread.
+ *      Returns 0, or -1 if not initialized
+ *  ====================================================
+**/
+int fft_block_set_plan_flags(unsigned int flags);
+
+/** ----------------------------------------------------
+ *  fft_block_get_status
+ *  ----------------------------------------------------
+ *      Fills status with the settings in use and the
+ *      frame count.  Safe from another thread while
+ *      audio runs: the length, padding and window are
+ *      read as one consistent set, the frame count may
+ *      lag the callback by a frame.  Returns 0, or -1
+ *      if not initialized
+ *  ====================================================
+**/
+int fft_block_get_status(fft_block_status *status);
+
 #endif
\ No newline at end of file
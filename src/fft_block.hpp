@@ -0,0 +1,319 @@
+#ifndef FFT_BLOCK_HPP
+#define FFT_BLOCK_HPP
+
+/**
+ *  Header-only C++ (C++14 or later) counterpart of fft_block for
+ *  sizes known at build time:
+ *
+ *      static fft_block::FftBlock<2048> block(48000);
+ *      ...
+ *      if(block.process(in, out, framesPerBuffer))
+ *          use(block.magnitude(), block.fft_length);
+ *
+ *  Every loop has a constant trip count and all buffers live
+ *  inside the object, so nothing is allocated on the heap and the
+ *  compiler can vectorize the kernels without remainder handling.
+ *  The window table is shared by all blocks of one size and window
+ *  and filled when the first of them is constructed; constexpr
+ *  evaluation of a large table exceeds the compilers' limits.  The
+ *  transform itself is still FFTW, planned once in the constructor.
+ *
+ *  It does not wrap the C API: fft_block_init sets up the one
+ *  global block the audio callback uses, while every FftBlock is
+ *  its own instance with its size fixed by the type.
+ *  FftBlock<N, float> calls the fftwf_ functions, so programs
+ *  using it must link fftw3f as well (see fft_block_peak in
+ *  CMakeLists.txt).
+**/
+
+#include <cmath>
+#include <cstddef>
+
+#include "fftw3.h"
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define FFT_BLOCK_UNROLL _Pragma("GCC unroll 8")
+#elif defined(__clang__)
+#define FFT_BLOCK_UNROLL _Pragma("clang loop unroll_count(8)")
+#else
+#define FFT_BLOCK_UNROLL
+#endif
+
+namespace fft_block
+{
+
+namespace detail
+{
+
+constexpr double pi = 3.14159265358979323846;
+
+/**
+ *  std::cos is not constexpr, so window tables use this:
+ *  reduce to [-pi, pi] then sum the Taylor series until the
+ *  terms stop contributing
+**/
+constexpr double cos_cx(double x)
+{
+    while(x > pi)
+    {
+        x -= 2.0 * pi;
+    }
+    while(x < -pi)
+    {
+        x += 2.0 * pi;
+    }
+
+    double term = 1.0;
+    double sum = 1.0;
+    for(int k = 1; k < 40; ++k)
+    {
+        term *= -x * x / ((2 * k - 1) * (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+template <typename T, std::size_t N>
+struct table
+{
+    T v[N];
+};
+
+/**
+ *  FFTW names everything by precision; map them here
+**/
+template <typename Precision>
+struct fftw_traits;
+
+template <>
+struct fftw_traits<double>
+{
+    typedef fftw_complex complex;
+    typedef fftw_plan plan;
+
+    static plan plan_r2c(int n, double *in, complex *out, unsigned flags)
+    {
+        return fftw_plan_dft_r2c_1d(n, in, out, flags);
+    }
+    static void execute(plan p) { fftw_execute(p); }
+    static void destroy(plan p) { fftw_destroy_plan(p); }
+};
+
+template <>
+struct fftw_traits<float>
+{
+    typedef fftwf_complex complex;
+    typedef fftwf_plan plan;
+
+    static plan plan_r2c(int n, float *in, complex *out, unsigned flags)
+    {
+        return fftwf_plan_dft_r2c_1d(n, in, out, flags);
+    }
+    static void execute(plan p) { fftwf_execute(p); }
+    static void destroy(plan p) { fftwf_destroy_plan(p); }
+};
+
+} // namespace detail
+
+/**
+ *  Window policies, matching fill_window() in fft_block.c
+ *  (symmetric, N - 1 in the denominator)
+**/
+struct Hann
+{
+    static constexpr double coeff(std::size_t i, std::size_t n)
+    {
+        return 0.5 * (1.0 - detail::cos_cx(2.0 * detail::pi * i / (n - 1)));
+    }
+};
+
+struct Hamming
+{
+    static constexpr double coeff(std::size_t i, std::size_t n)
+    {
+        return 0.54 - 0.46 * detail::cos_cx(2.0 * detail::pi * i / (n - 1));
+    }
+};
+
+struct Blackman
+{
+    static constexpr double coeff(std::size_t i, std::size_t n)
+    {
+        return 0.42 - 0.5 * detail::cos_cx(2.0 * detail::pi * i / (n - 1))
+                    + 0.08 * detail::cos_cx(4.0 * detail::pi * i / (n - 1));
+    }
+};
+
+struct Rectangular
+{
+    static constexpr double coeff(std::size_t, std::size_t)
+    {
+        return 1.0;
+    }
+};
+
+/**
+ *  Largest FftBlock length.  The buffers live inside the object,
+ *  about 5 N values, so blocks this long belong in static storage
+**/
+constexpr std::size_t max_length = static_cast<std::size_t>(1) << 20;
+
+namespace detail
+{
+
+/**
+ *  Window coefficients filled at run time, once per size and window
+**/
+template <std::size_t N, typename Precision, typename Window>
+struct window_table
+{
+    window_table()
+    {
+        for(std::size_t i = 0; i < N; ++i)
+        {
+            v[i] = static_cast<Precision>(Window::coeff(i, N));
+        }
+    }
+
+    alignas(64) Precision v[N];
+};
+
+} // namespace detail
+
+/**
+ *  Compile-time window table, for small N only: GCC and clang
+ *  give up on constexpr loops of a few ten thousand steps
+**/
+template <std::size_t N, typename Precision, typename Window>
+constexpr detail::table<Precision, N> make_window()
+{
+    detail::table<Precision, N> t = {};
+    for(std::size_t i = 0; i < N; ++i)
+    {
+        t.v[i] = static_cast<Precision>(Window::coeff(i, N));
+    }
+    return t;
+}
+
+template <std::size_t N, typename Precision = double, typename Window = Hann>
+class FftBlock
+{
+    static_assert(N >= 4 && (N & (N - 1)) == 0, "FFT length must be a power of two");
+    static_assert(N <= max_length, "FFT length must be at most fft_block::max_length");
+
+    typedef detail::fftw_traits<Precision> traits;
+
+public:
+    typedef typename traits::complex complex_type;
+
+    static constexpr std::size_t pcm_length = N;
+    static constexpr std::size_t fft_length = N / 2 + 1;
+
+    explicit FftBlock(unsigned int samplerate = 48000, unsigned flags = FFTW_ESTIMATE)
+        : window_(window_table()), num_samples_(0)
+    {
+        for(std::size_t i = 0; i < fft_length; ++i)
+        {
+            freq_bins_[i] = static_cast<Precision>(i * static_cast<double>(samplerate) / N);
+        }
+        plan_ = traits::plan_r2c(static_cast<int>(N), fft_in_, fft_out_, flags);
+    }
+
+    ~FftBlock()
+    {
+        traits::destroy(plan_);
+    }
+
+    FftBlock(const FftBlock &) = delete;
+    FftBlock &operator=(const FftBlock &) = delete;
+
+    /**
+     *  Same contract as fft_block_process: copies input to
+     *  output and buffers it.  Returns true if at least one new
+     *  spectrum was produced during this call
+    **/
+    bool process(const float *input, float *output, unsigned long frames)
+    {
+        bool b_ready = false;
+        unsigned long i = 0;
+        std::size_t take;
+
+        while(i < frames)
+        {
+            take = N - num_samples_;
+            if(take > frames - i)
+            {
+                take = static_cast<std::size_t>(frames - i);
+            }
+
+            for(std::size_t k = 0; k < take; ++k)
+            {
+                output[i + k] = input[i + k];
+                pcm_[num_samples_ + k] = input[i + k];
+            }
+            num_samples_ += take;
+            i += take;
+
+            if(num_samples_ == N)
+            {
+                transform();
+                num_samples_ = 0;
+                b_ready = true;
+            }
+        }
+
+        return b_ready;
+    }
+
+    const Precision *magnitude() const { return mag_; }
+    const Precision *freq_bins() const { return freq_bins_; }
+    const complex_type *spectrum() const { return fft_out_; }
+
+private:
+    /**
+     *  The shared table; a function-local static, so it is
+     *  filled once, thread safely, by the first constructor
+    **/
+    static const Precision *window_table()
+    {
+        static const detail::window_table<N, Precision, Window> table;
+        return table.v;
+    }
+
+    /**
+     *  Window into the FFT input (pcm_ keeps the raw block),
+     *  transform, then convert to dB as convert_mag does
+    **/
+    void transform()
+    {
+        FFT_BLOCK_UNROLL
+        for(std::size_t i = 0; i < N; ++i)
+        {
+            fft_in_[i] = pcm_[i] * window_[i];
+        }
+
+        traits::execute(plan_);
+
+        FFT_BLOCK_UNROLL
+        for(std::size_t i = 0; i < fft_length; ++i)
+        {
+            const Precision re = fft_out_[i][0];
+            const Precision im = fft_out_[i][1];
+            mag_[i] = static_cast<Precision>(10.0) * std::log10(re * re + im * im);
+        }
+    }
+
+    alignas(64) Precision pcm_[N];
+    alignas(64) Precision fft_in_[N];
+    alignas(64) complex_type fft_out_[fft_length];
+    alignas(64) Precision mag_[fft_length];
+    Precision freq_bins_[fft_length];
+
+    const Precision *window_;
+    typename traits::plan plan_;
+    std::size_t num_samples_;
+};
+
+} // namespace fft_block
+
+#endif
@@ -0,0 +1,41 @@
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "fft_window.h"
+
+
+/**
+ *  Hann is the one described here:
+ *  http://en.wikipedia.org/wiki/Hann_function
+**/
+void fill_window
+(
+    double *p_window
+    ,const unsigned length
+    ,fft_block_window window
+)
+{
+    unsigned i;
+    double x;
+    const double N = length > 1 ? length - 1 : 1;
+
+    for(i = 0; i < length; ++i)
+    {
+        x = 2 * M_PI * i / N;
+        switch(window)
+        {
+            case FFT_BLOCK_WINDOW_HAMMING:
+                p_window[i] = 0.54 - 0.46 * cos(x);
+                break;
+            case FFT_BLOCK_WINDOW_BLACKMAN:
+                p_window[i] = 0.42 - 0.5 * cos(x) + 0.08 * cos(2 * x);
+                break;
+            case FFT_BLOCK_WINDOW_RECTANGULAR:
+                p_window[i] = 1.0;
+                break;
+            default:
+                p_window[i] = 0.5 * (1.0 - cos(x));
+                break;
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef FFT_WINDOW_H
+#define FFT_WINDOW_H
+
+typedef enum
+{
+    FFT_BLOCK_WINDOW_HANN           = 0,
+    FFT_BLOCK_WINDOW_HAMMING        = 1,
+    FFT_BLOCK_WINDOW_BLACKMAN       = 2,
+    FFT_BLOCK_WINDOW_RECTANGULAR    = 3
+
+} fft_block_window;
+
+/** ------------------------------------------
+ *  fill_window
+ *  ------------------------------------------
+ *      Writes length coefficients of window to
+ *      p_window.  Every window is the symmetric
+ *      form (length - 1 in the denominator), as
+ *      fft_block and fft_batch apply them
+ *  ==========================================
+**/
+void fill_window
+(
+    double *p_window
+    ,const unsigned length
+    ,fft_block_window window
+);
+
+#endif
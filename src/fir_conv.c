@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fir_conv.h"
+
+/* Spectra are padded to a multiple of this many bins (64 bytes) */
+#define FIR_CONV_BIN_ALIGN  4
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void fir_conv_block(fir_conv *conv);
+/* ------------------------------------------------------------------------ */
+
+
+int fir_conv_init
+(
+    fir_conv *conv
+    ,const float *taps
+    ,unsigned int num_taps
+    ,unsigned int block_length
+    ,unsigned int flags
+)
+{
+    unsigned int p, i, n;
+    double scale;
+    fftw_complex *p_spec;
+
+    if(!conv || !taps || !num_taps || !block_length)
+    {
+        return -1;
+    }
+
+    memset(conv, 0, sizeof(*conv));
+    conv->block_length = block_length;
+    conv->fft_size = 2 * block_length;
+    conv->num_bins = block_length + 1;
+    conv->num_partitions = (num_taps + block_length - 1) / block_length;
+    conv->stride = (conv->num_bins + FIR_CONV_BIN_ALIGN - 1) / FIR_CONV_BIN_ALIGN * FIR_CONV_BIN_ALIGN;
+
+    conv->p_filter = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * conv->stride * conv->num_partitions);
+    conv->p_fdl = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * conv->stride * conv->num_partitions);
+    conv->p_accum = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * conv->num_bins);
+    conv->p_time_in = (double *) fftw_malloc(sizeof(double) * conv->fft_size);
+    conv->p_time_out = (double *) fftw_malloc(sizeof(double) * conv->fft_size);
+    conv->p_in_fifo = (float *) malloc(sizeof(float) * block_length);
+    conv->p_out_fifo = (float *) malloc(sizeof(float) * block_length);
+
+    if(!conv->p_filter || !conv->p_fdl || !conv->p_accum || !conv->p_time_in
+       || !conv->p_time_out || !conv->p_in_fifo || !conv->p_out_fifo)
+    {
+        fir_conv_close(conv);
+        return -1;
+    }
+
+    /* Plans are reused for the filter spectra and every block */
+    conv->forward = fftw_plan_dft_r2c_1d((int) conv->fft_size, conv->p_time_in, conv->p_fdl, flags);
+    conv->inverse = fftw_plan_dft_c2r_1d((int) conv->fft_size, conv->p_accum, conv->p_time_out, flags);
+
+    if(!conv->forward || !conv->inverse)
+    {
+        fir_conv_close(conv);
+        return -1;
+    }
+
+    /**
+     *  Partition p holds taps [pB, pB + B) followed by B zeros.
+     *  The inverse FFT is unnormalized, so fold 1 / 2B in here
+    **/
+    scale = 1.0 / conv->fft_size;
+    for(p = 0; p < conv->num_partitions; ++p)
+    {
+        memset(conv->p_time_in, 0, sizeof(double) * conv->fft_size);
+        n = num_taps - p * block_length < block_length ? num_taps - p * block_length : block_length;
+        for(i = 0; i < n; ++i)
+        {
+            conv->p_time_in[i] = taps[p * block_length + i];
+        }
+
+        p_spec = conv->p_filter + (size_t) p * conv->stride;
+        fftw_execute_dft_r2c(conv->forward, conv->p_time_in, p_spec);
+        for(i = 0; i < conv->num_bins; ++i)
+        {
+            p_spec[i][0] *= scale;
+            p_spec[i][1] *= scale;
+        }
+    }
+
+    fir_conv_reset(conv);
+
+    return 0;
+}
+
+void fir_conv_close(fir_conv *conv)
+{
+    if(!conv)
+    {
+        return;
+    }
+
+    if(conv->forward)
+    {
+        fftw_destroy_plan(conv->forward);
+    }
+    if(conv->inverse)
+    {
+        fftw_destroy_plan(conv->inverse);
+    }
+
+    fftw_free(conv->p_filter);
+    fftw_free(conv->p_fdl);
+    fftw_free(conv->p_accum);
+    fftw_free(conv->p_time_in);
+    fftw_free(conv->p_time_out);
+    free(conv->p_in_fifo);
+    free(conv->p_out_fifo);
+    memset(conv, 0, sizeof(*conv));
+}
+
+void fir_conv_reset(fir_conv *conv)
+{
+    memset(conv->p_fdl, 0, sizeof(fftw_complex) * conv->stride * conv->num_partitions);
+    memset(conv->p_time_in, 0, sizeof(double) * conv->fft_size);
+    memset(conv->p_in_fifo, 0, sizeof(float) * conv->block_length);
+    memset(conv->p_out_fifo, 0, sizeof(float) * conv->block_length);
+    conv->fdl_pos = 0;
+    conv->fifo_pos = 0;
+}
+
+void fir_conv_process
+(
+    fir_conv *conv
+    ,const float *input
+    ,float *output
+    ,unsigned long framesPerBuffer
+)
+{
+    unsigned long i;
+    float x;
+
+    for(i = 0; i < framesPerBuffer; ++i)
+    {
+        /* Read before writing so input == output works */
+        x = input[i];
+        output[i] = conv->p_out_fifo[conv->fifo_pos];
+        conv->p_in_fifo[conv->fifo_pos] = x;
+
+        if(++conv->fifo_pos == conv->block_length)
+        {
+            fir_conv_block(conv);
+            conv->fifo_pos = 0;
+        }
+    }
+}
+
+/**
+ *  One overlap-save step on the block in p_in_fifo
+**/
+static void fir_conv_block(fir_conv *conv)
+{
+    unsigned int p, k, slot;
+    const unsigned int B = conv->block_length;
+    const unsigned int P = conv->num_partitions;
+    const unsigned int bins = conv->num_bins;
+    fftw_complex * restrict p_acc = conv->p_accum;
+    const fftw_complex * restrict p_x;
+    const fftw_complex * restrict p_h;
+    double * restrict p_in = conv->p_time_in;
+
+    /* Slide the 2B input window along by one block */
+    memmove(p_in, p_in + B, sizeof(double) * B);
+    for(k = 0; k < B; ++k)
+    {
+        p_in[B + k] = conv->p_in_fifo[k];
+    }
+
+    fftw_execute_dft_r2c(conv->forward, p_in, conv->p_fdl + (size_t) conv->fdl_pos * conv->stride);
+
+    /**
+     *  Y = sum_p X[n - p] * H[p].  The inner loop is a plain
+     *  complex multiply-accumulate the compiler vectorizes
+    **/
+    memset(p_acc, 0, sizeof(fftw_complex) * bins);
+    for(p = 0; p < P; ++p)
+    {
+        slot = conv->fdl_pos >= p ? conv->fdl_pos - p : conv->fdl_pos + P - p;
+        p_x = conv->p_fdl + (size_t) slot * conv->stride;
+        p_h = conv->p_filter + (size_t) p * conv->stride;
+        for(k = 0; k < bins; ++k)
+        {
+            p_acc[k][0] += p_x[k][0] * p_h[k][0] - p_x[k][1] * p_h[k][1];
+            p_acc[k][1] += p_x[k][0] * p_h[k][1] + p_x[k][1] * p_h[k][0];
+        }
+    }
+
+    fftw_execute(conv->inverse);
+
+    /* The first half is circular wrap-around; keep the second */
+    for(k = 0; k < B; ++k)
+    {
+        conv->p_out_fifo[k] = (float) conv->p_time_out[B + k];
+    }
+
+    conv->fdl_pos = conv->fdl_pos + 1 < P ? conv->fdl_pos + 1 : 0;
+}
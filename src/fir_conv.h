@@ -0,0 +1,105 @@
+#ifndef FIR_CONV_H
+#define FIR_CONV_H
+
+#include "fftw3.h"
+
+/**
+ *  Uniformly partitioned overlap-save convolution.
+ *
+ *  The filter is cut into P partitions of B taps, each kept as
+ *  the spectrum of a 2B point FFT.  Every B input samples one
+ *  forward FFT goes into a frequency domain delay line (FDL),
+ *  the FDL is multiplied with the partition spectra and summed,
+ *  and one inverse FFT yields B output samples.  Cost per block
+ *  is two FFTs of 2B plus P complex multiply-accumulates over
+ *  B + 1 bins, and latency is B samples.
+**/
+typedef struct
+{
+    unsigned int block_length;
+    unsigned int fft_size;
+    unsigned int num_bins;
+    unsigned int num_partitions;
+
+    /**
+     * Distance between spectra in p_filter and p_fdl, rounded
+     * up so every spectrum keeps the buffer's alignment
+    **/
+    unsigned int stride;
+
+    /** Partition spectra, scaled by 1 / fft_size **/
+    fftw_complex *p_filter;
+
+    /** Spectra of the last P input blocks; newest at fdl_pos **/
+    fftw_complex *p_fdl;
+    unsigned int fdl_pos;
+
+    fftw_complex *p_accum;
+    double *p_time_in;
+    double *p_time_out;
+
+    fftw_plan forward;
+    fftw_plan inverse;
+
+    /**
+     * Sample FIFOs so callers can pass any number of frames;
+     * a full input FIFO triggers one block
+    **/
+    float *p_in_fifo;
+    float *p_out_fifo;
+    unsigned int fifo_pos;
+
+} fir_conv;
+
+/** ------------------------------------------
+ *  fir_conv_init
+ *  ------------------------------------------
+ *      Prepares convolution with num_taps taps
+ *      using blocks of block_length samples
+ *      (normally the audio callback size).
+ *      flags are FFTW planner flags.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int fir_conv_init
+(
+    fir_conv *conv
+    ,const float *taps
+    ,unsigned int num_taps
+    ,unsigned int block_length
+    ,unsigned int flags
+);
+
+/** ------------------------------------------
+ *  fir_conv_close
+ *  ------------------------------------------
+ *      Destroys plans and frees buffers
+ *  ==========================================
+**/
+void fir_conv_close(fir_conv *conv);
+
+/** ------------------------------------------
+ *  fir_conv_reset
+ *  ------------------------------------------
+ *      Clears the signal history
+ *  ==========================================
+**/
+void fir_conv_reset(fir_conv *conv);
+
+/** ----------------------------------------------------
+ *  fir_conv_process
+ *  ----------------------------------------------------
+ *      Filters framesPerBuffer samples.  Output lags
+ *      input by block_length samples.  input and
+ *      output may be the same buffer
+ *  ====================================================
+**/
+void fir_conv_process
+(
+    fir_conv *conv
+    ,const float *input
+    ,float *output
+    ,unsigned long framesPerBuffer
+);
+
+#endif
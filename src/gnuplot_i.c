@@ -115,7 +115,7 @@ gnuplot_ctrl * gnuplot_init(void)
 #ifdef _WIN32
 	handle->gnucmd = popen("C:\\gnuplot\\pgnuplot.exe -persist","w");
 #else
-    handle->gnucmd = popen ("/usr/local/bin/gnuplot", "w") ;
+    handle->gnucmd = popen ("gnuplot", "w") ;
 #endif
     if (handle->gnucmd == NULL) {
         fprintf(stderr, "error starting gnuplot, is gnuplot or gnuplot.exe in your path?\n") ;
@@ -0,0 +1,165 @@
+#include <string.h>
+#include <math.h>
+
+#include "latency_stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static const char *stage_names[LATENCY_NUM_STAGES] = { "window", "fft", "magnitude", "output" };
+
+
+void latency_stats_init(latency_stats *lat, unsigned int samplerate)
+{
+    unsigned int s;
+
+    memset(lat, 0, sizeof(*lat));
+    lat->samplerate = samplerate;
+    lat->input_age_ns = -1;
+
+    for(s = 0; s < LATENCY_NUM_STAGES; ++s)
+    {
+        lat->stages[s].min_us = HUGE_VAL;
+    }
+}
+
+unsigned long long latency_now_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (unsigned long long) ((double) count.QuadPart * 1e9 / (double) freq.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ull + (unsigned long long) ts.tv_nsec;
+#endif
+}
+
+void latency_stats_buffer(latency_stats *lat, unsigned long framesPerBuffer)
+{
+    lat->buffer_entry_ns = latency_now_ns();
+    lat->buffer_frames = framesPerBuffer;
+}
+
+unsigned long long latency_stats_capture_ns(const latency_stats *lat, double index)
+{
+    double age_ns;
+
+    /**
+     *  Sample i was captured i sample periods after the first
+     *  one.  Without a backend age, the last sample is taken to
+     *  have arrived just before the callback
+    **/
+    if(lat->input_age_ns >= 0)
+    {
+        age_ns = (double) lat->input_age_ns - index * 1e9 / lat->samplerate;
+    }
+    else
+    {
+        age_ns = ((double) lat->buffer_frames - 1 - index) * 1e9 / lat->samplerate;
+    }
+
+    return lat->buffer_entry_ns - (unsigned long long) (age_ns > 0.0 ? age_ns : 0.0);
+}
+
+static void hist_add(latency_hist *hist, double us)
+{
+    int b = 0;
+
+    if(us > 1.0)
+    {
+        b = (int) (log2(us) * LATENCY_BUCKETS_PER_OCTAVE);
+        b = b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+    }
+
+    ++hist->buckets[b];
+    ++hist->count;
+    hist->sum_us += us;
+    hist->min_us = us < hist->min_us ? us : hist->min_us;
+    hist->max_us = us > hist->max_us ? us : hist->max_us;
+}
+
+void latency_stats_frame
+(
+    latency_stats *lat
+    ,unsigned long long capture_ns
+    ,const unsigned long long *p_stage_ns
+)
+{
+    unsigned int s;
+    double us;
+
+    lat->last_capture_ns = capture_ns;
+
+    for(s = 0; s < LATENCY_NUM_STAGES; ++s)
+    {
+        us = p_stage_ns[s] > capture_ns ? (p_stage_ns[s] - capture_ns) / 1000.0 : 0.0;
+        lat->last_us[s] = us;
+        hist_add(&lat->stages[s], us);
+    }
+
+    if(lat->csv_fp)
+    {
+        fprintf(lat->csv_fp, "%llu", capture_ns);
+        for(s = 0; s < LATENCY_NUM_STAGES; ++s)
+        {
+            fprintf(lat->csv_fp, ",%.1f", lat->last_us[s]);
+        }
+        fputc('\n', lat->csv_fp);
+    }
+}
+
+double latency_hist_percentile(const latency_hist *hist, double p)
+{
+    int b;
+    unsigned long long seen = 0;
+    const double target = p * hist->count;
+    double upper;
+
+    if(!hist->count)
+    {
+        return 0.0;
+    }
+
+    /* Upper edge of the bucket holding the target, clamped to max */
+    for(b = 0; b < LATENCY_BUCKETS; ++b)
+    {
+        seen += hist->buckets[b];
+        if(seen >= target && seen)
+        {
+            upper = pow(2.0, (double) (b + 1) / LATENCY_BUCKETS_PER_OCTAVE);
+            return upper < hist->max_us ? upper : hist->max_us;
+        }
+    }
+
+    return hist->max_us;
+}
+
+void latency_stats_print(const latency_stats *lat, FILE *fp)
+{
+    unsigned int s;
+    const latency_hist *h;
+
+    fprintf(fp, "%-10s %8s %9s %9s %9s %9s %9s %9s  (us after capture)\n",
+            "stage", "frames", "min", "mean", "p50", "p90", "p99", "max");
+
+    for(s = 0; s < LATENCY_NUM_STAGES; ++s)
+    {
+        h = &lat->stages[s];
+        if(!h->count)
+        {
+            continue;
+        }
+        fprintf(fp, "%-10s %8llu %9.0f %9.0f %9.0f %9.0f %9.0f %9.0f\n", stage_names[s], h->count
+                ,h->min_us, h->sum_us / h->count
+                ,latency_hist_percentile(h, 0.5), latency_hist_percentile(h, 0.9)
+                ,latency_hist_percentile(h, 0.99), h->max_us);
+    }
+}
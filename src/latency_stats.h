@@ -0,0 +1,142 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdio.h>
+
+/**
+ *  Input to output latency of every FFT frame.
+ *
+ *  A frame's reference time is when the newest sample of its
+ *  window was captured.  It is derived from the callback entry
+ *  time, the age of the buffer's first sample (input_age_ns,
+ *  filled in by the audio backend from PortAudio's time info or
+ *  the simulated clock) and the sample's position in the
+ *  buffer.  Each stage then records how long after capture it
+ *  finished; the last stage is the end to end latency.
+ *
+ *  Distributions are kept in log spaced histograms, 8 buckets
+ *  per octave from 1 us, so percentiles are within ~9%.
+**/
+
+typedef enum
+{
+    LATENCY_STAGE_WINDOW    = 0,
+    LATENCY_STAGE_FFT       = 1,
+    LATENCY_STAGE_MAGNITUDE = 2,
+    LATENCY_STAGE_OUTPUT    = 3,
+    LATENCY_NUM_STAGES      = 4
+
+} latency_stage;
+
+#define LATENCY_BUCKETS_PER_OCTAVE  8
+#define LATENCY_BUCKETS             (25 * LATENCY_BUCKETS_PER_OCTAVE)
+
+typedef struct
+{
+    unsigned long long count;
+    double sum_us;
+    double min_us;
+    double max_us;
+    unsigned long buckets[LATENCY_BUCKETS];
+
+} latency_hist;
+
+typedef struct
+{
+    unsigned int samplerate;
+
+    /**
+     * Age of the first sample of the current buffer at
+     * callback entry.  Set by the audio backend before each
+     * callback; -1 when unknown, in which case the buffer is
+     * assumed to have just been completed
+    **/
+    long long input_age_ns;
+
+    /** Callback entry time and size, see latency_stats_buffer **/
+    unsigned long long buffer_entry_ns;
+    unsigned long buffer_frames;
+
+    latency_hist stages[LATENCY_NUM_STAGES];
+
+    /** Most recent frame: capture time and stage latencies **/
+    unsigned long long last_capture_ns;
+    double last_us[LATENCY_NUM_STAGES];
+
+    /**
+     * Optional per frame log, one CSV line per frame:
+     * capture_ns followed by every stage in us
+    **/
+    FILE *csv_fp;
+
+} latency_stats;
+
+/** ------------------------------------------
+ *  latency_stats_init
+ *  ------------------------------------------
+ *      Clears everything for a stream at
+ *      samplerate
+ *  ==========================================
+**/
+void latency_stats_init(latency_stats *lat, unsigned int samplerate);
+
+/** ------------------------------------------
+ *  latency_now_ns
+ *  ------------------------------------------
+ *      Monotonic clock used for every stamp
+ *  ==========================================
+**/
+unsigned long long latency_now_ns(void);
+
+/** ----------------------------------------------------
+ *  latency_stats_buffer
+ *  ----------------------------------------------------
+ *      Call at the start of every callback
+ *  ====================================================
+**/
+void latency_stats_buffer(latency_stats *lat, unsigned long framesPerBuffer);
+
+/** ----------------------------------------------------
+ *  latency_stats_capture_ns
+ *  ----------------------------------------------------
+ *      Capture time of sample index of the current
+ *      buffer.  Fractional and negative positions
+ *      (before the buffer, e.g. behind a resampler's
+ *      delay) are fine
+ *  ====================================================
+**/
+unsigned long long latency_stats_capture_ns(const latency_stats *lat, double index);
+
+/** ----------------------------------------------------
+ *  latency_stats_frame
+ *  ----------------------------------------------------
+ *      Records one frame: its capture time and the
+ *      time each stage finished
+ *  ====================================================
+**/
+void latency_stats_frame
+(
+    latency_stats *lat
+    ,unsigned long long capture_ns
+    ,const unsigned long long *p_stage_ns
+);
+
+/** ----------------------------------------------------
+ *  latency_hist_percentile
+ *  ----------------------------------------------------
+ *      Latency in us below which fraction p (0..1) of
+ *      the recorded frames fall
+ *  ====================================================
+**/
+double latency_hist_percentile(const latency_hist *hist, double p);
+
+/** ----------------------------------------------------
+ *  latency_stats_print
+ *  ----------------------------------------------------
+ *      One line per stage: count, min, mean, p50,
+ *      p90, p99 and max
+ *  ====================================================
+**/
+void latency_stats_print(const latency_stats *lat, FILE *fp);
+
+#endif
@@ -1,8 +1,11 @@
 #include <stdio.h>
-#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "portaudio.h"
 #include "fft_block.h"
+#include "pcm_source.h"
+#include "audio_backend.h"
+#include "control.h"
 
 #ifdef _WIN32
 #include <conio.h>
@@ -12,77 +15,863 @@
 #endif
 
 
+/* Defaults, every one of them can be changed on the command line */
 #define SAMPLE_RATE 48000
 #define FFT_LENGTH  2048
-#define PA_CHECKERROR(x) assert( (x) == paNoError);
+#define FRAMES_PER_BUFFER   256
 
+/* Headless output: image size and how often the PNG is rewritten */
+#define RENDER_WIDTH        800
+#define RENDER_HEIGHT       600
+#define RENDER_PNG_PATH     "fft_block.png"
+#define RENDER_PNG_INTERVAL 10
 
-static int callback(const void* input,
-                    void* output,
-                    unsigned long framesPerBuffer,
-                    const PaStreamCallbackTimeInfo* time_info,
-                    PaStreamCallbackFlags flags,
-                    void* userData)
+/* Frames per read when analysing a pipe or file */
+#define PCM_BLOCK_FRAMES    4096
+
+/* How often an unattended simulated run checks whether it has finished */
+#define SIM_POLL_MS         50
+
+/* Archive: frames per chunk, level resolution and floor in dB */
+#define ARCHIVE_CHUNK_FRAMES    256
+#define ARCHIVE_STEP_DB         0.1
+#define ARCHIVE_FLOOR_DB        -160.0
+
+/* Trigger: capture when broadband energy jumps by this much */
+#define TRIGGER_CHANGE_DB       12.0
+
+typedef enum
+{
+    PLOT_AUTO       = 0,
+    PLOT_GNUPLOT    = 1,
+    PLOT_PNG        = 2,
+    PLOT_NONE       = 3
+
+} main_plot;
+
+typedef struct
+{
+    unsigned int samplerate;
+    unsigned int fft_length;
+    unsigned int window_length;
+    unsigned int hop;
+    fft_block_window window;
+    unsigned int plan_flags;
+    unsigned int frames_per_buffer;
+    unsigned int threads;
+
+    const char *audio;
+    main_plot plot;
+    const char *png_path;
+    const char *archive;
+    const char *trigger;
+    const char *control;
+
+    /**
+     * Simulated device: extra wakeup delay up to sim_jitter_us,
+     * frames to run (0 until enter is pressed) and raw float32
+     * mono input instead of the synthetic tone
+    **/
+    unsigned int sim_jitter_us;
+    unsigned int sim_frames;
+    const char *sim_input;
+
+    /** Raw PCM input instead of a device: path, format, channels **/
+    const char *pcm_path;
+    const char *pcm_format;
+    const char *pcm_channels;
+
+} main_options;
+
+/** What the control thread reports on; set before it starts **/
+typedef struct
 {
-    float* in = (float*)input;
-    float* out = (float*)output;
+    const main_options *p_opts;
+    audio_backend *p_audio;
+    latency_stats *p_latency;
+    spec_archive *p_archive;
+    trigger_engine *p_trigger;
+    spectrum_render *p_render;
+
+    /**
+     * Length, padding, window and planner last asked for.
+     * A switch is only picked up by the next callback, so
+     * requests in quick succession build on these, not on
+     * the live settings
+    **/
+    unsigned int fft_length;
+    unsigned int window_length;
+    fft_block_window window;
+    unsigned int plan_flags;
+    unsigned int hop;
+
+    /** Frame count and time of the last stats request **/
+    unsigned long last_frames;
+    unsigned long long last_ns;
+
+} main_state;
+
+static const char *window_names[] = { "hann", "hamming", "blackman", "rectangular" };
+static const char *planner_names[] = { "estimate", "measure", "patient", "exhaustive" };
+static const unsigned int planner_flags[] = { FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT, FFTW_EXHAUSTIVE };
+static const char *plot_names[] = { "auto", "gnuplot", "png", "none" };
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void usage(FILE *fp);
+static int parse_options(int argc, const char *argv[], main_options *opts);
+static int parse_uint(const char *text, unsigned int *p_value);
+static int parse_name(const char *text, const char **names, unsigned int count);
+static int control_request(int argc, char **argv, FILE *fp, void *userData);
+static int control_set(main_state *state, int argc, char **argv, FILE *fp);
+static unsigned int frame_hop(unsigned int hop, unsigned int fft_length, unsigned int window_length);
+static void print_stats(main_state *state, FILE *fp);
+/* ------------------------------------------------------------------------ */
+
+
+/**
+ *  Analyse raw PCM from a pipe or file instead of the default
+ *  device.  Channel 0 goes through fft_block; there is no
+ *  audio output
+**/
+static int run_pcm_source(const char *path, const char *format_name, const char *channels_arg)
+{
+    long frames;
+    pcm_source_format format = PCM_SOURCE_F32;
+    unsigned int channels = 1;
+    float *p_mono, *p_out;
+    pcm_source src;
+
+    if(format_name && pcm_source_parse_format(format_name, &format))
+    {
+        fprintf(stderr, "Unknown sample format '%s' (s16, s32 or f32)\n", format_name);
+        return 1;
+    }
+    if(channels_arg)
+    {
+        channels = (unsigned int) strtoul(channels_arg, NULL, 10);
+    }
+
+    if(pcm_source_open(&src, path, format, channels, PCM_BLOCK_FRAMES))
+    {
+        fprintf(stderr, "Cannot read PCM from %s\n", path);
+        return 1;
+    }
+
+    p_mono = (float *) malloc(sizeof(float) * PCM_BLOCK_FRAMES);
+    p_out = (float *) malloc(sizeof(float) * PCM_BLOCK_FRAMES);
+
+    while(p_mono && p_out && (frames = pcm_source_read(&src)) > 0)
+    {
+        pcm_source_channel(&src, (unsigned long) frames, 0, p_mono);
+        fft_block_process(p_mono, p_out, (unsigned long) frames, NULL);
+    }
 
-    /* Perform FFT process */
-    fft_block_process(in
-                      ,out
-                      ,framesPerBuffer
-                      ,userData
-                      );
+    printf("Read %llu frames\n", src.frames_read);
+
+    free(p_mono);
+    free(p_out);
+    pcm_source_close(&src);
 
     return 0;
 }
 
+/**
+ *  fft_block [options]                 default audio device
+ *  fft_block [options] <path|-> [fmt] [ch] [rate]
+ *                                      raw PCM, fmt s16/s32/f32,
+ *                                      resampled unless at 48 kHz
+ *
+ *  See usage() for the options.  FFT_BLOCK_AUDIO,
+ *  FFT_BLOCK_ARCHIVE and FFT_BLOCK_TRIGGER in the environment
+ *  stand in for --audio, --archive and --trigger
+**/
 int main(int argc, const char * argv[])
 {
     int fft_err;
-    PaStream *stream;
-    PaError err;
+    int b_render = 0;
+    main_options opts;
+    main_state state;
+    fft_block_config config;
+    spectrum_render render;
+    audio_backend audio;
+    audio_sim_config sim;
+    pcm_source sim_source;
+    int b_sim = 0, b_sim_source = 0;
+    latency_stats latency;
+    spec_archive archive;
+    int b_archive = 0;
+    trigger_config trigger_cfg;
+    trigger_engine trigger;
+    int b_trigger = 0;
+    control_server control;
+    int b_control = 0;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.samplerate = SAMPLE_RATE;
+    opts.fft_length = FFT_LENGTH;
+    opts.window = FFT_BLOCK_WINDOW_HANN;
+    opts.plan_flags = FFTW_ESTIMATE;
+    opts.frames_per_buffer = FRAMES_PER_BUFFER;
+    opts.threads = 1;
+    opts.audio = getenv("FFT_BLOCK_AUDIO");
+    opts.png_path = RENDER_PNG_PATH;
+    opts.archive = getenv("FFT_BLOCK_ARCHIVE");
+    opts.trigger = getenv("FFT_BLOCK_TRIGGER");
+
+    fft_err = parse_options(argc, argv, &opts);
+    if(fft_err)
+    {
+        usage(fft_err < 0 ? stderr : stdout);
+        return fft_err < 0 ? 1 : 0;
+    }
+
+    /* Threaded plans; must be set up before anything is planned */
+    if(opts.threads > 1)
+    {
+#ifdef FFT_BLOCK_FFTW_THREADS
+        fftw_init_threads();
+        fftw_plan_with_nthreads((int) opts.threads);
+#else
+        fprintf(stderr, "Built without FFTW threads, planning for one thread\n");
+#endif
+    }
 
     /* Initialize fft block */
-    fft_err = fft_block_init(SAMPLE_RATE, FFT_LENGTH);
-
-    /* Init Portaudio */
-    err = Pa_Initialize();
-    PA_CHECKERROR(err);
-
-    /* Use default audio device with one input and output */
-    err = Pa_OpenDefaultStream(&stream
-                               ,1
-                               ,1
-                               ,paFloat32
-                               ,SAMPLE_RATE
-                               ,256
-                               ,callback
-                               ,NULL);
-    PA_CHECKERROR(err);
-
-    /* Let Portaudio start */
-    printf("Starting stream... press 'enter' to exit\n");
-    err = Pa_StartStream(stream);
-    PA_CHECKERROR(err);
-
-    /* Run until user provides keyboard input */
-    GETCH();
-
-    /* Stop Portaudio */
-    printf("\nDone!\n");
-    err = Pa_StopStream(stream);
-    PA_CHECKERROR(err);
+    fft_block_default_config(&config);
+    config.samplerate = opts.samplerate;
+    config.fft_length = opts.fft_length;
+    config.window_length = opts.window_length;
+    config.window = opts.window;
+    config.hop = opts.hop;
+    config.plan_flags = opts.plan_flags;
+    if(opts.plot != PLOT_AUTO)
+    {
+        config.use_gnuplot = opts.plot == PLOT_GNUPLOT;
+    }
+    fft_err = fft_block_init_config(&config);
+    if(fft_err)
+    {
+        fprintf(stderr, "Cannot analyse with a %u point FFT\n", opts.fft_length);
+        return 1;
+    }
+
+    /* No display for gnuplot: draw into a PNG instead */
+    if(!config.use_gnuplot && opts.plot != PLOT_NONE
+       && spectrum_render_init(&render, RENDER_WIDTH, RENDER_HEIGHT, RENDER_HEIGHT / 2,
+                               FFT_BLOCK_ANALYSIS_RATE, opts.fft_length) == 0)
+    {
+        if(spectrum_render_start(&render, NULL, opts.png_path, RENDER_PNG_INTERVAL) == 0)
+        {
+            fft_block_set_renderer(&render);
+            b_render = 1;
+            printf("Writing spectrum to %s\n", opts.png_path);
+        }
+        else
+        {
+            spectrum_render_close(&render);
+        }
+    }
+
+    if(opts.archive)
+    {
+        if(spec_archive_open(&archive, opts.archive, opts.fft_length / 2 + 1, ARCHIVE_CHUNK_FRAMES,
+                             ARCHIVE_STEP_DB, ARCHIVE_FLOOR_DB) == 0)
+        {
+            fft_block_set_archive(&archive);
+            b_archive = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Cannot open archive %s\n", opts.archive);
+        }
+    }
+
+    if(opts.trigger)
+    {
+        trigger_default_config(&trigger_cfg, FFT_BLOCK_ANALYSIS_RATE, opts.fft_length / 2 + 1);
+        trigger_cfg.frame_hop = frame_hop(opts.hop, opts.fft_length, opts.window_length);
+        /* fft_block hands the trigger a whole buffer at once when it does not resample */
+        trigger_cfg.max_block = opts.pcm_path ? PCM_BLOCK_FRAMES : opts.frames_per_buffer;
+        if(opts.samplerate != FFT_BLOCK_ANALYSIS_RATE)
+        {
+            trigger_cfg.max_block = (unsigned long) FFT_BLOCK_ANALYSIS_RATE * FFT_BLOCK_RESAMPLE_BLOCK
+                                    / opts.samplerate + 1;
+        }
+        trigger_cfg.directory = opts.trigger;
+        trigger_add_condition(&trigger_cfg, TRIGGER_BAND_CHANGE, 20.0, 20000.0, TRIGGER_CHANGE_DB);
+        if(trigger_init(&trigger, &trigger_cfg) == 0)
+        {
+            fft_block_set_trigger(&trigger);
+            b_trigger = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Cannot start trigger capture to %s\n", opts.trigger);
+        }
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.p_opts = &opts;
+    state.p_archive = b_archive ? &archive : NULL;
+    state.p_trigger = b_trigger ? &trigger : NULL;
+    state.p_render = b_render ? &render : NULL;
+    state.fft_length = opts.fft_length;
+    state.window_length = opts.window_length;
+    state.window = opts.window;
+    state.plan_flags = opts.plan_flags;
+    state.hop = opts.hop;
+    state.last_ns = latency_now_ns();
+
+    if(opts.pcm_path)
+    {
+        if(opts.control && control_open(&control, opts.control, control_request, &state) == 0)
+        {
+            b_control = 1;
+        }
+
+        fft_err = run_pcm_source(opts.pcm_path, opts.pcm_format, opts.pcm_channels);
+    }
+    else
+    {
+        /* Real device unless the simulated one was asked for */
+        b_sim = opts.audio && strcmp(opts.audio, "sim") == 0;
+        if(b_sim)
+        {
+            audio_sim_default_config(&sim);
+            sim.samplerate = opts.samplerate;
+            sim.frames_per_buffer = opts.frames_per_buffer;
+            sim.jitter_us = opts.sim_jitter_us;
+            sim.max_frames = opts.sim_frames;
+            if(opts.sim_input)
+            {
+                b_sim_source = pcm_source_open(&sim_source, opts.sim_input, PCM_SOURCE_F32, 1,
+                                               opts.frames_per_buffer) == 0;
+                if(!b_sim_source)
+                {
+                    fprintf(stderr, "Cannot read PCM from %s\n", opts.sim_input);
+                }
+                sim.p_source = b_sim_source ? &sim_source : NULL;
+            }
+            fft_err = opts.sim_input && !b_sim_source ? -1
+                      : audio_backend_open_sim(&audio, &sim, fft_block_process, NULL);
+        }
+        else
+        {
+            fft_err = audio_backend_open_portaudio(&audio, opts.samplerate, opts.frames_per_buffer,
+                                                   fft_block_process, NULL);
+        }
+    }
+
+    if(!opts.pcm_path && fft_err)
+    {
+        fprintf(stderr, "Cannot open audio\n");
+    }
+    else if(!opts.pcm_path)
+    {
+        /* Time every frame from capture to the end of its outputs */
+        latency_stats_init(&latency, opts.samplerate);
+        audio.p_latency = &latency;
+        fft_block_set_latency(&latency);
+
+        state.p_audio = &audio;
+        state.p_latency = &latency;
+        if(opts.control && control_open(&control, opts.control, control_request, &state) == 0)
+        {
+            b_control = 1;
+        }
+
+        /* Let the backend start */
+        if(b_sim && (opts.sim_frames || b_sim_source))
+        {
+            printf("Starting %s stream...\n", audio.ops->name);
+        }
+        else
+        {
+            printf("Starting %s stream... press 'enter' to exit\n", audio.ops->name);
+        }
+        if(audio_backend_start(&audio) == 0)
+        {
+            if(b_sim && (opts.sim_frames || b_sim_source))
+            {
+                /* Unattended: run until the frame limit or the end of the input */
+                while(!audio_backend_finished(&audio))
+                {
+                    Pa_Sleep(SIM_POLL_MS);
+                }
+            }
+            else
+            {
+                /* Run until user provides keyboard input */
+                GETCH();
+            }
+
+            printf("\nDone!\n");
+            audio_backend_stop(&audio);
+        }
+
+        if(audio.stats.callbacks)
+        {
+            printf("%lu callbacks, %lu xruns, callback avg %.1f us max %.1f us\n"
+                   ,audio.stats.callbacks, audio.stats.xruns
+                   ,audio.stats.callback_sum_us / audio.stats.callbacks, audio.stats.callback_max_us);
+            latency_stats_print(&latency, stdout);
+        }
+    }
+
+    if(opts.control && !b_control)
+    {
+        fprintf(stderr, "Cannot listen for control requests on %s\n", opts.control);
+    }
+    if(b_control)
+    {
+        control_close(&control);
+    }
+    if(!opts.pcm_path && !fft_err)
+    {
+        audio_backend_close(&audio);
+    }
+    if(b_sim_source)
+    {
+        pcm_source_close(&sim_source);
+    }
 
     /* free the fft block */
     fft_block_close();
 
-    /* Clean up Portaudio */
-    err = Pa_CloseStream(stream);
-    PA_CHECKERROR(err);
+    if(b_archive)
+    {
+        printf("Archived %llu frames to %s, %llu dropped\n", archive.frames_written, opts.archive,
+               archive.frames_dropped);
+        spec_archive_close(&archive);
+    }
+
+    if(b_trigger)
+    {
+        trigger_stop(&trigger);
+        printf("Triggered %lu events, %lu saved, %lu dropped\n", trigger.events_fired,
+               (unsigned long) atomic_load(&trigger.events_written), trigger.events_dropped);
+        trigger_close(&trigger);
+    }
 
-    err = Pa_Terminate();
-    PA_CHECKERROR(err);
+    if(b_render)
+    {
+        spectrum_render_close(&render);
+    }
+
+    return fft_err ? 1 : 0;
+}
+
+static void usage(FILE *fp)
+{
+    fprintf(fp,
+        "usage: fft_block [options] [<path|-> [fmt] [ch] [rate]]\n"
+        "\n"
+        "  --rate N            input sample rate (%d)\n"
+        "  --fft N             FFT length (%d)\n"
+        "  --window-length N   samples per window, zero padded up to the FFT length\n"
+        "  --hop N             samples between frames, default one window\n"
+        "  --window NAME       hann, hamming, blackman or rectangular\n"
+        "  --precision NAME    double (the only one the C block has)\n"
+        "  --planner NAME      estimate, measure, patient or exhaustive\n"
+        "  --buffer N          frames per device buffer (%d)\n"
+        "  --threads N         FFTW planner threads\n"
+        "  --audio NAME        portaudio or sim\n"
+        "  --plot NAME         auto, gnuplot, png or none\n"
+        "  --png PATH          image written by the png plot (%s)\n"
+        "  --archive PATH      append every frame to a spectrogram archive\n"
+        "  --trigger DIR       save audio around sudden level changes to DIR\n"
+        "  --control PATH      accept requests on a Unix socket, \"help\" lists them\n"
+        "  --sim-jitter US     sim: delay every wakeup by up to US microseconds\n"
+        "  --sim-frames N      sim: stop after N frames instead of waiting for enter\n"
+        "  --sim-input PATH    sim: play raw float32 mono from PATH, stop at its end\n"
+        "\n"
+        "A path reads raw PCM (fmt s16, s32 or f32, ch channels) instead of a\n"
+        "device; \"-\" is standard input.\n"
+        ,SAMPLE_RATE, FFT_LENGTH, FRAMES_PER_BUFFER, RENDER_PNG_PATH);
+}
+
+/**
+ *  Fills opts from "--name value" or "--name=value" options and
+ *  the positional PCM arguments.  Returns 0, 1 for --help, or
+ *  -1 after printing what was wrong
+**/
+static int parse_options(int argc, const char *argv[], main_options *opts)
+{
+    int i, k, option, positional = 0;
+    const char *p_name, *p_value, *p_eq;
+    size_t name_length;
+    static const char *names[] = { "rate", "fft", "window-length", "hop", "window", "precision",
+                                   "planner", "buffer", "threads", "audio", "plot", "png",
+                                   "archive", "trigger", "control", "sim-jitter", "sim-frames",
+                                   "sim-input" };
+
+    for(i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+        {
+            return 1;
+        }
+
+        if(strncmp(argv[i], "--", 2) != 0)
+        {
+            switch(positional++)
+            {
+                case 0: opts->pcm_path = argv[i]; break;
+                case 1: opts->pcm_format = argv[i]; break;
+                case 2: opts->pcm_channels = argv[i]; break;
+                case 3:
+                    if(parse_uint(argv[i], &opts->samplerate))
+                    {
+                        fprintf(stderr, "Bad sample rate '%s'\n", argv[i]);
+                        return -1;
+                    }
+                    break;
+                default:
+                    fprintf(stderr, "Unexpected argument '%s'\n", argv[i]);
+                    return -1;
+            }
+            continue;
+        }
+
+        p_name = argv[i] + 2;
+        p_eq = strchr(p_name, '=');
+        name_length = p_eq ? (size_t) (p_eq - p_name) : strlen(p_name);
+        for(option = 0; option < (int) (sizeof(names) / sizeof(names[0])); ++option)
+        {
+            if(strlen(names[option]) == name_length && strncmp(p_name, names[option], name_length) == 0)
+            {
+                break;
+            }
+        }
+        if(option == (int) (sizeof(names) / sizeof(names[0])))
+        {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            return -1;
+        }
+
+        p_value = p_eq ? p_eq + 1 : (i + 1 < argc ? argv[++i] : NULL);
+        if(!p_value)
+        {
+            fprintf(stderr, "Option --%s needs a value\n", names[option]);
+            return -1;
+        }
+
+        switch(option)
+        {
+            case 0:  k = parse_uint(p_value, &opts->samplerate); break;
+            case 1:  k = parse_uint(p_value, &opts->fft_length); break;
+            case 2:  k = parse_uint(p_value, &opts->window_length); break;
+            case 3:  k = parse_uint(p_value, &opts->hop); break;
+            case 4:
+                k = parse_name(p_value, window_names, sizeof(window_names) / sizeof(window_names[0]));
+                opts->window = (fft_block_window) k;
+                break;
+            case 5:
+                /* Single precision is FftBlock<N, float> in fft_block.hpp */
+                k = strcmp(p_value, "double") ? -1 : 0;
+                break;
+            case 6:
+                k = parse_name(p_value, planner_names, sizeof(planner_names) / sizeof(planner_names[0]));
+                opts->plan_flags = k < 0 ? opts->plan_flags : planner_flags[k];
+                break;
+            case 7:  k = parse_uint(p_value, &opts->frames_per_buffer); break;
+            case 8:  k = parse_uint(p_value, &opts->threads); break;
+            case 9:  opts->audio = p_value; k = 0; break;
+            case 10:
+                k = parse_name(p_value, plot_names, sizeof(plot_names) / sizeof(plot_names[0]));
+                opts->plot = (main_plot) k;
+                break;
+            case 11: opts->png_path = p_value; k = 0; break;
+            case 12: opts->archive = p_value; k = 0; break;
+            case 13: opts->trigger = p_value; k = 0; break;
+            case 14: opts->control = p_value; k = 0; break;
+            case 15: k = parse_uint(p_value, &opts->sim_jitter_us); break;
+            case 16: k = parse_uint(p_value, &opts->sim_frames); break;
+            default: opts->sim_input = p_value; k = 0; break;
+        }
+
+        if(k < 0)
+        {
+            fprintf(stderr, "Bad value '%s' for --%s\n", p_value, names[option]);
+            return -1;
+        }
+    }
+
+    if(!opts->samplerate || !opts->frames_per_buffer || !opts->threads)
+    {
+        fprintf(stderr, "Rate, buffer and threads must be above 0\n");
+        return -1;
+    }
 
     return 0;
 }
+
+/* Whole decimal number; returns 0, or -1 if text is not one */
+static int parse_uint(const char *text, unsigned int *p_value)
+{
+    char *p_end;
+    unsigned long value = strtoul(text, &p_end, 10);
+
+    if(p_end == text || *p_end || value > 0xFFFFFFFFul || *text == '-')
+    {
+        return -1;
+    }
+
+    *p_value = (unsigned int) value;
+    return 0;
+}
+
+/* Index of text in names, -1 if it is not there */
+static int parse_name(const char *text, const char **names, unsigned int count)
+{
+    unsigned int i;
+
+    for(i = 0; i < count; ++i)
+    {
+        if(strcmp(text, names[i]) == 0)
+        {
+            return (int) i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ *  Control socket requests, run on the control thread:
+ *
+ *      stats               live counters
+ *      show                the settings in use
+ *      set fft N           FFT length, no padding
+ *      set window-length N zero padded window of N samples
+ *      set window NAME
+ *      set hop N           0 for one window
+ *      set planner NAME    plan the current length again
+ *      help
+**/
+static int control_request(int argc, char **argv, FILE *fp, void *userData)
+{
+    main_state *state = (main_state *) userData;
+    fft_block_status status;
+    unsigned int i;
+
+    if(strcmp(argv[0], "stats") == 0)
+    {
+        print_stats(state, fp);
+        return 0;
+    }
+
+    if(strcmp(argv[0], "show") == 0)
+    {
+        if(fft_block_get_status(&status))
+        {
+            return -1;
+        }
+
+        for(i = 0; i < sizeof(planner_flags) / sizeof(planner_flags[0]); ++i)
+        {
+            if(planner_flags[i] == status.plan_flags)
+            {
+                break;
+            }
+        }
+        fprintf(fp, "rate %u\nfft %u\nwindow-length %u\nwindow %s\nhop %u\n"
+                ,status.input_rate, status.fft_length, status.window_length
+                ,window_names[status.window], status.hop);
+        if(i < sizeof(planner_flags) / sizeof(planner_flags[0]))
+        {
+            fprintf(fp, "planner %s\n", planner_names[i]);
+        }
+        else
+        {
+            fprintf(fp, "planner unknown (%#x)\n", status.plan_flags);
+        }
+        fprintf(fp, "precision double\nbuffer %u\nthreads %u\n"
+                ,state->p_opts->frames_per_buffer, state->p_opts->threads);
+        return 0;
+    }
+
+    if(strcmp(argv[0], "set") == 0)
+    {
+        return control_set(state, argc, argv, fp);
+    }
+
+    if(strcmp(argv[0], "help") == 0)
+    {
+        fprintf(fp, "stats\nshow\nset fft N\nset window-length N\nset window NAME\n"
+                    "set hop N\nset planner NAME\nquit\n");
+        return 0;
+    }
+
+    fprintf(fp, "unknown request '%s'\n", argv[0]);
+    return -1;
+}
+
+static int control_set(main_state *state, int argc, char **argv, FILE *fp)
+{
+    unsigned int fft_length = state->fft_length;
+    unsigned int window_length = state->window_length;
+    fft_block_window window = state->window;
+    unsigned int plan_flags = state->plan_flags;
+    unsigned int hop = state->hop;
+    unsigned int value = 0;
+    int k;
+
+    if(argc != 3)
+    {
+        fprintf(fp, "usage: set <name> <value>\n");
+        return -1;
+    }
+
+    if(strcmp(argv[1], "hop") == 0)
+    {
+        if(parse_uint(argv[2], &value))
+        {
+            fprintf(fp, "cannot set hop to '%s'\n", argv[2]);
+            return -1;
+        }
+        hop = value;
+    }
+    /* Length, window and planner changes go through a switch between callbacks */
+    else if(strcmp(argv[1], "planner") == 0
+       && (k = parse_name(argv[2], planner_names, sizeof(planner_names) / sizeof(planner_names[0]))) >= 0)
+    {
+        plan_flags = planner_flags[k];
+    }
+    else if(strcmp(argv[1], "fft") == 0 && parse_uint(argv[2], &value) == 0)
+    {
+        fft_length = value;
+        window_length = 0;
+    }
+    else if(strcmp(argv[1], "window-length") == 0 && parse_uint(argv[2], &value) == 0)
+    {
+        window_length = value;
+    }
+    else if(strcmp(argv[1], "window") == 0
+            && (k = parse_name(argv[2], window_names, sizeof(window_names) / sizeof(window_names[0]))) >= 0)
+    {
+        window = (fft_block_window) k;
+    }
+    else if(strcmp(argv[1], "rate") == 0 || strcmp(argv[1], "buffer") == 0
+            || strcmp(argv[1], "threads") == 0 || strcmp(argv[1], "precision") == 0)
+    {   /* The device and FFTW are set up for these once, at start */
+        fprintf(fp, "%s is fixed at start, see --%s\n", argv[1], argv[1]);
+        return -1;
+    }
+    else
+    {
+        fprintf(fp, "cannot set %s to '%s'\n", argv[1], argv[2]);
+        return -1;
+    }
+
+    /* The trigger's frame ring was sized for its frame spacing; closer frames would overflow it */
+    if(state->p_trigger && frame_hop(hop, fft_length, window_length) < state->p_trigger->config.frame_hop)
+    {
+        fprintf(fp, "trigger capture needs a hop of at least %u\n", state->p_trigger->config.frame_hop);
+        return -1;
+    }
+
+    if(strcmp(argv[1], "hop") == 0)
+    {
+        if(fft_block_set_hop(hop) < 0)
+        {
+            return -1;
+        }
+        state->hop = hop;
+        return 0;
+    }
+
+    fft_block_set_plan_flags(plan_flags);
+    if(fft_block_switch(fft_length, window_length, window) < 0)
+    {
+        fft_block_set_plan_flags(state->plan_flags);
+        return -1;
+    }
+
+    state->plan_flags = plan_flags;
+    state->fft_length = fft_length;
+    state->window_length = window_length;
+    state->window = window;
+
+    return 0;
+}
+
+/**
+ *  Analysis samples between frames: the hop, or one window
+ *  when it is 0
+**/
+static unsigned int frame_hop(unsigned int hop, unsigned int fft_length, unsigned int window_length)
+{
+    if(hop)
+    {
+        return hop;
+    }
+    return window_length ? window_length : fft_length;
+}
+
+/**
+ *  Throughput since the previous stats request, latency and
+ *  everything dropped so far.  Counters written by the audio
+ *  thread are read without locking, so they may be a callback
+ *  apart from each other
+**/
+static void print_stats(main_state *state, FILE *fp)
+{
+    fft_block_status status;
+    const audio_backend_stats *p_audio;
+    const latency_hist *p_total;
+    unsigned long long now = latency_now_ns();
+    double seconds;
+
+    if(fft_block_get_status(&status) == 0)
+    {
+        seconds = (now - state->last_ns) * 1e-9;
+        fprintf(fp, "frames %lu\n", status.frames);
+        if(seconds > 0.0)
+        {
+            fprintf(fp, "frames_per_s %.1f\nsamples_per_s %.0f\n"
+                    ,(status.frames - state->last_frames) / seconds
+                    ,(status.frames - state->last_frames) * (double) status.hop / seconds);
+        }
+        state->last_frames = status.frames;
+        state->last_ns = now;
+    }
+
+    if(state->p_audio)
+    {
+        p_audio = &state->p_audio->stats;
+        fprintf(fp, "callbacks %lu\nxruns %lu\ncallback_avg_us %.1f\ncallback_max_us %.1f\n"
+                ,p_audio->callbacks, p_audio->xruns
+                ,p_audio->callbacks ? p_audio->callback_sum_us / p_audio->callbacks : 0.0
+                ,p_audio->callback_max_us);
+    }
+
+    if(state->p_latency)
+    {
+        /* The last stage is capture to the end of the outputs */
+        p_total = &state->p_latency->stages[LATENCY_NUM_STAGES - 1];
+        if(p_total->count)
+        {
+            fprintf(fp, "latency_p50_us %.1f\nlatency_p99_us %.1f\nlatency_max_us %.1f\n"
+                    ,latency_hist_percentile(p_total, 0.50)
+                    ,latency_hist_percentile(p_total, 0.99)
+                    ,p_total->max_us);
+        }
+    }
+
+    if(state->p_trigger)
+    {
+        fprintf(fp, "trigger_events %lu\ntrigger_dropped %lu\n"
+                ,state->p_trigger->events_fired, state->p_trigger->events_dropped);
+    }
+    if(state->p_archive)
+    {
+        fprintf(fp, "archive_frames %llu\narchive_dropped %llu\narchive_errors %lu\n"
+                ,state->p_archive->frames_written, state->p_archive->frames_dropped
+                ,(unsigned long) atomic_load(&state->p_archive->write_errors));
+    }
+    if(state->p_render)
+    {
+        fprintf(fp, "render_dropped %lu\n", state->p_render->images_dropped);
+    }
+}
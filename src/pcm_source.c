@@ -0,0 +1,226 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pcm_source.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define PCM_OPEN(path)          _open((path), _O_RDONLY | _O_BINARY)
+#define PCM_READ(fd, buf, n)    _read((fd), (buf), (unsigned int) (n))
+#define PCM_CLOSE(fd)           _close(fd)
+#else
+#include <unistd.h>
+#define PCM_OPEN(path)          open((path), O_RDONLY)
+#define PCM_READ(fd, buf, n)    read((fd), (buf), (n))
+#define PCM_CLOSE(fd)           close(fd)
+#endif
+
+#define PCM_SOURCE_STDIN    0
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void pcm_source_convert(pcm_source *src, unsigned long frames);
+/* ------------------------------------------------------------------------ */
+
+
+int pcm_source_open
+(
+    pcm_source *src
+    ,const char *path
+    ,pcm_source_format format
+    ,unsigned int channels
+    ,unsigned long block_frames
+)
+{
+    if(!src || !path || !channels || !block_frames)
+    {
+        return -1;
+    }
+
+    memset(src, 0, sizeof(*src));
+    src->format = format;
+    src->channels = channels;
+    src->block_frames = block_frames;
+
+    switch(format)
+    {
+        case PCM_SOURCE_S16: src->sample_bytes = 2; break;
+        case PCM_SOURCE_S32: src->sample_bytes = 4; break;
+        case PCM_SOURCE_F32: src->sample_bytes = 4; break;
+        default: return -1;
+    }
+    src->frame_bytes = src->sample_bytes * channels;
+
+    src->p_raw = (unsigned char *) malloc((size_t) src->frame_bytes * block_frames);
+    src->p_frames = (float *) malloc(sizeof(float) * channels * block_frames);
+    if(!src->p_raw || !src->p_frames)
+    {
+        pcm_source_close(src);
+        return -1;
+    }
+
+    if(strcmp(path, "-") == 0)
+    {
+        src->fd = PCM_SOURCE_STDIN;
+#ifdef _WIN32
+        _setmode(PCM_SOURCE_STDIN, _O_BINARY);
+#endif
+    }
+    else
+    {
+        src->fd = PCM_OPEN(path);
+        src->b_owned = 1;
+        if(src->fd < 0)
+        {
+            src->b_owned = 0;
+            pcm_source_close(src);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void pcm_source_close(pcm_source *src)
+{
+    if(!src)
+    {
+        return;
+    }
+
+    if(src->b_owned)
+    {
+        PCM_CLOSE(src->fd);
+    }
+    free(src->p_raw);
+    free(src->p_frames);
+    memset(src, 0, sizeof(*src));
+}
+
+int pcm_source_parse_format(const char *name, pcm_source_format *p_format)
+{
+    if(strcmp(name, "s16") == 0)
+    {
+        *p_format = PCM_SOURCE_S16;
+    }
+    else if(strcmp(name, "s32") == 0)
+    {
+        *p_format = PCM_SOURCE_S32;
+    }
+    else if(strcmp(name, "f32") == 0)
+    {
+        *p_format = PCM_SOURCE_F32;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+long pcm_source_read(pcm_source *src)
+{
+    long n;
+    unsigned long frames;
+    const size_t capacity = (size_t) src->frame_bytes * src->block_frames;
+
+    if(src->b_eof)
+    {
+        return 0;
+    }
+
+    /* One large read; loop only while no whole frame has arrived */
+    while(src->raw_fill < src->frame_bytes)
+    {
+        n = (long) PCM_READ(src->fd, src->p_raw + src->raw_fill, capacity - src->raw_fill);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n < 0)
+        {
+            return -1;
+        }
+        if(n == 0)
+        {
+            /* A trailing partial frame is dropped */
+            src->b_eof = 1;
+            return 0;
+        }
+        src->raw_fill += (unsigned int) n;
+    }
+
+    frames = src->raw_fill / src->frame_bytes;
+    pcm_source_convert(src, frames);
+    src->frames_read += frames;
+
+    /* Carry the partial frame over to the front */
+    src->raw_fill -= (unsigned int) (frames * src->frame_bytes);
+    memmove(src->p_raw, src->p_raw + frames * src->frame_bytes, src->raw_fill);
+
+    return (long) frames;
+}
+
+void pcm_source_channel
+(
+    const pcm_source *src
+    ,unsigned long frames
+    ,unsigned int channel
+    ,float *p_out
+)
+{
+    unsigned long i;
+    const unsigned int channels = src->channels;
+    const float *p_in = src->p_frames + channel;
+
+    if(channels == 1)
+    {
+        memcpy(p_out, p_in, sizeof(float) * frames);
+        return;
+    }
+
+    for(i = 0; i < frames; ++i)
+    {
+        p_out[i] = p_in[i * channels];
+    }
+}
+
+/**
+ *  Convert frames whole frames at the start of p_raw.  p_raw
+ *  comes from malloc, so the typed loads below are aligned and
+ *  each loop is a flat convert-and-scale the compiler vectorizes
+**/
+static void pcm_source_convert(pcm_source *src, unsigned long frames)
+{
+    unsigned long i;
+    const unsigned long count = frames * src->channels;
+    float * restrict p_out = src->p_frames;
+    const int16_t * restrict p_s16;
+    const int32_t * restrict p_s32;
+
+    switch(src->format)
+    {
+        case PCM_SOURCE_S16:
+            p_s16 = (const int16_t *) src->p_raw;
+            for(i = 0; i < count; ++i)
+            {
+                p_out[i] = p_s16[i] * (1.0f / 32768.0f);
+            }
+            break;
+
+        case PCM_SOURCE_S32:
+            p_s32 = (const int32_t *) src->p_raw;
+            for(i = 0; i < count; ++i)
+            {
+                p_out[i] = (float) p_s32[i] * (1.0f / 2147483648.0f);
+            }
+            break;
+
+        case PCM_SOURCE_F32:
+            memcpy(p_out, src->p_raw, sizeof(float) * count);
+            break;
+    }
+}
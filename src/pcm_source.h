@@ -0,0 +1,111 @@
+#ifndef PCM_SOURCE_H
+#define PCM_SOURCE_H
+
+typedef enum
+{
+    PCM_SOURCE_S16  = 0,
+    PCM_SOURCE_S32  = 1,
+    PCM_SOURCE_F32  = 2
+
+} pcm_source_format;
+
+/**
+ *  Raw interleaved PCM from stdin, a FIFO or a file, e.g.
+ *
+ *      arecord -f S16_LE -r 48000 -c 2 -t raw | fft_block - s16 2
+ *
+ *  Each read asks the OS for a whole block of frames at once and
+ *  converts everything that arrived to float in one pass.  A
+ *  partial frame at the end of a read is kept for the next one,
+ *  so pipes delivering odd byte counts are fine.  Samples are in
+ *  native byte order.
+**/
+typedef struct
+{
+    int fd;
+    int b_owned;
+    int b_eof;
+
+    pcm_source_format format;
+    unsigned int channels;
+    unsigned int sample_bytes;
+    unsigned int frame_bytes;
+
+    /**
+     * Raw bytes as read, block_frames frames long.  raw_fill
+     * bytes of a partial frame carry over at the start
+    **/
+    unsigned char *p_raw;
+    unsigned int raw_fill;
+
+    /** Converted interleaved samples, block_frames frames **/
+    float *p_frames;
+    unsigned long block_frames;
+
+    unsigned long long frames_read;
+
+} pcm_source;
+
+/** ------------------------------------------
+ *  pcm_source_open
+ *  ------------------------------------------
+ *      Opens path ("-" for stdin) holding
+ *      channels interleaved channels, read in
+ *      blocks of up to block_frames frames.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int pcm_source_open
+(
+    pcm_source *src
+    ,const char *path
+    ,pcm_source_format format
+    ,unsigned int channels
+    ,unsigned long block_frames
+);
+
+/** ------------------------------------------
+ *  pcm_source_close
+ *  ------------------------------------------
+ *      Closes the file (not stdin) and frees
+ *      buffers
+ *  ==========================================
+**/
+void pcm_source_close(pcm_source *src);
+
+/** ------------------------------------------
+ *  pcm_source_parse_format
+ *  ------------------------------------------
+ *      "s16", "s32" or "f32" to a format.
+ *      Returns 0 on success, -1 if unknown
+ *  ==========================================
+**/
+int pcm_source_parse_format(const char *name, pcm_source_format *p_format);
+
+/** ----------------------------------------------------
+ *  pcm_source_read
+ *  ----------------------------------------------------
+ *      Blocks until at least one whole frame is
+ *      available, then returns the number of frames
+ *      now in p_frames (interleaved, -1..1).
+ *      Returns 0 at end of input, -1 on error
+ *  ====================================================
+**/
+long pcm_source_read(pcm_source *src);
+
+/** ----------------------------------------------------
+ *  pcm_source_channel
+ *  ----------------------------------------------------
+ *      Copies one channel of the last read to p_out,
+ *      for mono consumers such as fft_block_process
+ *  ====================================================
+**/
+void pcm_source_channel
+(
+    const pcm_source *src
+    ,unsigned long frames
+    ,unsigned int channel
+    ,float *p_out
+);
+
+#endif
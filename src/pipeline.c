@@ -0,0 +1,791 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pipeline.h"
+
+/* ------------------------ Function Prototypes --------------------------- */
+static int add_stage(pipeline *p, const pipeline_stage *proto);
+static int chain_end(const pipeline *p, pipeline_format *p_format, unsigned int *p_length);
+static int connect_stage(pipeline_stage *stage, pipeline_format format, unsigned int length);
+static pipeline_chain *chain_build(pipeline *p);
+static void chain_free(pipeline_chain *chain);
+static void chain_take(pipeline *p);
+static void *element(const void *buffer, pipeline_format format, unsigned int index);
+static void run_fused(pipeline_chain *chain, const pipeline_group *group, const void *in);
+static void run_frame(pipeline_stage *stage, const void *in, void *out);
+static void run_tap(pipeline_stage *stage, const void *in);
+static void apply_window(pipeline_stage *stage, const void *in, void *out, unsigned int start, unsigned int count);
+static void apply_power(pipeline_stage *stage, const void *in, void *out, unsigned int start, unsigned int count);
+static void apply_db(pipeline_stage *stage, const void *in, void *out, unsigned int start, unsigned int count);
+static void apply_average(pipeline_stage *stage, const void *in, void *out, unsigned int start, unsigned int count);
+/* ------------------------------------------------------------------------ */
+
+
+int pipeline_init(pipeline *p, unsigned int frame_length)
+{
+    if(!p || !frame_length)
+    {
+        return -1;
+    }
+
+    memset(p, 0, sizeof(*p));
+    p->frame_length = frame_length;
+    atomic_init(&p->pending, NULL);
+    atomic_init(&p->retired, NULL);
+    atomic_init(&p->attach_count, 0);
+
+    return 0;
+}
+
+void pipeline_close(pipeline *p)
+{
+    unsigned int i;
+
+    if(!p)
+    {
+        return;
+    }
+
+    chain_free(atomic_exchange(&p->pending, NULL));
+    chain_free(atomic_exchange(&p->retired, NULL));
+    chain_free(p->p_chain);
+    for(i = 0; i < p->num_stages; ++i)
+    {
+        free(p->stages[i].p_values);
+    }
+
+    memset(p, 0, sizeof(*p));
+}
+
+int pipeline_add_decimate(pipeline *p, unsigned int factor)
+{
+    pipeline_stage proto;
+
+    if(!factor)
+    {
+        return -1;
+    }
+
+    memset(&proto, 0, sizeof(proto));
+    proto.kind = PIPELINE_DECIMATE;
+    proto.factor = factor;
+
+    return add_stage(p, &proto);
+}
+
+int pipeline_add_window(pipeline *p, const double *p_coeffs)
+{
+    pipeline_stage proto;
+    pipeline_format format;
+    unsigned int length;
+    int index;
+
+    if(!p_coeffs || chain_end(p, &format, &length) < 0)
+    {
+        return -1;
+    }
+
+    memset(&proto, 0, sizeof(proto));
+    proto.kind = PIPELINE_WINDOW;
+    proto.apply = apply_window;
+    proto.num_values = length;
+    proto.p_values = (double *) malloc(sizeof(double) * length);
+    if(!proto.p_values)
+    {
+        return -1;
+    }
+    memcpy(proto.p_values, p_coeffs, sizeof(double) * length);
+
+    index = add_stage(p, &proto);
+    if(index < 0)
+    {
+        free(proto.p_values);
+    }
+
+    return index;
+}
+
+int pipeline_add_fft(pipeline *p, unsigned int plan_flags)
+{
+    pipeline_stage proto;
+
+    memset(&proto, 0, sizeof(proto));
+    proto.kind = PIPELINE_FFT;
+    proto.plan_flags = plan_flags;
+
+    return add_stage(p, &proto);
+}
+
+int pipeline_add_power(pipeline *p)
+{
+    pipeline_stage proto;
+
+    memset(&proto, 0, sizeof(proto));
+    proto.kind = PIPELINE_POWER;
+    proto.apply = apply_power;
+
+    return add_stage(p, &proto);
+}
+
+int pipeline_add_db(pipeline *p)
+{
+    pipeline_stage proto;
+
+    memset(&proto, 0, sizeof(proto));
+    proto.kind = PIPELINE_DB;
+    proto.apply = apply_db;
+
+    return add_stage(p, &proto);
+}
+
+int pipeline_add_average(pipeline *p, unsigned int frames)
+{
+    pipeline_stage proto;
+
+    if(!frames)
+    {
+        return -1;
+    }
+
+    memset(&proto, 0, sizeof(proto));
+    proto.kind = PIPELINE_AVERAGE;
+    proto.apply = apply_average;
+    proto.average_frames = frames;
+
+    return add_stage(p, &proto);
+}
+
+int pipeline_add_bands(pipeline *p, const unsigned int *p_edges, unsigned int num_bands)
+{
+    pipeline_stage proto;
+    unsigned int b;
+
+    if(!p_edges || !num_bands || num_bands > PIPELINE_MAX_BANDS)
+    {
+        return -1;
+    }
+    for(b = 0; b < num_bands; ++b)
+    {
+        if(p_edges[b] > p_edges[b + 1])
+        {
+            return -1;
+        }
+    }
+
+    memset(&proto, 0, sizeof(proto));
+    proto.kind = PIPELINE_BANDS;
+    proto.num_bands = num_bands;
+    memcpy(proto.band_edges, p_edges, sizeof(unsigned int) * (num_bands + 1));
+
+    return add_stage(p, &proto);
+}
+
+int pipeline_add_features(pipeline *p, spectral_features_ctx *features)
+{
+    pipeline_stage proto;
+
+    if(!features)
+    {
+        return -1;
+    }
+
+    memset(&proto, 0, sizeof(proto));
+    proto.kind = PIPELINE_FEATURES;
+    proto.p_features = features;
+
+    return add_stage(p, &proto);
+}
+
+int pipeline_add_sink(pipeline *p, pipeline_sink sink, void *userData)
+{
+    pipeline_stage proto;
+
+    if(!sink)
+    {
+        return -1;
+    }
+
+    memset(&proto, 0, sizeof(proto));
+    proto.kind = PIPELINE_SINK;
+    proto.sink = sink;
+    proto.sink_data = userData;
+
+    return add_stage(p, &proto);
+}
+
+int pipeline_set_enabled(pipeline *p, unsigned int stage, int b_enabled)
+{
+    if(stage >= p->num_stages)
+    {
+        return -1;
+    }
+
+    p->stages[stage].b_enabled = b_enabled;
+    p->b_built = 0;
+
+    return 0;
+}
+
+int pipeline_build(pipeline *p)
+{
+    pipeline_chain *chain;
+
+    pipeline_reclaim(p);
+
+    chain = chain_build(p);
+    if(!chain)
+    {
+        return -1;
+    }
+
+    /* Replaces a build pipeline_process has not picked up yet */
+    chain_free(atomic_exchange_explicit(&p->pending, chain, memory_order_acq_rel));
+    p->b_built = 1;
+
+    return 0;
+}
+
+void pipeline_reclaim(pipeline *p)
+{
+    chain_free(atomic_exchange_explicit(&p->retired, NULL, memory_order_acquire));
+}
+
+int pipeline_process(pipeline *p, const double *frame)
+{
+    unsigned int i;
+    pipeline_stage *st;
+    pipeline_chain *chain;
+    const pipeline_group *g;
+    const void *p_cur = frame;
+
+    if(atomic_load_explicit(&p->pending, memory_order_relaxed))
+    {
+        chain_take(p);
+    }
+
+    chain = p->p_chain;
+    if(!chain)
+    {
+        return -1;
+    }
+
+    /* Cumulative mean until the time constant is reached, then exponential */
+    for(i = 0; i < chain->num_stages; ++i)
+    {
+        st = &chain->stages[i];
+        if(st->kind == PIPELINE_AVERAGE)
+        {
+            st->weight = st->frames_seen < st->average_frames ? 1.0 / (st->frames_seen + 1) : 1.0 / st->average_frames;
+            ++st->frames_seen;
+        }
+    }
+
+    for(i = 0; i < chain->num_groups; ++i)
+    {
+        g = &chain->groups[i];
+        st = &chain->stages[g->first];
+
+        if(g->b_tap)
+        {
+            run_tap(st, p_cur);
+            continue;
+        }
+
+        if(g->b_fused)
+        {
+            run_fused(chain, g, p_cur);
+        }
+        else
+        {
+            if(st->p_staging)
+            {
+                memcpy(st->p_staging, p_cur, sizeof(double) * st->in_length);
+            }
+            run_frame(st, p_cur, g->p_out);
+        }
+        p_cur = g->p_out;
+    }
+
+    p->p_result = p_cur;
+    p->result_length = chain->result_length;
+    p->result_format = chain->result_format;
+    p->p_spectrum = chain->p_spectrum;
+    p->spectrum_length = chain->spectrum_length;
+    ++p->frames;
+
+    return 0;
+}
+
+/**
+ *  Connects a copy of proto to the end of the chain and
+ *  appends it.  Returns its index, or -1
+**/
+static int add_stage(pipeline *p, const pipeline_stage *proto)
+{
+    pipeline_stage *st;
+    pipeline_format format;
+    unsigned int length;
+
+    if(p->num_stages == PIPELINE_MAX_STAGES || chain_end(p, &format, &length) < 0)
+    {
+        return -1;
+    }
+
+    st = &p->stages[p->num_stages];
+    *st = *proto;
+    st->b_enabled = 1;
+    if(connect_stage(st, format, length) < 0)
+    {
+        memset(st, 0, sizeof(*st));
+        return -1;
+    }
+
+    /* Changes the chain; the next frame needs a new build */
+    p->b_built = 0;
+
+    return (int) p->num_stages++;
+}
+
+/* Format and length leaving the last enabled stage, -1 if the enabled stages do not connect */
+static int chain_end(const pipeline *p, pipeline_format *p_format, unsigned int *p_length)
+{
+    unsigned int i;
+    pipeline_stage st;
+
+    *p_format = PIPELINE_REAL;
+    *p_length = p->frame_length;
+
+    for(i = 0; i < p->num_stages; ++i)
+    {
+        if(!p->stages[i].b_enabled)
+        {
+            continue;
+        }
+
+        st = p->stages[i];
+        if(connect_stage(&st, *p_format, *p_length) < 0)
+        {
+            return -1;
+        }
+        *p_format = st.out_format;
+        *p_length = st.out_length;
+    }
+
+    return 0;
+}
+
+/**
+ *  Sets the stage's input to format and length and works out
+ *  its output.  Returns -1 if it does not take that input
+**/
+static int connect_stage(pipeline_stage *stage, pipeline_format format, unsigned int length)
+{
+    pipeline_format out_format = format;
+    unsigned int out_length = length;
+
+    switch(stage->kind)
+    {
+        case PIPELINE_DECIMATE:
+            if(format != PIPELINE_REAL || length % stage->factor)
+            {
+                return -1;
+            }
+            out_length = length / stage->factor;
+            break;
+
+        case PIPELINE_WINDOW:
+            if(format != PIPELINE_REAL || length != stage->num_values)
+            {
+                return -1;
+            }
+            break;
+
+        case PIPELINE_FFT:
+            if(format != PIPELINE_REAL || length < 2)
+            {
+                return -1;
+            }
+            out_format = PIPELINE_COMPLEX;
+            out_length = length / 2 + 1;
+            break;
+
+        case PIPELINE_POWER:
+            if(format != PIPELINE_COMPLEX)
+            {
+                return -1;
+            }
+            out_format = PIPELINE_REAL;
+            break;
+
+        case PIPELINE_DB:
+            if(format != PIPELINE_REAL)
+            {
+                return -1;
+            }
+            out_format = PIPELINE_LEVEL;
+            break;
+
+        case PIPELINE_AVERAGE:
+            if(format == PIPELINE_COMPLEX)
+            {
+                return -1;
+            }
+            break;
+
+        case PIPELINE_BANDS:
+            /* Sums of dB values mean nothing */
+            if(format != PIPELINE_REAL || stage->band_edges[stage->num_bands] > length)
+            {
+                return -1;
+            }
+            out_length = stage->num_bands;
+            break;
+
+        case PIPELINE_FEATURES:
+            if(format != PIPELINE_COMPLEX || stage->p_features->fft_length != length)
+            {
+                return -1;
+            }
+            break;
+
+        case PIPELINE_SINK:
+            break;
+
+        default:
+            return -1;
+    }
+
+    if(!out_length)
+    {
+        return -1;
+    }
+
+    stage->in_format = format;
+    stage->in_length = length;
+    stage->out_format = out_format;
+    stage->out_length = out_length;
+
+    return 0;
+}
+
+/**
+ *  Copies the enabled stages into a new chain, connects and
+ *  groups them, then allocates one buffer per group and plans
+ *  the FFT on the buffer it reads
+**/
+static pipeline_chain *chain_build(pipeline *p)
+{
+    unsigned int i, length = p->frame_length;
+    pipeline_format format = PIPELINE_REAL;
+    pipeline_chain *chain;
+    pipeline_stage *st;
+    pipeline_group *g = NULL;
+    double *p_producer = NULL;
+    size_t element_size;
+
+    chain = (pipeline_chain *) calloc(1, sizeof(pipeline_chain));
+    if(!chain)
+    {
+        return NULL;
+    }
+
+    /* Complex chunks are the larger */
+    chain->p_scratch[0] = (double *) fftw_malloc(sizeof(double) * 2 * PIPELINE_CHUNK);
+    chain->p_scratch[1] = (double *) fftw_malloc(sizeof(double) * 2 * PIPELINE_CHUNK);
+    if(!chain->p_scratch[0] || !chain->p_scratch[1])
+    {
+        chain_free(chain);
+        return NULL;
+    }
+
+    for(i = 0; i < p->num_stages; ++i)
+    {
+        if(!p->stages[i].b_enabled)
+        {
+            continue;
+        }
+        if(connect_stage(&p->stages[i], format, length) < 0)
+        {
+            chain_free(chain);
+            return NULL;
+        }
+
+        st = &chain->stages[chain->num_stages];
+        *st = p->stages[i];
+        st->p_record = &p->features[i];
+
+        if(st->kind == PIPELINE_AVERAGE)
+        {
+            st->p_state = (double *) calloc(st->out_length, sizeof(double));
+            if(!st->p_state)
+            {
+                chain_free(chain);
+                return NULL;
+            }
+        }
+
+        if(st->apply && g && g->b_fused)
+        {   /* Joins the run of elementwise stages before it */
+            g->last = chain->num_stages;
+        }
+        else
+        {
+            g = &chain->groups[chain->num_groups++];
+            g->first = g->last = chain->num_stages;
+            g->b_fused = st->apply != NULL;
+            g->b_tap = st->kind == PIPELINE_FEATURES || st->kind == PIPELINE_SINK;
+        }
+
+        ++chain->num_stages;
+        format = st->out_format;
+        length = st->out_length;
+    }
+
+    /* One buffer per group, and plans on the buffers they read */
+    for(i = 0; i < chain->num_groups; ++i)
+    {
+        g = &chain->groups[i];
+        if(g->b_tap)
+        {
+            continue;
+        }
+
+        st = &chain->stages[g->last];
+        element_size = st->out_format == PIPELINE_COMPLEX ? sizeof(fftw_complex) : sizeof(double);
+        g->p_out = fftw_malloc(element_size * st->out_length);
+        if(!g->p_out)
+        {
+            chain_free(chain);
+            return NULL;
+        }
+
+        st = &chain->stages[g->first];
+        if(st->kind == PIPELINE_FFT)
+        {
+            if(!p_producer)
+            {   /* Reads the caller's frame, which need not be aligned */
+                st->p_staging = (double *) fftw_malloc(sizeof(double) * st->in_length);
+                p_producer = st->p_staging;
+            }
+            st->plan = p_producer ? fftw_plan_dft_r2c_1d((int) st->in_length, p_producer,
+                                                          (fftw_complex *) g->p_out, st->plan_flags) : NULL;
+            if(!st->plan)
+            {
+                chain_free(chain);
+                return NULL;
+            }
+            chain->p_spectrum = (const fftw_complex *) g->p_out;
+            chain->spectrum_length = st->out_length;
+        }
+
+        p_producer = (double *) g->p_out;
+    }
+
+    chain->result_format = format;
+    chain->result_length = length;
+
+    return chain;
+}
+
+static void chain_free(pipeline_chain *chain)
+{
+    unsigned int i;
+    pipeline_stage *st;
+
+    if(!chain)
+    {
+        return;
+    }
+
+    for(i = 0; i < chain->num_groups; ++i)
+    {
+        fftw_free(chain->groups[i].p_out);
+    }
+    for(i = 0; i < chain->num_stages; ++i)
+    {
+        st = &chain->stages[i];
+        if(st->plan)
+        {
+            fftw_destroy_plan(st->plan);
+        }
+        fftw_free(st->p_staging);
+        free(st->p_state);
+    }
+    fftw_free(chain->p_scratch[0]);
+    fftw_free(chain->p_scratch[1]);
+
+    free(chain);
+}
+
+/**
+ *  Runs on the processing thread: switch to the pending chain
+ *  if the last one has been reclaimed.  Only pointer swaps
+**/
+static void chain_take(pipeline *p)
+{
+    pipeline_chain *chain;
+
+    /* Retired slot still full: try again next frame */
+    if(atomic_load_explicit(&p->retired, memory_order_acquire))
+    {
+        return;
+    }
+
+    chain = atomic_exchange_explicit(&p->pending, NULL, memory_order_acq_rel);
+    if(!chain)
+    {
+        return;
+    }
+
+    if(p->p_chain)
+    {
+        atomic_store_explicit(&p->retired, p->p_chain, memory_order_release);
+    }
+    p->p_chain = chain;
+}
+
+static void *element(const void *buffer, pipeline_format format, unsigned int index)
+{
+    return (double *) buffer + (format == PIPELINE_COMPLEX ? 2 * (size_t) index : index);
+}
+
+/**
+ *  Every chunk goes through all stages of the group before the
+ *  next one is read.  Intermediate chunks alternate between the
+ *  two scratch buffers; only the last stage writes to memory
+ *  the size of the frame
+**/
+static void run_fused(pipeline_chain *chain, const pipeline_group *group, const void *in)
+{
+    unsigned int start, count, s, k;
+    const unsigned int length = chain->stages[group->first].in_length;
+    pipeline_stage *st;
+    const void *p_in;
+    void *p_out;
+
+    for(start = 0; start < length; start += PIPELINE_CHUNK)
+    {
+        count = length - start < PIPELINE_CHUNK ? length - start : PIPELINE_CHUNK;
+        p_in = element(in, chain->stages[group->first].in_format, start);
+
+        for(s = group->first, k = 0; s <= group->last; ++s)
+        {
+            st = &chain->stages[s];
+            p_out = s == group->last ? element(group->p_out, st->out_format, start) : chain->p_scratch[k++ & 1];
+            st->apply(st, p_in, p_out, start, count);
+            p_in = p_out;
+        }
+    }
+}
+
+static void run_frame(pipeline_stage *stage, const void *in, void *out)
+{
+    unsigned int i, j, b;
+    double sum;
+    const double *p_in = (const double *) in;
+    double *p_out = (double *) out;
+
+    switch(stage->kind)
+    {
+        case PIPELINE_DECIMATE:
+            for(i = 0; i < stage->out_length; ++i)
+            {
+                for(sum = 0.0, j = 0; j < stage->factor; ++j)
+                {
+                    sum += p_in[i * stage->factor + j];
+                }
+                p_out[i] = sum / stage->factor;
+            }
+            break;
+
+        case PIPELINE_FFT:
+            /* Planned on the buffer in points to, or on the staging copy */
+            fftw_execute(stage->plan);
+            break;
+
+        case PIPELINE_BANDS:
+            for(b = 0; b < stage->num_bands; ++b)
+            {
+                for(sum = 0.0, i = stage->band_edges[b]; i < stage->band_edges[b + 1]; ++i)
+                {
+                    sum += p_in[i];
+                }
+                p_out[b] = sum;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void run_tap(pipeline_stage *stage, const void *in)
+{
+    if(stage->kind == PIPELINE_FEATURES)
+    {
+        spectral_features_process(stage->p_features, (const fftw_complex *) in, stage->p_record);
+    }
+    else if(stage->kind == PIPELINE_SINK)
+    {
+        stage->sink(in, stage->in_length, stage->in_format, stage->sink_data);
+    }
+}
+
+static void apply_window(pipeline_stage *stage, const void *in, void *out, unsigned int start, unsigned int count)
+{
+    unsigned int i;
+    const double * restrict p_in = (const double *) in;
+    const double * restrict p_coeffs = stage->p_values + start;
+    double * restrict p_out = (double *) out;
+
+    for(i = 0; i < count; ++i)
+    {
+        p_out[i] = p_in[i] * p_coeffs[i];
+    }
+}
+
+static void apply_power(pipeline_stage *stage, const void *in, void *out, unsigned int start, unsigned int count)
+{
+    unsigned int i;
+    const double * restrict p_in = (const double *) in;
+    double * restrict p_out = (double *) out;
+
+    (void) stage;
+    (void) start;
+
+    for(i = 0; i < count; ++i)
+    {
+        p_out[i] = p_in[2 * i] * p_in[2 * i] + p_in[2 * i + 1] * p_in[2 * i + 1];
+    }
+}
+
+static void apply_db(pipeline_stage *stage, const void *in, void *out, unsigned int start, unsigned int count)
+{
+    unsigned int i;
+    const double * restrict p_in = (const double *) in;
+    double * restrict p_out = (double *) out;
+
+    (void) stage;
+    (void) start;
+
+    for(i = 0; i < count; ++i)
+    {
+        p_out[i] = 10.0 * log10(p_in[i] + PIPELINE_DB_FLOOR);
+    }
+}
+
+static void apply_average(pipeline_stage *stage, const void *in, void *out, unsigned int start, unsigned int count)
+{
+    unsigned int i;
+    const double * restrict p_in = (const double *) in;
+    double * restrict p_state = stage->p_state + start;
+    double * restrict p_out = (double *) out;
+    const double w = stage->weight;
+
+    for(i = 0; i < count; ++i)
+    {
+        p_state[i] += w * (p_in[i] - p_state[i]);
+        p_out[i] = p_state[i];
+    }
+}
@@ -0,0 +1,290 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdatomic.h>
+
+#include "fftw3.h"
+#include "spectral_features.h"
+
+/**
+ *  Composable per-channel analysis chain.
+ *
+ *  Stages are appended in order (decimate, window, FFT, power,
+ *  dB, averaging, band sums, features, sinks) and the chain is
+ *  then built away from the audio thread: the lengths and
+ *  formats of the enabled stages are worked out and checked,
+ *  every buffer is allocated and the FFT is planned on the
+ *  buffers it will really use.  Processing a frame allocates
+ *  nothing.
+ *
+ *  A build makes a new pipeline_chain and publishes it the way
+ *  fft_block_switch publishes a layout: pipeline_process picks
+ *  it up at its next frame once the chain before the last one
+ *  has been reclaimed, so a running pipeline can be rebuilt
+ *  from another thread.
+ *
+ *  Runs of adjacent elementwise stages (window, power, dB,
+ *  average) are fused: they walk the frame together in chunks
+ *  of PIPELINE_CHUNK elements, passing each chunk through a
+ *  small scratch buffer that stays in L1, and only the last one
+ *  writes a full length buffer.  Adding an elementwise stage
+ *  therefore adds arithmetic but no pass over memory.  Taps
+ *  (features, sinks) read the current buffer without copying
+ *  it.  Disabled stages are left out when building, so they
+ *  cost nothing per frame.
+**/
+#define PIPELINE_MAX_STAGES     16
+#define PIPELINE_MAX_BANDS      64
+#define PIPELINE_CHUNK          256
+
+/* Power added before taking dB, so silence stays finite (-200 dB) */
+#define PIPELINE_DB_FLOOR       1e-20
+
+typedef enum
+{
+    PIPELINE_REAL       = 0,
+    PIPELINE_COMPLEX    = 1,
+    /** Real levels in dB, which must not be summed **/
+    PIPELINE_LEVEL      = 2
+
+} pipeline_format;
+
+typedef enum
+{
+    PIPELINE_DECIMATE   = 0,
+    PIPELINE_WINDOW     = 1,
+    PIPELINE_FFT        = 2,
+    PIPELINE_POWER      = 3,
+    PIPELINE_DB         = 4,
+    PIPELINE_AVERAGE    = 5,
+    PIPELINE_BANDS      = 6,
+    PIPELINE_FEATURES   = 7,
+    PIPELINE_SINK       = 8
+
+} pipeline_stage_kind;
+
+typedef void (*pipeline_sink)(const void *data, unsigned int length, pipeline_format format, void *userData);
+
+typedef struct pipeline_stage pipeline_stage;
+
+/** Elementwise kernel over elements [start, start + count) of the frame **/
+typedef void (*pipeline_apply)(pipeline_stage *stage, const void *in, void *out,
+                               unsigned int start, unsigned int count);
+
+struct pipeline_stage
+{
+    pipeline_stage_kind kind;
+    int b_enabled;
+
+    /** Worked out from the enabled stages before it, by every build **/
+    pipeline_format in_format;
+    pipeline_format out_format;
+    unsigned int in_length;
+    unsigned int out_length;
+
+    /** Set for elementwise stages, which may be fused **/
+    pipeline_apply apply;
+
+    /** Window coefficients and their number **/
+    double *p_values;
+    unsigned int num_values;
+
+    /** Decimation factor **/
+    unsigned int factor;
+
+    /**
+     * Averaging: frames in the time constant, and in a built
+     * chain the running average per element, frames so far
+     * and this frame's weight
+    **/
+    unsigned int average_frames;
+    double *p_state;
+    unsigned long frames_seen;
+    double weight;
+
+    /** Band edges in elements, num_bands + 1 of them **/
+    unsigned int num_bands;
+    unsigned int band_edges[PIPELINE_MAX_BANDS + 1];
+
+    /**
+     * FFT: planner flags, the plan, and a staging input when
+     * no earlier stage owns a buffer it could be planned on
+    **/
+    unsigned int plan_flags;
+    fftw_plan plan;
+    double *p_staging;
+
+    /** Features and, in a built chain, where the record goes **/
+    spectral_features_ctx *p_features;
+    spectral_features *p_record;
+
+    pipeline_sink sink;
+    void *sink_data;
+};
+
+/** Stages first..last run as one unit and leave their result in p_out **/
+typedef struct
+{
+    unsigned int first;
+    unsigned int last;
+    int b_fused;
+    int b_tap;
+    void *p_out;
+
+} pipeline_group;
+
+/** What pipeline_build makes: copies of the enabled stages, grouped, with their buffers and plans **/
+typedef struct
+{
+    pipeline_stage stages[PIPELINE_MAX_STAGES];
+    unsigned int num_stages;
+
+    pipeline_group groups[PIPELINE_MAX_STAGES];
+    unsigned int num_groups;
+
+    /** Chunk buffers handed between fused stages **/
+    double *p_scratch[2];
+
+    pipeline_format result_format;
+    unsigned int result_length;
+
+    /** Output of the last FFT stage, NULL without one **/
+    const fftw_complex *p_spectrum;
+    unsigned int spectrum_length;
+
+} pipeline_chain;
+
+typedef struct
+{
+    unsigned int frame_length;
+
+    pipeline_stage stages[PIPELINE_MAX_STAGES];
+    unsigned int num_stages;
+
+    /** Set when the last build is of the stages as they are **/
+    int b_built;
+
+    /**
+     * Built chains on their way to pipeline_process and back,
+     * and the one it runs
+    **/
+    _Atomic(pipeline_chain *) pending;
+    _Atomic(pipeline_chain *) retired;
+    pipeline_chain *p_chain;
+
+    /** Requests and runs of fft_block holding on to the pipeline **/
+    atomic_uint attach_count;
+
+    /** Result of the last frame, set by pipeline_process **/
+    const void *p_result;
+    unsigned int result_length;
+    pipeline_format result_format;
+    const fftw_complex *p_spectrum;
+    unsigned int spectrum_length;
+    unsigned long frames;
+
+    /** Latest record of each features stage, by stage index **/
+    spectral_features features[PIPELINE_MAX_STAGES];
+
+} pipeline;
+
+/** ------------------------------------------
+ *  pipeline_init
+ *  ------------------------------------------
+ *      Empty chain taking real frames of
+ *      frame_length samples.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int pipeline_init(pipeline *p, unsigned int frame_length);
+
+/** ------------------------------------------
+ *  pipeline_close
+ *  ------------------------------------------
+ *      Destroys plans and frees every buffer.
+ *      Not while attach_count is above 0
+ *  ==========================================
+**/
+void pipeline_close(pipeline *p);
+
+/** ----------------------------------------------------
+ *  pipeline_add_*
+ *  ----------------------------------------------------
+ *      Append a stage to the chain, taking the output
+ *      of the last enabled stage.  Each returns the
+ *      stage index, or -1 if the chain is full, the
+ *      stage does not accept that input or an argument
+ *      is invalid.
+ *
+ *      decimate    real N -> real N / factor, the mean
+ *                  of every factor samples
+ *      window      real, multiplied by coeffs (copied,
+ *                  as many as the input is long)
+ *      fft         real N -> complex N / 2 + 1
+ *      power       complex -> real |X|^2
+ *      db          real -> level 10 log10
+ *      average     real or level, exponential mean
+ *                  over frames
+ *      bands       real -> real sums over num_bands
+ *                  ranges [edges[b], edges[b + 1])
+ *      features    complex tap into spectral_features
+ *      sink        tap handing the data to a callback
+ *  ====================================================
+**/
+int pipeline_add_decimate(pipeline *p, unsigned int factor);
+int pipeline_add_window(pipeline *p, const double *p_coeffs);
+int pipeline_add_fft(pipeline *p, unsigned int plan_flags);
+int pipeline_add_power(pipeline *p);
+int pipeline_add_db(pipeline *p);
+int pipeline_add_average(pipeline *p, unsigned int frames);
+int pipeline_add_bands(pipeline *p, const unsigned int *p_edges, unsigned int num_bands);
+int pipeline_add_features(pipeline *p, spectral_features_ctx *features);
+int pipeline_add_sink(pipeline *p, pipeline_sink sink, void *userData);
+
+/** ----------------------------------------------------
+ *  pipeline_set_enabled
+ *  ----------------------------------------------------
+ *      Includes or leaves out a stage from the next
+ *      pipeline_build.  Returns 0, or -1 for a bad index
+ *  ====================================================
+**/
+int pipeline_set_enabled(pipeline *p, unsigned int stage, int b_enabled);
+
+/** ----------------------------------------------------
+ *  pipeline_build
+ *  ----------------------------------------------------
+ *      Works out the lengths and formats of the enabled
+ *      stages, groups them, allocates buffers and plans
+ *      into a new chain and publishes it for
+ *      pipeline_process, replacing a chain it has not
+ *      picked up yet.  Safe while frames are processed
+ *      on another thread, but plans with FFTW, so not
+ *      concurrently with other planning.  Returns 0, or
+ *      -1 if the enabled stages do not connect or
+ *      memory ran out
+ *  ====================================================
+**/
+int pipeline_build(pipeline *p);
+
+/** ----------------------------------------------------
+ *  pipeline_reclaim
+ *  ----------------------------------------------------
+ *      Frees the chain pipeline_process has switched
+ *      away from.  pipeline_build does this too; a
+ *      build published before the previous one was
+ *      reclaimed waits for it
+ *  ====================================================
+**/
+void pipeline_reclaim(pipeline *p);
+
+/** ----------------------------------------------------
+ *  pipeline_process
+ *  ----------------------------------------------------
+ *      Runs one frame of frame_length samples through
+ *      the newest built chain it can take.  Returns 0,
+ *      or -1 if nothing has been built
+ *  ====================================================
+**/
+int pipeline_process(pipeline *p, const double *frame);
+
+#endif
@@ -0,0 +1,320 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pitch.h"
+
+/* ------------------------ Function Prototypes --------------------------- */
+static unsigned int autocorr_lag(pitch_tracker *pt, const fftw_complex *in);
+static unsigned int cepstrum_lag(pitch_tracker *pt, const fftw_complex *in);
+static unsigned int pick_autocorr(const pitch_tracker *pt, const double *p_score);
+static unsigned int pick_cepstrum(const pitch_tracker *pt, const double *p_score);
+static double refine_peak(const double *p_score, unsigned int lag, double *p_height);
+/* ------------------------------------------------------------------------ */
+
+
+int pitch_init
+(
+    pitch_tracker *pt
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+    ,pitch_method method
+    ,double min_hz
+    ,double max_hz
+    ,double threshold
+)
+{
+    if(!pt || !samplerate || pcm_length < 8 || min_hz <= 0.0 || max_hz <= min_hz
+       || (method != PITCH_AUTOCORR && method != PITCH_CEPSTRUM))
+    {
+        return -1;
+    }
+
+    memset(pt, 0, sizeof(*pt));
+    pt->samplerate = samplerate;
+    pt->pcm_length = pcm_length;
+    pt->fft_length = pcm_length / 2 + 1;
+    pt->method = method;
+
+    /* The neighbours of every searched lag must exist for refine_peak */
+    pt->min_lag = (unsigned int) floor(samplerate / max_hz);
+    pt->max_lag = (unsigned int) ceil(samplerate / min_hz);
+    if(pt->min_lag < 2)
+    {
+        pt->min_lag = 2;
+    }
+    if(pt->max_lag > pcm_length / 2 - 1)
+    {
+        pt->max_lag = pcm_length / 2 - 1;
+    }
+    if(pt->min_lag >= pt->max_lag)
+    {
+        return -1;
+    }
+
+    if(threshold > 0.0)
+    {
+        pt->threshold = threshold;
+    }
+    else
+    {
+        pt->threshold = method == PITCH_AUTOCORR ? PITCH_AUTOCORR_THRESHOLD : PITCH_CEPSTRUM_THRESHOLD;
+    }
+
+    pt->p_spec = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * pt->fft_length);
+    pt->p_lag = (double *) fftw_malloc(sizeof(double) * pcm_length);
+    if(!pt->p_spec || !pt->p_lag)
+    {
+        pitch_close(pt);
+        return -1;
+    }
+
+    pt->plan = fftw_plan_dft_c2r_1d((int) pcm_length, pt->p_spec, pt->p_lag, FFTW_ESTIMATE);
+    if(!pt->plan)
+    {
+        pitch_close(pt);
+        return -1;
+    }
+
+    return 0;
+}
+
+void pitch_close(pitch_tracker *pt)
+{
+    if(!pt)
+    {
+        return;
+    }
+
+    if(pt->plan)
+    {
+        fftw_destroy_plan(pt->plan);
+    }
+    fftw_free(pt->p_spec);
+    fftw_free(pt->p_lag);
+    free(pt->p_window_acf);
+
+    memset(pt, 0, sizeof(*pt));
+}
+
+int pitch_set_window(pitch_tracker *pt, const double *p_window, unsigned int window_length)
+{
+    unsigned int lag, i, j;
+    double sum, zero = 0.0;
+    double *p_acf;
+
+    if(!p_window || !window_length || window_length > pt->pcm_length)
+    {
+        return -1;
+    }
+    if(pt->max_lag > window_length / 2)
+    {
+        pt->max_lag = window_length / 2;
+    }
+    if(pt->min_lag >= pt->max_lag)
+    {
+        return -1;
+    }
+
+    p_acf = (double *) realloc(pt->p_window_acf, sizeof(double) * (pt->max_lag + 2));
+    if(!p_acf)
+    {
+        return -1;
+    }
+    pt->p_window_acf = p_acf;
+    pt->window_length = window_length;
+
+    /* Circular, like the lags pitch_process gets back from the c2r transform */
+    for(lag = 0; lag < pt->max_lag + 2; ++lag)
+    {
+        for(sum = 0.0, i = 0; i < window_length; ++i)
+        {
+            j = (i + lag) % pt->pcm_length;
+            sum += j < window_length ? p_window[i] * p_window[j] : 0.0;
+        }
+        if(!lag)
+        {
+            zero = sum;
+        }
+        p_acf[lag] = zero > 0.0 ? sum / zero : 0.0;
+    }
+
+    return zero > 0.0 ? 0 : -1;
+}
+
+void pitch_process
+(
+    pitch_tracker *pt
+    ,const fftw_complex *in
+    ,pitch_estimate *p_out
+)
+{
+    unsigned int lag;
+    double height = 0.0, period;
+
+    memset(p_out, 0, sizeof(*p_out));
+    p_out->frame = pt->frame++;
+
+    lag = pt->method == PITCH_AUTOCORR ? autocorr_lag(pt, in) : cepstrum_lag(pt, in);
+    if(lag)
+    {
+        period = refine_peak(pt->p_lag, lag, &height);
+        p_out->freq = (float) (pt->samplerate / period);
+        p_out->clarity = (float) height;
+        p_out->b_voiced = height >= pt->threshold;
+    }
+
+    if(pt->sink)
+    {
+        pt->sink(p_out, pt->sink_data);
+    }
+}
+
+/**
+ *  The inverse of the power spectrum is the autocorrelation.
+ *  Scores the searched lags in p_lag, normalised by lag 0 and
+ *  the window, and returns the chosen one or 0
+**/
+static unsigned int autocorr_lag(pitch_tracker *pt, const fftw_complex *in)
+{
+    unsigned int k, lag;
+    double scale;
+    double * restrict p_lag = pt->p_lag;
+    const unsigned int n = pt->fft_length;
+
+    for(k = 0; k < n; ++k)
+    {
+        pt->p_spec[k][0] = in[k][0] * in[k][0] + in[k][1] * in[k][1];
+        pt->p_spec[k][1] = 0.0;
+    }
+    fftw_execute(pt->plan);
+
+    if(p_lag[0] <= 0.0 || !pt->p_window_acf)
+    {   /* Silence, or no window to normalise by */
+        return 0;
+    }
+
+    scale = 1.0 / p_lag[0];
+    for(lag = pt->min_lag - 1; lag <= pt->max_lag + 1; ++lag)
+    {
+        p_lag[lag] *= pt->p_window_acf[lag] > 0.0 ? scale / pt->p_window_acf[lag] : 0.0;
+    }
+
+    return pick_autocorr(pt, p_lag);
+}
+
+/**
+ *  The inverse of the log power spectrum is the real
+ *  cepstrum.  Leaves it in p_lag and returns the quefrency
+ *  of its highest peak, or 0
+**/
+static unsigned int cepstrum_lag(pitch_tracker *pt, const fftw_complex *in)
+{
+    unsigned int k, lag;
+    double power, peak = 0.0, floor_power, scale;
+    double * restrict p_lag = pt->p_lag;
+    const unsigned int n = pt->fft_length;
+
+    for(k = 0; k < n; ++k)
+    {
+        power = in[k][0] * in[k][0] + in[k][1] * in[k][1];
+        peak = power > peak ? power : peak;
+        pt->p_spec[k][0] = power;
+    }
+    if(peak <= 0.0)
+    {
+        return 0;
+    }
+
+    /* Log power relative to the floor, so silent bins stay finite */
+    floor_power = peak * PITCH_CEPSTRUM_FLOOR;
+    for(k = 0; k < n; ++k)
+    {
+        pt->p_spec[k][0] = log(pt->p_spec[k][0] + floor_power);
+        pt->p_spec[k][1] = 0.0;
+    }
+    fftw_execute(pt->plan);
+
+    /* c2r is unnormalised; bring it back to the cepstrum proper */
+    scale = 1.0 / pt->pcm_length;
+    for(lag = pt->min_lag - 1; lag <= pt->max_lag + 1; ++lag)
+    {
+        p_lag[lag] *= scale;
+    }
+
+    return pick_cepstrum(pt, p_lag);
+}
+
+/**
+ *  Shortest lag whose local maximum comes within
+ *  PITCH_PEAK_RATIO of the strongest.  0 when the search
+ *  range holds no local maximum above zero
+**/
+static unsigned int pick_autocorr(const pitch_tracker *pt, const double *p_score)
+{
+    unsigned int lag;
+    double best = 0.0;
+
+    for(lag = pt->min_lag; lag <= pt->max_lag; ++lag)
+    {
+        if(p_score[lag] > p_score[lag - 1] && p_score[lag] >= p_score[lag + 1] && p_score[lag] > best)
+        {
+            best = p_score[lag];
+        }
+    }
+    if(best <= 0.0)
+    {
+        return 0;
+    }
+
+    for(lag = pt->min_lag; lag <= pt->max_lag; ++lag)
+    {
+        if(p_score[lag] > p_score[lag - 1] && p_score[lag] >= p_score[lag + 1]
+           && p_score[lag] >= PITCH_PEAK_RATIO * best)
+        {
+            break;
+        }
+    }
+
+    return lag;
+}
+
+/* Largest local maximum in the search range, 0 if none */
+static unsigned int pick_cepstrum(const pitch_tracker *pt, const double *p_score)
+{
+    unsigned int lag, best_lag = 0;
+    double best = 0.0;
+
+    for(lag = pt->min_lag; lag <= pt->max_lag; ++lag)
+    {
+        if(p_score[lag] > p_score[lag - 1] && p_score[lag] >= p_score[lag + 1] && p_score[lag] > best)
+        {
+            best = p_score[lag];
+            best_lag = lag;
+        }
+    }
+
+    return best_lag;
+}
+
+/**
+ *  Vertex of the parabola through lag and its neighbours:
+ *  the period in fractional samples, and its height
+**/
+static double refine_peak(const double *p_score, unsigned int lag, double *p_height)
+{
+    const double a = p_score[lag - 1];
+    const double b = p_score[lag];
+    const double c = p_score[lag + 1];
+    const double d = a - 2.0 * b + c;
+    double shift = 0.0;
+
+    if(d < 0.0)
+    {
+        shift = 0.5 * (a - c) / d;
+    }
+
+    *p_height = b - 0.25 * (a - c) * shift;
+
+    return lag + shift;
+}
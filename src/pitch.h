@@ -0,0 +1,159 @@
+#ifndef PITCH_H
+#define PITCH_H
+
+#include "fftw3.h"
+
+/**
+ *  Pitch estimation from the analysis spectrum.
+ *
+ *  The forward r2c transform fft_block already computes is
+ *  reused; one c2r transform of the same length turns it into
+ *  either the autocorrelation (power spectrum back to the lag
+ *  domain) or the real cepstrum (log power spectrum back to
+ *  quefrency).  The strongest peak between the lags of max_hz
+ *  and min_hz gives the period, refined by a parabola through
+ *  its neighbours.  A frame costs one extra FFT instead of an
+ *  O(N^2) time domain autocorrelation.
+ *
+ *  The autocorrelation is of the windowed frame, which the
+ *  window tapers towards long lags.  It is divided by the
+ *  window's own autocorrelation so a periodic signal scores
+ *  close to 1 at its period; that estimate degrades as the
+ *  lag approaches the window length, so lags are limited to
+ *  half of it (two periods per window at min_hz).
+**/
+
+/**
+ *  Among autocorrelation peaks, the shortest lag within this
+ *  ratio of the strongest wins, so a period is not mistaken
+ *  for a multiple of it
+**/
+#define PITCH_PEAK_RATIO        0.9
+
+/**
+ *  Default voicing thresholds on the clarity of each method.
+ *  White noise peaks near 0.1 in a 2048 point autocorrelation
+ *  and 0.14 in its cepstrum
+**/
+#define PITCH_AUTOCORR_THRESHOLD    0.5
+#define PITCH_CEPSTRUM_THRESHOLD    0.2
+
+/* Log power floor for the cepstrum, below the frame's loudest bin */
+#define PITCH_CEPSTRUM_FLOOR    1e-10
+
+typedef enum
+{
+    /** Normalised autocorrelation, clarity 0..1 **/
+    PITCH_AUTOCORR  = 0,
+    /** Real cepstrum, clarity is the peak in natural log units **/
+    PITCH_CEPSTRUM  = 1
+
+} pitch_method;
+
+typedef struct
+{
+    unsigned int frame;
+    /** Fundamental in Hz, 0 when no peak was found **/
+    float freq;
+    /** Height of the chosen peak **/
+    float clarity;
+    /** Clarity reached the threshold **/
+    int b_voiced;
+
+} pitch_estimate;
+
+typedef void (*pitch_sink)(const pitch_estimate *estimate, void *userData);
+
+typedef struct
+{
+    unsigned int samplerate;
+    unsigned int pcm_length;
+    unsigned int fft_length;
+    pitch_method method;
+
+    /** Lags searched, in samples **/
+    unsigned int min_lag;
+    unsigned int max_lag;
+    double threshold;
+
+    /** Spectrum handed to the inverse plan, and its lag domain output **/
+    fftw_complex *p_spec;
+    double *p_lag;
+    fftw_plan plan;
+
+    /**
+     * Circular autocorrelation of the window, 1 at lag 0,
+     * max_lag + 2 entries.  NULL until pitch_set_window
+    **/
+    double *p_window_acf;
+    unsigned int window_length;
+
+    unsigned int frame;
+
+    /**
+     * Optional consumer of every estimate produced
+    **/
+    pitch_sink sink;
+    void *sink_data;
+
+} pitch_tracker;
+
+/** ------------------------------------------
+ *  pitch_init
+ *  ------------------------------------------
+ *      Tracks fundamentals from min_hz to
+ *      max_hz in r2c spectra of pcm_length
+ *      samples.  threshold 0 picks the
+ *      method's default.  Plans with FFTW, so
+ *      not concurrently with other planning.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int pitch_init
+(
+    pitch_tracker *pt
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+    ,pitch_method method
+    ,double min_hz
+    ,double max_hz
+    ,double threshold
+);
+
+/** ------------------------------------------
+ *  pitch_close
+ *  ------------------------------------------
+ *      Frees memory owned by the tracker
+ *  ==========================================
+**/
+void pitch_close(pitch_tracker *pt);
+
+/** ----------------------------------------------------
+ *  pitch_set_window
+ *  ----------------------------------------------------
+ *      Describes the window the frames were taken
+ *      with: window_length coefficients at the start
+ *      of the pcm_length frame.  Shortens max_lag to
+ *      half the window.  Must be called before the
+ *      first frame, away from the audio thread.
+ *      Returns 0, or -1 if no lag is left to search
+ *  ====================================================
+**/
+int pitch_set_window(pitch_tracker *pt, const double *p_window, unsigned int window_length);
+
+/** ----------------------------------------------------
+ *  pitch_process
+ *  ----------------------------------------------------
+ *      Estimates the pitch of one complex spectrum of
+ *      fft_length bins, fills p_out and hands it to
+ *      the sink if one is set
+ *  ====================================================
+**/
+void pitch_process
+(
+    pitch_tracker *pt
+    ,const fftw_complex *in
+    ,pitch_estimate *p_out
+);
+
+#endif
@@ -0,0 +1,338 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "placement.h"
+
+#define PLACEMENT_SYSFS_NODES   "/sys/devices/system/node"
+
+/* Page size assumed where it cannot be asked for */
+#define PLACEMENT_PAGE_SIZE     4096
+
+static const char *policy_names[] = { "none", "compact", "spread" };
+
+/* ------------------------ Function Prototypes --------------------------- */
+static int nth_cpu(const placement_topology *topo, int node, unsigned int n);
+#ifdef __linux__
+static int parse_cpulist(const char *list, const cpu_set_t *allowed, placement_topology *topo, int node);
+#endif
+/* ------------------------------------------------------------------------ */
+
+
+int placement_parse_policy(const char *name, placement_policy *policy)
+{
+    unsigned int i;
+
+    for(i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); ++i)
+    {
+        if(strcmp(name, policy_names[i]) == 0)
+        {
+            *policy = (placement_policy) i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int placement_cpu
+(
+    const placement_topology *topo
+    ,placement_policy policy
+    ,unsigned int index
+    ,int node
+)
+{
+    unsigned int k, used = 0, round;
+    int order[PLACEMENT_MAX_NODES];
+
+    if(policy == PLACEMENT_NONE || !topo->num_cpus)
+    {
+        return -1;
+    }
+
+    if(node >= 0)
+    {
+        if((unsigned int) node >= topo->num_nodes || !topo->node_cpus[node])
+        {
+            return -1;
+        }
+        return nth_cpu(topo, node, index % topo->node_cpus[node]);
+    }
+
+    if(policy == PLACEMENT_COMPACT)
+    {
+        /* CPUs node by node, so consecutive workers share a node */
+        index %= topo->num_cpus;
+        for(k = 0; index >= topo->node_cpus[k]; ++k)
+        {
+            index -= topo->node_cpus[k];
+        }
+        return nth_cpu(topo, (int) k, index);
+    }
+
+    /* Spread: worker i to the (i mod nodes)th node that has CPUs */
+    for(k = 0; k < topo->num_nodes; ++k)
+    {
+        if(topo->node_cpus[k])
+        {
+            order[used++] = (int) k;
+        }
+    }
+    node = order[index % used];
+    round = index / used;
+
+    return nth_cpu(topo, node, round % topo->node_cpus[node]);
+}
+
+int placement_node_of(const placement_topology *topo, int cpu)
+{
+    if(cpu < 0 || cpu >= PLACEMENT_MAX_CPUS)
+    {
+        return -1;
+    }
+
+    return topo->node_of[cpu];
+}
+
+void placement_touch(void *p, size_t bytes)
+{
+    size_t i, page = PLACEMENT_PAGE_SIZE;
+    volatile char *p_byte = (volatile char *) p;
+
+#ifdef __linux__
+    long size = sysconf(_SC_PAGESIZE);
+
+    page = size > 0 ? (size_t) size : page;
+#endif
+
+    for(i = 0; i < bytes; i += page)
+    {
+        p_byte[i] = 0;
+    }
+    if(bytes)
+    {
+        p_byte[bytes - 1] = 0;
+    }
+}
+
+/* The nth allowed CPU of node, in ascending order */
+static int nth_cpu(const placement_topology *topo, int node, unsigned int n)
+{
+    int cpu;
+
+    for(cpu = 0; cpu < PLACEMENT_MAX_CPUS; ++cpu)
+    {
+        if(topo->node_of[cpu] == node && n-- == 0)
+        {
+            return cpu;
+        }
+    }
+
+    return -1;
+}
+
+#ifdef __linux__
+
+int placement_topology_read(placement_topology *topo)
+{
+    int node, cpu, found = 0;
+    char path[64];
+    char list[4096];
+    FILE *fp;
+    cpu_set_t allowed;
+
+    memset(topo, 0, sizeof(*topo));
+    memset(topo->node_of, -1, sizeof(topo->node_of));
+
+    if(sched_getaffinity(0, sizeof(allowed), &allowed))
+    {
+        return -1;
+    }
+
+    for(node = 0; node < PLACEMENT_MAX_NODES; ++node)
+    {
+        snprintf(path, sizeof(path), PLACEMENT_SYSFS_NODES "/node%d/cpulist", node);
+        fp = fopen(path, "r");
+        if(!fp)
+        {   /* Node numbers may have gaps; keep looking */
+            continue;
+        }
+        if(fgets(list, sizeof(list), fp))
+        {
+            found |= parse_cpulist(list, &allowed, topo, node) > 0;
+        }
+        fclose(fp);
+    }
+
+    if(!found)
+    {   /* No NUMA information: one node of every allowed CPU */
+        for(cpu = 0; cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; ++cpu)
+        {
+            if(CPU_ISSET(cpu, &allowed))
+            {
+                topo->node_of[cpu] = 0;
+                ++topo->node_cpus[0];
+                ++topo->num_cpus;
+                topo->num_nodes = 1;
+            }
+        }
+    }
+
+    return topo->num_cpus ? 0 : -1;
+}
+
+int placement_device_node(const char *sysfs_device)
+{
+    char path[512];
+    FILE *fp;
+    int node = -1;
+
+    snprintf(path, sizeof(path), "%s/numa_node", sysfs_device);
+    fp = fopen(path, "r");
+    if(!fp)
+    {
+        return -1;
+    }
+    if(fscanf(fp, "%d", &node) != 1 || node >= PLACEMENT_MAX_NODES)
+    {
+        node = -1;
+    }
+    fclose(fp);
+
+    return node;
+}
+
+int placement_pin_self(int cpu, placement_saved *p_saved)
+{
+    cpu_set_t set;
+
+    if(cpu < 0 || cpu >= PLACEMENT_MAX_CPUS || cpu >= CPU_SETSIZE)
+    {
+        return -1;
+    }
+
+    if(p_saved)
+    {
+        p_saved->b_valid = 0;
+        if(sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            memcpy(p_saved->mask, &set, sizeof(set) < sizeof(p_saved->mask) ? sizeof(set) : sizeof(p_saved->mask));
+            p_saved->b_valid = 1;
+        }
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return sched_setaffinity(0, sizeof(set), &set) ? -1 : 0;
+}
+
+void placement_restore_self(const placement_saved *p_saved)
+{
+    cpu_set_t set;
+
+    if(!p_saved || !p_saved->b_valid)
+    {
+        return;
+    }
+
+    CPU_ZERO(&set);
+    memcpy(&set, p_saved->mask, sizeof(set) < sizeof(p_saved->mask) ? sizeof(set) : sizeof(p_saved->mask));
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+/**
+ *  Marks the allowed CPUs of a "0-3,8-11" style list as
+ *  belonging to node.  Returns how many there were
+**/
+static int parse_cpulist(const char *list, const cpu_set_t *allowed, placement_topology *topo, int node)
+{
+    long first, last, cpu;
+    char *p_end;
+    int count = 0;
+
+    while(*list && *list != '\n')
+    {
+        first = strtol(list, &p_end, 10);
+        if(p_end == list || first < 0)
+        {
+            break;
+        }
+        last = first;
+        if(*p_end == '-')
+        {
+            list = p_end + 1;
+            last = strtol(list, &p_end, 10);
+            if(p_end == list)
+            {
+                break;
+            }
+        }
+
+        for(cpu = first; cpu <= last && cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; ++cpu)
+        {
+            if(CPU_ISSET(cpu, allowed) && topo->node_of[cpu] < 0)
+            {
+                topo->node_of[cpu] = (signed char) node;
+                ++topo->node_cpus[node];
+                ++topo->num_cpus;
+                ++count;
+            }
+        }
+
+        list = *p_end == ',' ? p_end + 1 : p_end;
+    }
+
+    if(count && (unsigned int) node + 1 > topo->num_nodes)
+    {
+        topo->num_nodes = (unsigned int) node + 1;
+    }
+
+    return count;
+}
+
+#else
+
+int placement_topology_read(placement_topology *topo)
+{
+    memset(topo, 0, sizeof(*topo));
+    memset(topo->node_of, -1, sizeof(topo->node_of));
+
+    /* Affinity cannot be set here, so one anonymous CPU is enough */
+    topo->node_of[0] = 0;
+    topo->node_cpus[0] = 1;
+    topo->num_cpus = 1;
+    topo->num_nodes = 1;
+
+    return 0;
+}
+
+int placement_device_node(const char *sysfs_device)
+{
+    (void) sysfs_device;
+    return -1;
+}
+
+int placement_pin_self(int cpu, placement_saved *p_saved)
+{
+    (void) cpu;
+    if(p_saved)
+    {
+        p_saved->b_valid = 0;
+    }
+    return -1;
+}
+
+void placement_restore_self(const placement_saved *p_saved)
+{
+    (void) p_saved;
+}
+
+#endif
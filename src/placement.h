@@ -0,0 +1,140 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+
+/**
+ *  NUMA node and core placement for worker threads.
+ *
+ *  The topology comes from /sys/devices/system/node: every
+ *  nodeN/cpulist names the CPUs of node N, limited to those
+ *  this process may run on.  Without that directory (no NUMA,
+ *  or not Linux) every allowed CPU is on node 0.
+ *
+ *  Memory is not bound explicitly.  Linux places a page on the
+ *  node of the thread that first writes it, so a thread pinned
+ *  with placement_pin_self before it allocates, touches and
+ *  plans gets an arena local to its CPU.  A controlling thread
+ *  can do the same on a worker's behalf, then restore its own
+ *  affinity.
+**/
+#define PLACEMENT_MAX_CPUS      1024
+#define PLACEMENT_MAX_NODES     64
+
+typedef enum
+{
+    /** Leave threads wherever the scheduler puts them **/
+    PLACEMENT_NONE      = 0,
+    /** Fill the CPUs of one node before moving to the next **/
+    PLACEMENT_COMPACT   = 1,
+    /** Deal workers out to the nodes in turn **/
+    PLACEMENT_SPREAD    = 2
+
+} placement_policy;
+
+typedef struct
+{
+    /** Highest node with an allowed CPU, plus one **/
+    unsigned int num_nodes;
+    unsigned int num_cpus;
+
+    /** Allowed CPUs per node **/
+    unsigned int node_cpus[PLACEMENT_MAX_NODES];
+
+    /** Node of every allowed CPU, -1 for the rest **/
+    signed char node_of[PLACEMENT_MAX_CPUS];
+
+} placement_topology;
+
+/** A thread's affinity, kept to be restored later **/
+typedef struct
+{
+    unsigned char mask[PLACEMENT_MAX_CPUS / 8];
+    int b_valid;
+
+} placement_saved;
+
+/** ------------------------------------------
+ *  placement_topology_read
+ *  ------------------------------------------
+ *      Returns 0 on success, -1 if no CPU
+ *      could be found
+ *  ==========================================
+**/
+int placement_topology_read(placement_topology *topo);
+
+/** ------------------------------------------
+ *  placement_parse_policy
+ *  ------------------------------------------
+ *      "none", "compact" or "spread".
+ *      Returns 0, or -1 for anything else
+ *  ==========================================
+**/
+int placement_parse_policy(const char *name, placement_policy *policy);
+
+/** ----------------------------------------------------
+ *  placement_cpu
+ *  ----------------------------------------------------
+ *      CPU for worker index under policy.  node >= 0
+ *      keeps the worker on that node, index counting
+ *      that node's workers only.  Returns the CPU, or
+ *      -1 for PLACEMENT_NONE or an unknown node
+ *  ====================================================
+**/
+int placement_cpu
+(
+    const placement_topology *topo
+    ,placement_policy policy
+    ,unsigned int index
+    ,int node
+);
+
+/** ----------------------------------------------------
+ *  placement_node_of
+ *  ----------------------------------------------------
+ *      Node a CPU belongs to, -1 if unknown
+ *  ====================================================
+**/
+int placement_node_of(const placement_topology *topo, int cpu);
+
+/** ----------------------------------------------------
+ *  placement_device_node
+ *  ----------------------------------------------------
+ *      Node of a device, from the numa_node file of
+ *      its sysfs directory (for example
+ *      /sys/class/sound/card0/device).  -1 if the
+ *      device has no node
+ *  ====================================================
+**/
+int placement_device_node(const char *sysfs_device);
+
+/** ----------------------------------------------------
+ *  placement_pin_self
+ *  ----------------------------------------------------
+ *      Restricts the calling thread to cpu, saving its
+ *      previous affinity in p_saved (may be NULL).
+ *      Returns 0 on success, -1 on failure
+ *  ====================================================
+**/
+int placement_pin_self(int cpu, placement_saved *p_saved);
+
+/** ----------------------------------------------------
+ *  placement_restore_self
+ *  ----------------------------------------------------
+ *      Gives the calling thread back the affinity
+ *      saved by placement_pin_self
+ *  ====================================================
+**/
+void placement_restore_self(const placement_saved *p_saved);
+
+/** ----------------------------------------------------
+ *  placement_touch
+ *  ----------------------------------------------------
+ *      Writes a zero to every page of a fresh buffer so
+ *      it is placed on the calling thread's node now
+ *      rather than wherever it is first used
+ *  ====================================================
+**/
+void placement_touch(void *p, size_t bytes);
+
+#endif
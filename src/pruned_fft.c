@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "pruned_fft.h"
+
+
+int pruned_fft_init
+(
+    pruned_fft *fft
+    ,unsigned int input_length
+    ,unsigned int pcm_length
+    ,unsigned int flags
+)
+{
+    unsigned int r, m;
+    int n;
+    size_t count;
+    double angle;
+    fftw_complex *p_row;
+
+    if(!fft || !input_length || pcm_length < input_length || pcm_length % input_length)
+    {
+        return -1;
+    }
+
+    memset(fft, 0, sizeof(*fft));
+    fft->input_length = input_length;
+    fft->pcm_length = pcm_length;
+    fft->factor = pcm_length / input_length;
+    fft->num_residues = fft->factor / 2 + 1;
+
+    count = (size_t) fft->num_residues * input_length;
+    fft->p_twiddle = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * count);
+    fft->p_work_in = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * count);
+    fft->p_work_out = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * count);
+
+    if(!fft->p_twiddle || !fft->p_work_in || !fft->p_work_out)
+    {
+        pruned_fft_close(fft);
+        return -1;
+    }
+
+    for(r = 0; r < fft->num_residues; ++r)
+    {
+        p_row = fft->p_twiddle + (size_t) r * input_length;
+        for(m = 0; m < input_length; ++m)
+        {
+            /* r * m can exceed 32 bits, reduce modulo N first */
+            angle = -2 * M_PI * (double) (((unsigned long long) r * m) % pcm_length) / pcm_length;
+            p_row[m][0] = cos(angle);
+            p_row[m][1] = sin(angle);
+        }
+    }
+
+    /* One contiguous row per residue */
+    n = (int) input_length;
+    fft->plan = fftw_plan_many_dft(1, &n, (int) fft->num_residues
+                                   ,fft->p_work_in, NULL, 1, n
+                                   ,fft->p_work_out, NULL, 1, n
+                                   ,FFTW_FORWARD, flags);
+
+    if(!fft->plan)
+    {
+        pruned_fft_close(fft);
+        return -1;
+    }
+
+    return 0;
+}
+
+void pruned_fft_close(pruned_fft *fft)
+{
+    if(!fft)
+    {
+        return;
+    }
+
+    if(fft->plan)
+    {
+        fftw_destroy_plan(fft->plan);
+    }
+    fftw_free(fft->p_twiddle);
+    fftw_free(fft->p_work_in);
+    fftw_free(fft->p_work_out);
+    memset(fft, 0, sizeof(*fft));
+}
+
+void pruned_fft_execute
+(
+    pruned_fft *fft
+    ,const double *in
+    ,fftw_complex *out
+)
+{
+    unsigned int r, q, k, m;
+    const unsigned int M = fft->input_length;
+    const unsigned int L = fft->factor;
+    const unsigned int half = fft->pcm_length / 2;
+    const fftw_complex *p_y, *p_w;
+    fftw_complex *p_x;
+
+    /* Twiddle the input once per residue */
+    for(r = 0; r < fft->num_residues; ++r)
+    {
+        p_w = fft->p_twiddle + (size_t) r * M;
+        p_x = fft->p_work_in + (size_t) r * M;
+        for(m = 0; m < M; ++m)
+        {
+            p_x[m][0] = in[m] * p_w[m][0];
+            p_x[m][1] = in[m] * p_w[m][1];
+        }
+    }
+
+    fftw_execute(fft->plan);
+
+    /**
+     *  Scatter: bin L q + r comes from row r, or for r > L / 2
+     *  from the conjugate of row L - r at q' = M - 1 - q, since
+     *  N - (L q + r) = L (M - 1 - q) + (L - r)
+    **/
+    for(q = 0, k = 0; k <= half; ++q)
+    {
+        for(r = 0; r < L && k <= half; ++r, ++k)
+        {
+            if(r < fft->num_residues)
+            {
+                p_y = fft->p_work_out + (size_t) r * M + q;
+                out[k][0] = (*p_y)[0];
+                out[k][1] = (*p_y)[1];
+            }
+            else
+            {
+                p_y = fft->p_work_out + (size_t) (L - r) * M + (M - 1 - q);
+                out[k][0] = (*p_y)[0];
+                out[k][1] = -(*p_y)[1];
+            }
+        }
+    }
+}
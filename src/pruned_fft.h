@@ -0,0 +1,86 @@
+#ifndef PRUNED_FFT_H
+#define PRUNED_FFT_H
+
+#include "fftw3.h"
+
+/**
+ *  Real FFT of M samples zero padded to N = L * M, computed
+ *  without touching the padding.
+ *
+ *  Writing k = L * q + r, only the M non zero inputs contribute:
+ *
+ *      X[L q + r] = sum_m ( x[m] W_N^(r m) ) W_M^(q m)
+ *
+ *  so each residue r is an M point DFT of the twiddled input,
+ *  and all of them run as one batched FFTW plan.  Because x is
+ *  real, residues above L / 2 are conjugates of lower ones and
+ *  are never computed.
+**/
+typedef struct
+{
+    unsigned int input_length;
+    unsigned int pcm_length;
+    unsigned int factor;
+    unsigned int num_residues;
+
+    /**
+     * W_N^(r m) for every computed residue r, num_residues
+     * rows of input_length values
+    **/
+    fftw_complex *p_twiddle;
+
+    /**
+     * Batched plan input (twiddled samples) and output,
+     * same shape as p_twiddle
+    **/
+    fftw_complex *p_work_in;
+    fftw_complex *p_work_out;
+
+    fftw_plan plan;
+
+} pruned_fft;
+
+/** ------------------------------------------
+ *  pruned_fft_init
+ *  ------------------------------------------
+ *      Plans a transform of input_length real
+ *      samples padded to pcm_length, which
+ *      must be a multiple of input_length.
+ *      flags are FFTW planner flags.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int pruned_fft_init
+(
+    pruned_fft *fft
+    ,unsigned int input_length
+    ,unsigned int pcm_length
+    ,unsigned int flags
+);
+
+/** ------------------------------------------
+ *  pruned_fft_close
+ *  ------------------------------------------
+ *      Destroys the plan and frees buffers
+ *  ==========================================
+**/
+void pruned_fft_close(pruned_fft *fft);
+
+/** ----------------------------------------------------
+ *  pruned_fft_execute
+ *  ----------------------------------------------------
+ *      Transforms input_length samples from in and
+ *      writes the pcm_length / 2 + 1 bins of the
+ *      padded transform to out, exactly as
+ *      fftw_plan_dft_r2c_1d(pcm_length) on the padded
+ *      input would
+ *  ====================================================
+**/
+void pruned_fft_execute
+(
+    pruned_fft *fft
+    ,const double *in
+    ,fftw_complex *out
+);
+
+#endif
@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "resampler.h"
+
+/* Dot products run in this many lanes; taps are padded to a multiple */
+#define RESAMPLER_LANES     8
+
+static const struct
+{
+    const char *name;
+    unsigned int taps;
+    double stopband_db;
+
+} presets[] =
+{
+    { "fast",   16,  60.0 },
+    { "medium", 32,  80.0 },
+    { "best",   64, 100.0 },
+};
+
+/* ------------------------ Function Prototypes --------------------------- */
+static unsigned int gcd(unsigned int a, unsigned int b);
+static double bessel_i0(double x);
+static void design_phases(resampler *rs, double beta);
+/* ------------------------------------------------------------------------ */
+
+
+int resampler_init
+(
+    resampler *rs
+    ,unsigned int in_rate
+    ,unsigned int out_rate
+    ,resampler_quality quality
+    ,unsigned long max_in
+)
+{
+    unsigned int g, taps;
+    double a;
+
+    if(!rs || !in_rate || !out_rate || !max_in
+       || (unsigned int) quality >= sizeof(presets) / sizeof(presets[0]))
+    {
+        return -1;
+    }
+
+    memset(rs, 0, sizeof(*rs));
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->quality = quality;
+    rs->max_in = max_in;
+
+    g = gcd(in_rate, out_rate);
+    rs->up = out_rate / g;
+    rs->down = in_rate / g;
+    if(rs->up > RESAMPLER_MAX_PHASES)
+    {
+        return -1;
+    }
+
+    /* Downsampling narrows the cutoff; widen the filter to match */
+    taps = presets[quality].taps;
+    if(rs->down > rs->up)
+    {
+        taps = (unsigned int) ceil((double) taps * rs->down / rs->up);
+    }
+    rs->taps = (taps + RESAMPLER_LANES - 1) / RESAMPLER_LANES * RESAMPLER_LANES;
+
+    rs->p_phases = (float *) malloc(sizeof(float) * rs->up * rs->taps);
+    rs->p_buffer = (float *) malloc(sizeof(float) * (rs->taps - 1 + max_in));
+    if(!rs->p_phases || !rs->p_buffer)
+    {
+        resampler_close(rs);
+        return -1;
+    }
+
+    /* Kaiser's beta for the stopband attenuation */
+    a = presets[quality].stopband_db;
+    design_phases(rs, 0.1102 * (a - 8.7));
+    resampler_reset(rs);
+
+    return 0;
+}
+
+void resampler_close(resampler *rs)
+{
+    if(!rs)
+    {
+        return;
+    }
+
+    free(rs->p_phases);
+    free(rs->p_buffer);
+    memset(rs, 0, sizeof(*rs));
+}
+
+void resampler_reset(resampler *rs)
+{
+    memset(rs->p_buffer, 0, sizeof(float) * (rs->taps - 1));
+    rs->fill = rs->taps - 1;
+    rs->pos = rs->taps - 1;
+    rs->phase = 0;
+}
+
+int resampler_parse_quality(const char *name, resampler_quality *quality)
+{
+    unsigned int i;
+
+    for(i = 0; i < sizeof(presets) / sizeof(presets[0]); ++i)
+    {
+        if(strcmp(name, presets[i].name) == 0)
+        {
+            *quality = (resampler_quality) i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+unsigned long resampler_max_out(const resampler *rs, unsigned long in_frames)
+{
+    return (unsigned long) (((unsigned long long) in_frames * rs->up + rs->down - 1) / rs->down) + 1;
+}
+
+unsigned long resampler_process
+(
+    resampler *rs
+    ,const float *input
+    ,unsigned long in_frames
+    ,float *output
+)
+{
+    unsigned long n = 0, keep;
+    unsigned int t, l;
+    const unsigned int taps = rs->taps;
+    const float *p_phase, *p_window;
+    float acc[RESAMPLER_LANES], sum;
+
+    memcpy(rs->p_buffer + rs->fill, input, sizeof(float) * in_frames);
+    rs->fill += in_frames;
+
+    while(rs->pos < rs->fill)
+    {
+        p_phase = rs->p_phases + (size_t) rs->phase * taps;
+        p_window = rs->p_buffer + rs->pos + 1 - taps;
+
+        /* Independent lanes: no reassociation needed to vectorize */
+        for(l = 0; l < RESAMPLER_LANES; ++l)
+        {
+            acc[l] = 0.0f;
+        }
+        for(t = 0; t < taps; t += RESAMPLER_LANES)
+        {
+            for(l = 0; l < RESAMPLER_LANES; ++l)
+            {
+                acc[l] += p_phase[l] * p_window[l];
+            }
+            p_phase += RESAMPLER_LANES;
+            p_window += RESAMPLER_LANES;
+        }
+        for(sum = 0.0f, l = 0; l < RESAMPLER_LANES; ++l)
+        {
+            sum += acc[l];
+        }
+        output[n++] = sum;
+
+        /* Step M upsampled samples: whole inputs and a new phase */
+        rs->phase += rs->down;
+        rs->pos += rs->phase / rs->up;
+        rs->phase %= rs->up;
+    }
+
+    /* Keep the taps - 1 samples the next output reaches back to */
+    keep = rs->pos + 1 - taps;
+    memmove(rs->p_buffer, rs->p_buffer + keep, sizeof(float) * (rs->fill - keep));
+    rs->fill -= keep;
+    rs->pos -= keep;
+
+    return n;
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+    unsigned int r;
+
+    while(b)
+    {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+
+    return a;
+}
+
+/* Modified Bessel function of the first kind, order 0, by its series */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0, q = x * x / 4.0;
+    unsigned int k;
+
+    for(k = 1; term > sum * 1e-12; ++k)
+    {
+        term *= q / ((double) k * k);
+        sum += term;
+    }
+
+    return sum;
+}
+
+/**
+ *  Prototype of L * taps coefficients at the upsampled rate,
+ *  cut off at the lower Nyquist rate, dealt out into the L
+ *  phases: phase p gets coefficients p, p + L, p + 2L ...
+ *  reversed, so they line up with the history oldest first.
+ *  Each phase is scaled to unity DC gain, which also restores
+ *  the factor L lost to zero stuffing
+**/
+static void design_phases(resampler *rs, double beta)
+{
+    unsigned int p, t, i;
+    const unsigned int n = rs->up * rs->taps;
+    const double centre = (n - 1) / 2.0;
+    const double fc = 0.5 / (rs->up > rs->down ? rs->up : rs->down);
+    const double norm = bessel_i0(beta);
+    double x, r, h, sum;
+    float *p_phase;
+
+    for(p = 0; p < rs->up; ++p)
+    {
+        p_phase = rs->p_phases + (size_t) p * rs->taps;
+        sum = 0.0;
+
+        for(t = 0; t < rs->taps; ++t)
+        {
+            i = p + rs->up * t;
+            x = i - centre;
+            r = 2.0 * i / (n - 1) - 1.0;
+
+            h = x == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * x) / (M_PI * x);
+            h *= bessel_i0(beta * sqrt(r * r < 1.0 ? 1.0 - r * r : 0.0)) / norm;
+
+            p_phase[rs->taps - 1 - t] = (float) h;
+            sum += h;
+        }
+
+        for(t = 0; t < rs->taps; ++t)
+        {
+            p_phase[t] = (float) (p_phase[t] / sum);
+        }
+    }
+
+    rs->delay = centre / rs->down;
+}
@@ -0,0 +1,142 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+/**
+ *  Polyphase sample rate converter for mono float streams.
+ *
+ *  The ratio out_rate / in_rate is reduced to L / M and
+ *  converted exactly: conceptually the input is zero stuffed
+ *  by L, low pass filtered and kept every M samples.  Only
+ *  the products that survive are computed, using one of L
+ *  sub filters (phases) per output sample.  The prototype
+ *  filter is a Kaiser windowed sinc cut off at the lower of the
+ *  two Nyquist rates, so whatever aliases folds back above the
+ *  alias free part of the band given for each preset.  Taps
+ *  are per phase when upsampling and grow with M / L when
+ *  downsampling, keeping the transition the same width.
+ *
+ *  Each output sample is a dot product of a phase with the
+ *  newest taps inputs, both contiguous and a multiple of 8
+ *  long, accumulated in 8 independent lanes so the compiler
+ *  emits packed multiply-adds.
+**/
+
+/**
+ *  Common rates reduce to a few hundred phases
+ *  (44.1k -> 48k is 160 / 147, 11.025k -> 48k is 640 / 147).
+ *  Ratios needing more are refused
+**/
+#define RESAMPLER_MAX_PHASES    1024
+
+typedef enum
+{
+    /** 16 taps, 60 dB stopband, alias free up to 77% of Nyquist **/
+    RESAMPLER_FAST      = 0,
+    /** 32 taps, 80 dB stopband, alias free up to 84% of Nyquist **/
+    RESAMPLER_MEDIUM    = 1,
+    /** 64 taps, 100 dB stopband, alias free up to 90% of Nyquist **/
+    RESAMPLER_BEST      = 2
+
+} resampler_quality;
+
+typedef struct
+{
+    unsigned int in_rate;
+    unsigned int out_rate;
+    resampler_quality quality;
+
+    /** Reduced ratio: L phases, M input steps per output **/
+    unsigned int up;
+    unsigned int down;
+
+    /**
+     * Taps per phase (a multiple of 8) and the phases,
+     * each stored oldest sample first
+    **/
+    unsigned int taps;
+    float *p_phases;
+
+    /**
+     * Input history: taps - 1 old samples followed by up
+     * to max_in new ones.  pos is the newest sample used
+     * by the next output and phase its sub filter
+    **/
+    float *p_buffer;
+    unsigned long fill;
+    unsigned long pos;
+    unsigned int phase;
+    unsigned long max_in;
+
+    /** Group delay in output samples **/
+    double delay;
+
+} resampler;
+
+/** ------------------------------------------
+ *  resampler_init
+ *  ------------------------------------------
+ *      Converts in_rate to out_rate, taking
+ *      at most max_in samples per call.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int resampler_init
+(
+    resampler *rs
+    ,unsigned int in_rate
+    ,unsigned int out_rate
+    ,resampler_quality quality
+    ,unsigned long max_in
+);
+
+/** ------------------------------------------
+ *  resampler_close
+ *  ------------------------------------------
+ *      Frees the filter and history
+ *  ==========================================
+**/
+void resampler_close(resampler *rs);
+
+/** ------------------------------------------
+ *  resampler_reset
+ *  ------------------------------------------
+ *      Clears the history
+ *  ==========================================
+**/
+void resampler_reset(resampler *rs);
+
+/** ------------------------------------------
+ *  resampler_parse_quality
+ *  ------------------------------------------
+ *      "fast", "medium" or "best".  Returns 0,
+ *      or -1 for anything else
+ *  ==========================================
+**/
+int resampler_parse_quality(const char *name, resampler_quality *quality);
+
+/** ----------------------------------------------------
+ *  resampler_max_out
+ *  ----------------------------------------------------
+ *      Most samples a call with in_frames samples can
+ *      produce, for sizing the output buffer
+ *  ====================================================
+**/
+unsigned long resampler_max_out(const resampler *rs, unsigned long in_frames);
+
+/** ----------------------------------------------------
+ *  resampler_process
+ *  ----------------------------------------------------
+ *      Consumes in_frames (<= max_in) samples and
+ *      writes every output they complete.  Returns
+ *      the number written
+ *  ====================================================
+**/
+unsigned long resampler_process
+(
+    resampler *rs
+    ,const float *input
+    ,unsigned long in_frames
+    ,float *output
+);
+
+#endif
@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "sdft_bank.h"
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void sdft_bank_update(sdft_bank *bank, double x);
+/* ------------------------------------------------------------------------ */
+
+
+int sdft_bank_init
+(
+    sdft_bank *bank
+    ,unsigned int samplerate
+    ,unsigned int window_length
+    ,const double *freqs
+    ,unsigned int num_bins
+)
+{
+    unsigned int i;
+    double w, r_n;
+
+    if(!bank || !freqs || !samplerate || !window_length || !num_bins)
+    {
+        return -1;
+    }
+
+    memset(bank, 0, sizeof(*bank));
+    bank->num_bins = num_bins;
+    bank->window_length = window_length;
+    bank->samplerate = samplerate;
+
+    /* One block for the seven per tracker arrays keeps them adjacent */
+    bank->p_re = (double *) malloc(sizeof(double) * num_bins * 7);
+    bank->p_delay = (double *) malloc(sizeof(double) * window_length);
+
+    if(!bank->p_re || !bank->p_delay)
+    {
+        sdft_bank_close(bank);
+        return -1;
+    }
+
+    bank->p_im = bank->p_re + num_bins;
+    bank->p_rot_re = bank->p_im + num_bins;
+    bank->p_rot_im = bank->p_rot_re + num_bins;
+    bank->p_out_re = bank->p_rot_im + num_bins;
+    bank->p_out_im = bank->p_out_re + num_bins;
+    bank->p_freqs = bank->p_out_im + num_bins;
+
+    /** ------------------------------------------------------
+     *  Each tracker keeps S(n) = sum x(n-m) r^m e^{jwm} over
+     *  the last N samples, updated recursively:
+     *      S(n) = r e^{jw} S(n-1) + x(n) - r^N e^{jwN} x(n-N)
+     *  The frequency need not fall on an FFT bin centre
+     *  ======================================================
+    **/
+    r_n = pow(SDFT_BANK_DAMPING, window_length);
+    for(i = 0; i < num_bins; ++i)
+    {
+        w = 2 * M_PI * freqs[i] / samplerate;
+        bank->p_freqs[i] = freqs[i];
+        bank->p_rot_re[i] = SDFT_BANK_DAMPING * cos(w);
+        bank->p_rot_im[i] = SDFT_BANK_DAMPING * sin(w);
+        bank->p_out_re[i] = r_n * cos(w * window_length);
+        bank->p_out_im[i] = r_n * sin(w * window_length);
+    }
+
+    sdft_bank_reset(bank);
+
+    return 0;
+}
+
+void sdft_bank_close(sdft_bank *bank)
+{
+    if(!bank)
+    {
+        return;
+    }
+
+    free(bank->p_re);
+    free(bank->p_delay);
+    memset(bank, 0, sizeof(*bank));
+}
+
+void sdft_bank_reset(sdft_bank *bank)
+{
+    memset(bank->p_re, 0, sizeof(double) * bank->num_bins);
+    memset(bank->p_im, 0, sizeof(double) * bank->num_bins);
+    memset(bank->p_delay, 0, sizeof(double) * bank->window_length);
+    bank->delay_pos = 0;
+}
+
+void sdft_bank_process
+(
+    sdft_bank *bank
+    ,const float *input
+    ,unsigned long framesPerBuffer
+    ,double *p_mag_out
+)
+{
+    unsigned long i;
+
+    for(i = 0; i < framesPerBuffer; ++i)
+    {
+        sdft_bank_update(bank, input[i]);
+
+        if(p_mag_out)
+        {
+            sdft_bank_magnitude(bank, p_mag_out);
+            p_mag_out += bank->num_bins;
+        }
+    }
+}
+
+void sdft_bank_magnitude(const sdft_bank *bank, double *p_mag)
+{
+    unsigned int i;
+    const double scale = 2.0 / bank->window_length;
+
+    for(i = 0; i < bank->num_bins; ++i)
+    {
+        p_mag[i] = scale * sqrt(bank->p_re[i] * bank->p_re[i]
+                                + bank->p_im[i] * bank->p_im[i]);
+    }
+}
+
+/**
+ *  Advance every tracker by one sample.  The loop body has no
+ *  dependency between trackers so it vectorizes across them
+**/
+static void sdft_bank_update
+(
+    sdft_bank *bank
+    ,double x
+)
+{
+    unsigned int i;
+    double x_old, re, im;
+    double * restrict p_re = bank->p_re;
+    double * restrict p_im = bank->p_im;
+    const double * restrict p_rot_re = bank->p_rot_re;
+    const double * restrict p_rot_im = bank->p_rot_im;
+    const double * restrict p_out_re = bank->p_out_re;
+    const double * restrict p_out_im = bank->p_out_im;
+
+    /* Swap the new sample into the delay line */
+    x_old = bank->p_delay[bank->delay_pos];
+    bank->p_delay[bank->delay_pos] = x;
+    if(++bank->delay_pos == bank->window_length)
+    {
+        bank->delay_pos = 0;
+    }
+
+    for(i = 0; i < bank->num_bins; ++i)
+    {
+        re = p_rot_re[i] * p_re[i] - p_rot_im[i] * p_im[i];
+        im = p_rot_im[i] * p_re[i] + p_rot_re[i] * p_im[i];
+        p_re[i] = re + x - p_out_re[i] * x_old;
+        p_im[i] = im - p_out_im[i] * x_old;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef SDFT_BANK_H
+#define SDFT_BANK_H
+
+/**
+ *  Damping factor applied to every tracker on each sample.
+ *  Keeps the recursion stable (rounding errors decay instead
+ *  of accumulating) at the cost of a negligible bias.
+**/
+#define SDFT_BANK_DAMPING   0.9999999
+
+typedef struct
+{
+    /**
+     * Running DFT value of every tracker.  Stored as
+     * separate real/imaginary arrays (one entry per
+     * tracked frequency) so the per sample update is a
+     * plain loop that the compiler vectorizes across
+     * trackers
+    **/
+    double *p_re;
+    double *p_im;
+
+    /**
+     * Per tracker rotation r * e^{jw} applied each sample
+    **/
+    double *p_rot_re;
+    double *p_rot_im;
+
+    /**
+     * Per tracker correction r^N * e^{jwN} applied to the
+     * sample leaving the window
+    **/
+    double *p_out_re;
+    double *p_out_im;
+
+    /**
+     * Frequencies being tracked in Hz
+    **/
+    double *p_freqs;
+
+    /**
+     * Last N input samples.  The oldest one is removed
+     * from every tracker when a new one arrives
+    **/
+    double *p_delay;
+    unsigned int delay_pos;
+
+    unsigned int num_bins;
+    unsigned int window_length;
+    unsigned int samplerate;
+
+} sdft_bank;
+
+/** ------------------------------------------
+ *  sdft_bank_init
+ *  ------------------------------------------
+ *      Configures a bank tracking num_bins
+ *      frequencies (in Hz) over a sliding
+ *      window of window_length samples.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int sdft_bank_init
+(
+    sdft_bank *bank
+    ,unsigned int samplerate
+    ,unsigned int window_length
+    ,const double *freqs
+    ,unsigned int num_bins
+);
+
+/** ------------------------------------------
+ *  sdft_bank_close
+ *  ------------------------------------------
+ *      Frees memory owned by the bank
+ *  ==========================================
+**/
+void sdft_bank_close(sdft_bank *bank);
+
+/** ------------------------------------------
+ *  sdft_bank_reset
+ *  ------------------------------------------
+ *      Clears tracker state and delay line
+ *  ==========================================
+**/
+void sdft_bank_reset(sdft_bank *bank);
+
+/** ----------------------------------------------------
+ *  sdft_bank_process
+ *  ----------------------------------------------------
+ *      Pushes framesPerBuffer samples through every
+ *      tracker.  Cost is O(num_bins) per sample.
+ *      If p_mag_out is not NULL it receives the
+ *      amplitude of every tracker after every sample
+ *      (framesPerBuffer rows of num_bins values)
+ *  ====================================================
+**/
+void sdft_bank_process
+(
+    sdft_bank *bank
+    ,const float *input
+    ,unsigned long framesPerBuffer
+    ,double *p_mag_out
+);
+
+/** ----------------------------------------------------
+ *  sdft_bank_magnitude
+ *  ----------------------------------------------------
+ *      Writes the current amplitude of every tracker
+ *      to p_mag (num_bins values).  A sine of
+ *      amplitude A at a tracked frequency reads as A
+ *  ====================================================
+**/
+void sdft_bank_magnitude(const sdft_bank *bank, double *p_mag);
+
+#endif
@@ -0,0 +1,797 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "spec_archive.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Chunks are padded so the next header and its timestamps stay aligned */
+#define CHUNK_ALIGN     8
+#define ALIGN_UP(x)     (((x) + CHUNK_ALIGN - 1) & ~(uint64_t) (CHUNK_ALIGN - 1))
+
+/* A 32 bit varint takes at most 5 bytes */
+#define VARINT_MAX      5
+
+enum
+{
+    SLOT_FREE   = 0,
+    SLOT_FULL   = 1
+};
+
+/* ------------------------ Function Prototypes --------------------------- */
+static char *index_path(const char *path);
+static void seal_chunk(spec_archive *arch);
+static void *writer_main(void *arg);
+static int write_chunk(spec_archive *arch, const spec_archive_slot *slot);
+static size_t encode_levels(const int32_t *p_levels, size_t count, unsigned int bins, unsigned char *p_out);
+static int decode_levels(const unsigned char *p, const unsigned char *end, size_t count, unsigned int bins, int32_t *p_levels);
+static const spec_archive_chunk_header *chunk_at(const spec_archive_reader *reader, uint64_t chunk);
+/* ------------------------------------------------------------------------ */
+
+
+int spec_archive_open
+(
+    spec_archive *arch
+    ,const char *path
+    ,unsigned int bins
+    ,unsigned int chunk_frames
+    ,double step_db
+    ,double floor_db
+)
+{
+    char *p_index_path;
+    struct stat st;
+    spec_archive_file_header header;
+    spec_archive_index_entry last;
+    spec_archive_slot *slot;
+    unsigned int i;
+
+    if(!arch || !path || !bins || !chunk_frames || !(step_db > 0.0))
+    {
+        return -1;
+    }
+
+    memset(arch, 0, sizeof(*arch));
+    arch->index_fd = -1;
+
+    p_index_path = index_path(path);
+    arch->data_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(p_index_path)
+    {
+        arch->index_fd = open(p_index_path, O_RDWR | O_CREAT, 0644);
+        free(p_index_path);
+    }
+    if(arch->data_fd < 0 || arch->index_fd < 0 || fstat(arch->data_fd, &st) < 0)
+    {
+        spec_archive_close(arch);
+        return -1;
+    }
+
+    if(st.st_size == 0)
+    {
+        /* New archive, which also resets any stale index */
+        memset(&header, 0, sizeof(header));
+        header.magic = SPEC_ARCHIVE_MAGIC;
+        header.version = SPEC_ARCHIVE_VERSION;
+        header.bins = bins;
+        header.chunk_frames = chunk_frames;
+        header.step_db = step_db;
+        header.floor_db = floor_db;
+
+        if(pwrite(arch->data_fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+           || ftruncate(arch->index_fd, 0) < 0)
+        {
+            spec_archive_close(arch);
+            return -1;
+        }
+    }
+    else if(pread(arch->data_fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+            || header.magic != SPEC_ARCHIVE_MAGIC || header.version != SPEC_ARCHIVE_VERSION
+            || header.bins != bins || !header.chunk_frames || !(header.step_db > 0.0))
+    {
+        spec_archive_close(arch);
+        return -1;
+    }
+
+    arch->bins = header.bins;
+    arch->chunk_frames = header.chunk_frames;
+    arch->step_db = header.step_db;
+    arch->floor_db = header.floor_db;
+    arch->data_bytes = sizeof(header);
+
+    /**
+     *  The index decides what exists: drop a torn index entry,
+     *  then anything in the data file past the last indexed chunk
+    **/
+    if(fstat(arch->index_fd, &st) < 0)
+    {
+        spec_archive_close(arch);
+        return -1;
+    }
+    arch->num_chunks = (uint64_t) st.st_size / sizeof(last);
+    if(arch->num_chunks)
+    {
+        if(pread(arch->index_fd, &last, sizeof(last), (off_t) ((arch->num_chunks - 1) * sizeof(last))) != (ssize_t) sizeof(last))
+        {
+            spec_archive_close(arch);
+            return -1;
+        }
+        arch->data_bytes = last.offset + last.bytes;
+        arch->last_ns = last.last_ns;
+    }
+    if(ftruncate(arch->index_fd, (off_t) (arch->num_chunks * sizeof(last))) < 0
+       || fstat(arch->data_fd, &st) < 0 || (uint64_t) st.st_size < arch->data_bytes
+       || ftruncate(arch->data_fd, (off_t) arch->data_bytes) < 0)
+    {
+        spec_archive_close(arch);
+        return -1;
+    }
+
+    arch->p_coded = (unsigned char *) malloc(sizeof(spec_archive_chunk_header) + sizeof(uint64_t) * arch->chunk_frames
+                                             + (size_t) VARINT_MAX * arch->bins * arch->chunk_frames + CHUNK_ALIGN);
+    arch->p_thread = malloc(sizeof(pthread_t));
+    if(!arch->p_coded || !arch->p_thread)
+    {
+        spec_archive_close(arch);
+        return -1;
+    }
+
+    /* Touched here so the audio thread never takes their page faults */
+    for(i = 0; i < SPEC_ARCHIVE_SLOTS; ++i)
+    {
+        slot = &arch->slots[i];
+        atomic_init(&slot->state, SLOT_FREE);
+        slot->p_levels = (int32_t *) malloc(sizeof(int32_t) * arch->bins * arch->chunk_frames);
+        slot->p_times = (uint64_t *) malloc(sizeof(uint64_t) * arch->chunk_frames);
+        if(!slot->p_levels || !slot->p_times)
+        {
+            spec_archive_close(arch);
+            return -1;
+        }
+        memset(slot->p_levels, 0, sizeof(int32_t) * arch->bins * arch->chunk_frames);
+        memset(slot->p_times, 0, sizeof(uint64_t) * arch->chunk_frames);
+    }
+
+    atomic_store(&arch->b_running, 1);
+    if(pthread_create((pthread_t *) arch->p_thread, NULL, writer_main, arch))
+    {
+        atomic_store(&arch->b_running, 0);
+        spec_archive_close(arch);
+        return -1;
+    }
+
+    return 0;
+}
+
+void spec_archive_close(spec_archive *arch)
+{
+    unsigned int i;
+
+    if(!arch)
+    {
+        return;
+    }
+
+    /* The writer makes one last pass after it is told to stop */
+    if(atomic_load(&arch->b_running))
+    {
+        spec_archive_flush(arch);
+        atomic_store(&arch->b_running, 0);
+        pthread_join(*(pthread_t *) arch->p_thread, NULL);
+    }
+
+    if(arch->data_fd >= 0)
+    {
+        close(arch->data_fd);
+    }
+    if(arch->index_fd >= 0)
+    {
+        close(arch->index_fd);
+    }
+
+    for(i = 0; i < SPEC_ARCHIVE_SLOTS; ++i)
+    {
+        free(arch->slots[i].p_levels);
+        free(arch->slots[i].p_times);
+    }
+    free(arch->p_coded);
+    free(arch->p_thread);
+    memset(arch, 0, sizeof(*arch));
+    arch->data_fd = -1;
+    arch->index_fd = -1;
+}
+
+uint64_t spec_archive_clock_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+int spec_archive_append(spec_archive *arch, uint64_t timestamp_ns, const double *p_db)
+{
+    unsigned int k;
+    double x;
+    const double inv = 1.0 / arch->step_db;
+    spec_archive_slot *slot = &arch->slots[arch->fill_slot];
+    int32_t *p_row;
+
+    /* Every slot is still waiting for the writer */
+    if(atomic_load_explicit(&slot->state, memory_order_acquire) != SLOT_FREE)
+    {
+        ++arch->frames_dropped;
+        return -1;
+    }
+    p_row = slot->p_levels + (size_t) slot->num_frames * arch->bins;
+
+    /* Clamp below the floor (and NaN) to it, and far above to what fits */
+    for(k = 0; k < arch->bins; ++k)
+    {
+        x = p_db[k] > arch->floor_db ? p_db[k] : arch->floor_db;
+        x = (x - arch->floor_db) * inv + 0.5;
+        p_row[k] = (int32_t) (x < 1e8 ? x : 1e8);
+    }
+
+    arch->last_ns = timestamp_ns > arch->last_ns ? timestamp_ns : arch->last_ns;
+    slot->p_times[slot->num_frames++] = arch->last_ns;
+    ++arch->frames_written;
+
+    if(slot->num_frames == arch->chunk_frames)
+    {
+        seal_chunk(arch);
+    }
+
+    return 0;
+}
+
+int spec_archive_flush(spec_archive *arch)
+{
+    /* A slot with frames in it is always the one being filled */
+    if(arch->slots[arch->fill_slot].num_frames)
+    {
+        seal_chunk(arch);
+    }
+
+    return 0;
+}
+
+/* Hands the slot being filled to the writer and moves to the next */
+static void seal_chunk(spec_archive *arch)
+{
+    atomic_store_explicit(&arch->slots[arch->fill_slot].state, SLOT_FULL, memory_order_release);
+    arch->fill_slot = (arch->fill_slot + 1) % SPEC_ARCHIVE_SLOTS;
+}
+
+/**
+ *  Writes full slots in the order they were sealed.  A failed
+ *  write keeps its slot and is retried on the next pass, so the
+ *  chunks in the file stay in order
+**/
+static void *writer_main(void *arg)
+{
+    spec_archive *arch = (spec_archive *) arg;
+    spec_archive_slot *slot;
+    int b_running, found;
+    struct timespec ts;
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = SPEC_ARCHIVE_POLL_MS * 1000000L;
+
+    do
+    {
+        /* Read before scanning, so a stop request still gets one full pass */
+        b_running = atomic_load(&arch->b_running);
+
+        found = 0;
+        slot = &arch->slots[arch->write_slot];
+        while(atomic_load_explicit(&slot->state, memory_order_acquire) == SLOT_FULL)
+        {
+            if(write_chunk(arch, slot) < 0)
+            {
+                atomic_fetch_add(&arch->write_errors, 1);
+                break;
+            }
+            slot->num_frames = 0;
+            atomic_store_explicit(&slot->state, SLOT_FREE, memory_order_release);
+
+            arch->write_slot = (arch->write_slot + 1) % SPEC_ARCHIVE_SLOTS;
+            slot = &arch->slots[arch->write_slot];
+            found = 1;
+        }
+
+        if(!found && b_running)
+        {
+            nanosleep(&ts, NULL);
+        }
+    }
+    while(b_running);
+
+    return NULL;
+}
+
+/**
+ *  Chunk first, index entry second: a crash in between leaves
+ *  an unindexed chunk that the next open truncates away
+**/
+static int write_chunk(spec_archive *arch, const spec_archive_slot *slot)
+{
+    spec_archive_chunk_header *p_header = (spec_archive_chunk_header *) arch->p_coded;
+    unsigned char *p_body = arch->p_coded + sizeof(*p_header) + sizeof(uint64_t) * slot->num_frames;
+    spec_archive_index_entry entry;
+    size_t coded, total;
+
+    coded = encode_levels(slot->p_levels, (size_t) slot->num_frames * arch->bins, arch->bins, p_body);
+    total = (size_t) ALIGN_UP(sizeof(*p_header) + sizeof(uint64_t) * slot->num_frames + coded);
+
+    p_header->magic = SPEC_ARCHIVE_CHUNK_MAGIC;
+    p_header->num_frames = slot->num_frames;
+    p_header->coded_bytes = (uint32_t) coded;
+    p_header->reserved = 0;
+    memcpy(p_header + 1, slot->p_times, sizeof(uint64_t) * slot->num_frames);
+    memset(p_body + coded, 0, total - (size_t) (p_body + coded - arch->p_coded));
+
+    entry.first_ns = slot->p_times[0];
+    entry.last_ns = slot->p_times[slot->num_frames - 1];
+    entry.offset = arch->data_bytes;
+    entry.bytes = (uint32_t) total;
+    entry.num_frames = slot->num_frames;
+
+    if(pwrite(arch->data_fd, arch->p_coded, total, (off_t) arch->data_bytes) != (ssize_t) total
+       || pwrite(arch->index_fd, &entry, sizeof(entry), (off_t) (arch->num_chunks * sizeof(entry))) != (ssize_t) sizeof(entry))
+    {
+        /* The next try rewrites the same place */
+        return -1;
+    }
+
+    arch->data_bytes += total;
+    ++arch->num_chunks;
+
+    return 0;
+}
+
+static char *index_path(const char *path)
+{
+    char *p = (char *) malloc(strlen(path) + sizeof(SPEC_ARCHIVE_INDEX_SUFFIX));
+
+    if(p)
+    {
+        strcpy(p, path);
+        strcat(p, SPEC_ARCHIVE_INDEX_SUFFIX);
+    }
+
+    return p;
+}
+
+/* ------------------------------- coding --------------------------------- */
+
+static size_t put_varint(unsigned char *p, uint32_t v)
+{
+    size_t n = 0;
+
+    while(v >= 0x80)
+    {
+        p[n++] = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char) v;
+
+    return n;
+}
+
+static int get_varint(const unsigned char **pp, const unsigned char *end, uint32_t *v)
+{
+    const unsigned char *p = *pp;
+    uint32_t result = 0;
+    unsigned int shift;
+
+    for(shift = 0; shift < 7 * VARINT_MAX && p < end; shift += 7)
+    {
+        result |= (uint32_t) (*p & 0x7f) << shift;
+        if(!(*p++ & 0x80))
+        {
+            *pp = p;
+            *v = result;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ *  Tokens are varints.  An odd token is one non zero
+ *  difference, zigzag(d) = (token >> 1) + 1; an even token is
+ *  a run of (token >> 1) + 1 zero differences
+**/
+static size_t encode_levels(const int32_t *p_levels, size_t count, unsigned int bins, unsigned char *p_out)
+{
+    size_t i, n = 0;
+    uint32_t run = 0, zz;
+    int32_t d;
+
+    for(i = 0; i < count; ++i)
+    {
+        d = p_levels[i] - (i >= bins ? p_levels[i - bins] : 0);
+        if(d == 0)
+        {
+            ++run;
+            continue;
+        }
+
+        if(run)
+        {
+            n += put_varint(p_out + n, (run - 1) << 1);
+            run = 0;
+        }
+        zz = ((uint32_t) d << 1) ^ (uint32_t) (d >> 31);
+        n += put_varint(p_out + n, ((zz - 1) << 1) | 1);
+    }
+
+    if(run)
+    {
+        n += put_varint(p_out + n, (run - 1) << 1);
+    }
+
+    return n;
+}
+
+static int decode_levels(const unsigned char *p, const unsigned char *end, size_t count, unsigned int bins, int32_t *p_levels)
+{
+    size_t i = 0, run;
+    uint32_t token, zz;
+
+    while(p < end)
+    {
+        if(get_varint(&p, end, &token) < 0)
+        {
+            return -1;
+        }
+
+        if(token & 1)
+        {
+            if(i == count)
+            {
+                return -1;
+            }
+            zz = (token >> 1) + 1;
+            p_levels[i] = (int32_t) ((uint32_t) (i >= bins ? p_levels[i - bins] : 0) + ((zz >> 1) ^ -(zz & 1)));
+            ++i;
+        }
+        else
+        {
+            run = (size_t) (token >> 1) + 1;
+            if(run > count - i)
+            {
+                return -1;
+            }
+            for(; run; --run, ++i)
+            {
+                p_levels[i] = i >= bins ? p_levels[i - bins] : 0;
+            }
+        }
+    }
+
+    return i == count ? 0 : -1;
+}
+
+/* ------------------------------- reader --------------------------------- */
+
+static const void *map_file(const char *path, size_t *p_bytes)
+{
+    int fd;
+    struct stat st;
+    void *p = NULL;
+
+    *p_bytes = 0;
+    fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return NULL;
+    }
+
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED)
+        {
+            p = NULL;
+        }
+        else
+        {
+            *p_bytes = (size_t) st.st_size;
+        }
+    }
+
+    /* The mapping outlives the descriptor */
+    close(fd);
+
+    return p;
+}
+
+int spec_archive_reader_open(spec_archive_reader *reader, const char *path)
+{
+    char *p_index_path;
+    const spec_archive_file_header *p_header;
+
+    if(!reader || !path)
+    {
+        return -1;
+    }
+
+    memset(reader, 0, sizeof(*reader));
+    reader->cached_chunk = -1;
+
+    reader->p_data = (const unsigned char *) map_file(path, &reader->data_bytes);
+    p_header = (const spec_archive_file_header *) reader->p_data;
+    if(!p_header || reader->data_bytes < sizeof(*p_header)
+       || p_header->magic != SPEC_ARCHIVE_MAGIC || p_header->version != SPEC_ARCHIVE_VERSION
+       || !p_header->bins || !p_header->chunk_frames)
+    {
+        spec_archive_reader_close(reader);
+        return -1;
+    }
+
+    reader->bins = p_header->bins;
+    reader->chunk_frames = p_header->chunk_frames;
+    reader->step_db = p_header->step_db;
+    reader->floor_db = p_header->floor_db;
+
+    /* An empty index is a valid archive with nothing in it yet */
+    p_index_path = index_path(path);
+    if(!p_index_path)
+    {
+        spec_archive_reader_close(reader);
+        return -1;
+    }
+    reader->p_index = (const spec_archive_index_entry *) map_file(p_index_path, &reader->index_bytes);
+    reader->num_chunks = reader->index_bytes / sizeof(spec_archive_index_entry);
+    free(p_index_path);
+
+    reader->p_levels = (int32_t *) malloc(sizeof(int32_t) * reader->bins * reader->chunk_frames);
+    if(!reader->p_levels)
+    {
+        spec_archive_reader_close(reader);
+        return -1;
+    }
+
+    return 0;
+}
+
+void spec_archive_reader_close(spec_archive_reader *reader)
+{
+    if(!reader)
+    {
+        return;
+    }
+
+    if(reader->p_data)
+    {
+        munmap((void *) reader->p_data, reader->data_bytes);
+    }
+    if(reader->p_index)
+    {
+        munmap((void *) reader->p_index, reader->index_bytes);
+    }
+    free(reader->p_levels);
+
+    memset(reader, 0, sizeof(*reader));
+}
+
+/* The chunk's header once its index entry and extent check out, else NULL */
+static const spec_archive_chunk_header *chunk_at(const spec_archive_reader *reader, uint64_t chunk)
+{
+    const spec_archive_index_entry *entry;
+    const spec_archive_chunk_header *p_header;
+
+    if(chunk >= reader->num_chunks)
+    {
+        return NULL;
+    }
+
+    entry = &reader->p_index[chunk];
+    if(entry->offset % CHUNK_ALIGN || entry->offset > reader->data_bytes
+       || entry->bytes > reader->data_bytes - entry->offset || entry->bytes < sizeof(*p_header))
+    {
+        return NULL;
+    }
+
+    p_header = (const spec_archive_chunk_header *) (reader->p_data + entry->offset);
+    if(p_header->magic != SPEC_ARCHIVE_CHUNK_MAGIC || p_header->num_frames != entry->num_frames
+       || !p_header->num_frames || p_header->num_frames > reader->chunk_frames
+       || sizeof(*p_header) + sizeof(uint64_t) * p_header->num_frames + p_header->coded_bytes > entry->bytes)
+    {
+        return NULL;
+    }
+
+    return p_header;
+}
+
+int spec_archive_reader_seek
+(
+    const spec_archive_reader *reader
+    ,uint64_t timestamp_ns
+    ,spec_archive_pos *pos
+)
+{
+    uint64_t lo = 0, hi = reader->num_chunks, mid;
+    unsigned int flo, fhi, fmid;
+    const spec_archive_chunk_header *p_header;
+    const uint64_t *p_times;
+
+    /* First chunk that ends at or after the timestamp... */
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(reader->p_index[mid].last_ns < timestamp_ns)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    p_header = chunk_at(reader, lo);
+    if(!p_header)
+    {
+        return -1;
+    }
+
+    /* ...and its first frame at or after it */
+    p_times = (const uint64_t *) (p_header + 1);
+    flo = 0;
+    fhi = p_header->num_frames - 1;
+    while(flo < fhi)
+    {
+        fmid = flo + (fhi - flo) / 2;
+        if(p_times[fmid] < timestamp_ns)
+        {
+            flo = fmid + 1;
+        }
+        else
+        {
+            fhi = fmid;
+        }
+    }
+
+    pos->chunk = lo;
+    pos->frame = flo;
+
+    return 0;
+}
+
+int spec_archive_reader_get
+(
+    spec_archive_reader *reader
+    ,const spec_archive_pos *pos
+    ,double *p_db
+    ,uint64_t *p_timestamp_ns
+)
+{
+    unsigned int k;
+    const int32_t *p_row;
+    const unsigned char *p_coded;
+    const spec_archive_chunk_header *p_header = chunk_at(reader, pos->chunk);
+
+    if(!p_header || pos->frame >= p_header->num_frames)
+    {
+        return -1;
+    }
+
+    if(reader->cached_chunk != (int64_t) pos->chunk)
+    {
+        reader->cached_chunk = -1;
+        p_coded = (const unsigned char *) (p_header + 1) + sizeof(uint64_t) * p_header->num_frames;
+        if(decode_levels(p_coded, p_coded + p_header->coded_bytes, (size_t) p_header->num_frames * reader->bins,
+                         reader->bins, reader->p_levels) < 0)
+        {
+            return -1;
+        }
+        reader->cached_chunk = (int64_t) pos->chunk;
+    }
+
+    if(p_db)
+    {
+        p_row = reader->p_levels + (size_t) pos->frame * reader->bins;
+        for(k = 0; k < reader->bins; ++k)
+        {
+            p_db[k] = reader->floor_db + p_row[k] * reader->step_db;
+        }
+    }
+    if(p_timestamp_ns)
+    {
+        *p_timestamp_ns = ((const uint64_t *) (p_header + 1))[pos->frame];
+    }
+
+    return 0;
+}
+
+int spec_archive_reader_next(const spec_archive_reader *reader, spec_archive_pos *pos)
+{
+    if(pos->chunk >= reader->num_chunks)
+    {
+        return -1;
+    }
+
+    if(pos->frame + 1 < reader->p_index[pos->chunk].num_frames)
+    {
+        ++pos->frame;
+        return 0;
+    }
+
+    if(pos->chunk + 1 >= reader->num_chunks)
+    {
+        return -1;
+    }
+
+    ++pos->chunk;
+    pos->frame = 0;
+
+    return 0;
+}
+
+#else /* _WIN32 */
+
+/* Needs POSIX file I/O and mmap */
+
+int spec_archive_open
+(
+    spec_archive *arch
+    ,const char *path
+    ,unsigned int bins
+    ,unsigned int chunk_frames
+    ,double step_db
+    ,double floor_db
+)
+{
+    (void) arch; (void) path; (void) bins; (void) chunk_frames; (void) step_db; (void) floor_db;
+    return -1;
+}
+
+void spec_archive_close(spec_archive *arch) { (void) arch; }
+uint64_t spec_archive_clock_ns(void) { return 0; }
+
+int spec_archive_append(spec_archive *arch, uint64_t timestamp_ns, const double *p_db)
+{
+    (void) arch; (void) timestamp_ns; (void) p_db;
+    return -1;
+}
+
+int spec_archive_flush(spec_archive *arch) { (void) arch; return -1; }
+
+int spec_archive_reader_open(spec_archive_reader *reader, const char *path)
+{
+    (void) reader; (void) path;
+    return -1;
+}
+
+void spec_archive_reader_close(spec_archive_reader *reader) { (void) reader; }
+
+int spec_archive_reader_seek(const spec_archive_reader *reader, uint64_t timestamp_ns, spec_archive_pos *pos)
+{
+    (void) reader; (void) timestamp_ns; (void) pos;
+    return -1;
+}
+
+int spec_archive_reader_get(spec_archive_reader *reader, const spec_archive_pos *pos, double *p_db, uint64_t *p_timestamp_ns)
+{
+    (void) reader; (void) pos; (void) p_db; (void) p_timestamp_ns;
+    return -1;
+}
+
+int spec_archive_reader_next(const spec_archive_reader *reader, spec_archive_pos *pos)
+{
+    (void) reader; (void) pos;
+    return -1;
+}
+
+#endif /* _WIN32 */
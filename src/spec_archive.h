@@ -0,0 +1,279 @@
+#ifndef SPEC_ARCHIVE_H
+#define SPEC_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ *  Spectrogram archive, version 1
+ *
+ *  An append-only pair of files for keeping weeks of spectra:
+ *
+ *      path        [ spec_archive_file_header ][ chunk ][ chunk ] ...
+ *      path.idx    [ spec_archive_index_entry ] ...
+ *
+ *  A chunk is a spec_archive_chunk_header, the num_frames
+ *  timestamps (uint64, ns) and the coded levels.  Each dB value
+ *  is stored as an integer level, (dB - floor_db) / step_db
+ *  rounded, and every bin is coded as the difference from the
+ *  same bin one frame earlier (zero for a chunk's first frame,
+ *  so chunks decode on their own).  Differences are zigzagged
+ *  and written as varints, with runs of zero differences
+ *  collapsed into a single count.  A steady spectrum at 0.1 dB
+ *  steps costs about a byte per bin, against 8 for a double.
+ *
+ *  The index has one entry per chunk and is written after the
+ *  chunk, so it only ever points at complete chunks.  Readers
+ *  map both files and binary search the index and then the
+ *  chunk's timestamps: a lookup decodes a single chunk.
+ *  All fields are in host byte order.
+**/
+#define SPEC_ARCHIVE_MAGIC          0x31414646u /* "FFA1" */
+#define SPEC_ARCHIVE_CHUNK_MAGIC    0x4b4e4843u /* "CHNK" */
+#define SPEC_ARCHIVE_VERSION        1
+
+#define SPEC_ARCHIVE_INDEX_SUFFIX   ".idx"
+
+/**
+ *  Chunks are filled in a ring of this many slots.  A full
+ *  slot is coded and written by the writer thread, which looks
+ *  for one every SPEC_ARCHIVE_POLL_MS; while the slot to fill
+ *  next is still waiting for it, frames are dropped and counted
+**/
+#define SPEC_ARCHIVE_SLOTS          4
+#define SPEC_ARCHIVE_POLL_MS        20
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t bins;
+    /** Most frames in a chunk **/
+    uint32_t chunk_frames;
+    double step_db;
+    double floor_db;
+
+} spec_archive_file_header;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t num_frames;
+    uint32_t coded_bytes;
+    uint32_t reserved;
+
+} spec_archive_chunk_header;
+
+typedef struct
+{
+    /** Timestamps of the chunk's first and last frames **/
+    uint64_t first_ns;
+    uint64_t last_ns;
+    /** Where the chunk header starts in the data file, and its total size **/
+    uint64_t offset;
+    uint32_t bytes;
+    uint32_t num_frames;
+
+} spec_archive_index_entry;
+
+/** Levels and timestamps of one chunk **/
+typedef struct
+{
+    int32_t *p_levels;
+    uint64_t *p_times;
+    unsigned int num_frames;
+    atomic_int state;
+
+} spec_archive_slot;
+
+/** Writer **/
+typedef struct
+{
+    int data_fd;
+    int index_fd;
+
+    unsigned int bins;
+    unsigned int chunk_frames;
+    double step_db;
+    double floor_db;
+
+    /** The slot being filled, and the next one to write **/
+    spec_archive_slot slots[SPEC_ARCHIVE_SLOTS];
+    unsigned int fill_slot;
+    unsigned int write_slot;
+
+    /** Room for the worst case chunk, used by the writer thread **/
+    unsigned char *p_coded;
+
+    /** End of the data file and number of chunks in the index, writer thread only **/
+    uint64_t data_bytes;
+    uint64_t num_chunks;
+
+    uint64_t last_ns;
+
+    void *p_thread;
+    atomic_int b_running;
+
+    unsigned long long frames_written;
+    unsigned long long frames_dropped;
+    atomic_ulong write_errors;
+
+} spec_archive;
+
+/** Reader **/
+typedef struct
+{
+    const unsigned char *p_data;
+    size_t data_bytes;
+    const spec_archive_index_entry *p_index;
+    size_t index_bytes;
+    uint64_t num_chunks;
+
+    unsigned int bins;
+    unsigned int chunk_frames;
+    double step_db;
+    double floor_db;
+
+    /** Levels of the most recently decoded chunk, -1 if none **/
+    int32_t *p_levels;
+    int64_t cached_chunk;
+
+} spec_archive_reader;
+
+/** A frame in an archive **/
+typedef struct
+{
+    uint64_t chunk;
+    unsigned int frame;
+
+} spec_archive_pos;
+
+/** ------------------------------------------
+ *  spec_archive_open
+ *  ------------------------------------------
+ *      Opens path for appending, creating it
+ *      with the given parameters if needed,
+ *      and starts the writer thread.  An
+ *      existing archive keeps its own step
+ *      and floor but must have the same number
+ *      of bins; a chunk left without an index
+ *      entry by a crash is discarded.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int spec_archive_open
+(
+    spec_archive *arch
+    ,const char *path
+    ,unsigned int bins
+    ,unsigned int chunk_frames
+    ,double step_db
+    ,double floor_db
+);
+
+/** ------------------------------------------
+ *  spec_archive_close
+ *  ------------------------------------------
+ *      Queues the partial chunk, waits for the
+ *      writer thread to finish and closes
+ *  ==========================================
+**/
+void spec_archive_close(spec_archive *arch);
+
+/** ------------------------------------------
+ *  spec_archive_clock_ns
+ *  ------------------------------------------
+ *      Wall clock time in ns since the epoch,
+ *      the usual timestamp for a frame
+ *  ==========================================
+**/
+uint64_t spec_archive_clock_ns(void);
+
+/** ----------------------------------------------------
+ *  spec_archive_append
+ *  ----------------------------------------------------
+ *      Adds one frame of bins dB values.  Timestamps
+ *      must not go backwards; an earlier one (a clock
+ *      step) is raised to the previous frame's.  A
+ *      chunk is queued for the writer thread every
+ *      chunk_frames frames; nothing here touches the
+ *      files.  Returns 0, or -1 if the frame was
+ *      dropped because no slot was free
+ *  ====================================================
+**/
+int spec_archive_append(spec_archive *arch, uint64_t timestamp_ns, const double *p_db);
+
+/** ----------------------------------------------------
+ *  spec_archive_flush
+ *  ----------------------------------------------------
+ *      Queues the frames appended so far as a (short)
+ *      chunk, so readers see them once the writer
+ *      thread has written it
+ *  ====================================================
+**/
+int spec_archive_flush(spec_archive *arch);
+
+/** ------------------------------------------
+ *  spec_archive_reader_open
+ *  ------------------------------------------
+ *      Maps the archive at path read only.  It
+ *      sees the chunks indexed at the time of
+ *      the call.  Returns 0 on success, -1 on
+ *      failure
+ *  ==========================================
+**/
+int spec_archive_reader_open(spec_archive_reader *reader, const char *path);
+
+/** ------------------------------------------
+ *  spec_archive_reader_close
+ *  ------------------------------------------
+ *      Unmaps everything
+ *  ==========================================
+**/
+void spec_archive_reader_close(spec_archive_reader *reader);
+
+/** ----------------------------------------------------
+ *  spec_archive_reader_seek
+ *  ----------------------------------------------------
+ *      Finds the first frame at or after timestamp_ns
+ *      in O(log n).  Returns 0, or -1 if every frame
+ *      is older
+ *  ====================================================
+**/
+int spec_archive_reader_seek
+(
+    const spec_archive_reader *reader
+    ,uint64_t timestamp_ns
+    ,spec_archive_pos *pos
+);
+
+/** ----------------------------------------------------
+ *  spec_archive_reader_get
+ *  ----------------------------------------------------
+ *      Decodes the frame at pos into bins dB values
+ *      and its timestamp (either may be NULL).  Frames
+ *      of the same chunk are served from the last
+ *      decode.  Returns 0, or -1 if pos is out of
+ *      range or the chunk is corrupt
+ *  ====================================================
+**/
+int spec_archive_reader_get
+(
+    spec_archive_reader *reader
+    ,const spec_archive_pos *pos
+    ,double *p_db
+    ,uint64_t *p_timestamp_ns
+);
+
+/** ----------------------------------------------------
+ *  spec_archive_reader_next
+ *  ----------------------------------------------------
+ *      Moves pos to the following frame for replays.
+ *      Returns 0, or -1 past the last frame
+ *  ====================================================
+**/
+int spec_archive_reader_next(const spec_archive_reader *reader, spec_archive_pos *pos);
+
+#endif
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spec_quant.h"
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void *history_row(const spec_history *hist, unsigned int row);
+/* ------------------------------------------------------------------------ */
+
+
+void spec_quant_encode
+(
+    const double *p_db
+    ,unsigned int bins
+    ,double floor_db
+    ,spec_quant_width width
+    ,void *p_codes
+    ,spec_quant_params *p_params
+)
+{
+    unsigned int k;
+    double lo, hi, x, inv;
+    const double top = width == SPEC_QUANT_U8 ? 255.0 : 65535.0;
+    uint8_t * restrict p_u8 = (uint8_t *) p_codes;
+    uint16_t * restrict p_u16 = (uint16_t *) p_codes;
+
+    /* Range of the clamped frame, branch free */
+    lo = HUGE_VAL;
+    hi = floor_db;
+    for(k = 0; k < bins; ++k)
+    {
+        x = p_db[k] > floor_db ? p_db[k] : floor_db;
+        lo = x < lo ? x : lo;
+        hi = x > hi ? x : hi;
+    }
+    lo = bins ? lo : floor_db;
+
+    /* A flat frame still needs a non zero scale */
+    p_params->offset = (float) lo;
+    p_params->scale = (float) (hi > lo ? (hi - lo) / top : 1.0);
+    inv = 1.0 / p_params->scale;
+
+    /* Round to nearest; clamping covers float rounding at the top */
+    if(width == SPEC_QUANT_U8)
+    {
+        for(k = 0; k < bins; ++k)
+        {
+            x = p_db[k] > lo ? p_db[k] : lo;
+            x = (x - lo) * inv + 0.5;
+            p_u8[k] = (uint8_t) (x < top ? x : top);
+        }
+    }
+    else
+    {
+        for(k = 0; k < bins; ++k)
+        {
+            x = p_db[k] > lo ? p_db[k] : lo;
+            x = (x - lo) * inv + 0.5;
+            p_u16[k] = (uint16_t) (x < top ? x : top);
+        }
+    }
+}
+
+void spec_quant_decode
+(
+    const void *p_codes
+    ,unsigned int bins
+    ,spec_quant_width width
+    ,const spec_quant_params *p_params
+    ,double *p_db
+)
+{
+    unsigned int k;
+    const double offset = p_params->offset;
+    const double scale = p_params->scale;
+    const uint8_t * restrict p_u8 = (const uint8_t *) p_codes;
+    const uint16_t * restrict p_u16 = (const uint16_t *) p_codes;
+
+    if(width == SPEC_QUANT_U8)
+    {
+        for(k = 0; k < bins; ++k)
+        {
+            p_db[k] = offset + p_u8[k] * scale;
+        }
+    }
+    else
+    {
+        for(k = 0; k < bins; ++k)
+        {
+            p_db[k] = offset + p_u16[k] * scale;
+        }
+    }
+}
+
+int spec_history_init
+(
+    spec_history *hist
+    ,unsigned int bins
+    ,unsigned int num_frames
+    ,spec_quant_width width
+    ,double floor_db
+)
+{
+    if(!hist || !bins || !num_frames || (width != SPEC_QUANT_U8 && width != SPEC_QUANT_U16))
+    {
+        return -1;
+    }
+
+    memset(hist, 0, sizeof(*hist));
+    hist->width = width;
+    hist->bins = bins;
+    hist->num_frames = num_frames;
+    hist->floor_db = floor_db;
+
+    hist->p_codes = malloc((size_t) bins * num_frames * width);
+    hist->p_params = (spec_quant_params *) malloc(sizeof(spec_quant_params) * num_frames);
+    if(!hist->p_codes || !hist->p_params)
+    {
+        spec_history_close(hist);
+        return -1;
+    }
+
+    return 0;
+}
+
+void spec_history_close(spec_history *hist)
+{
+    if(!hist)
+    {
+        return;
+    }
+
+    free(hist->p_codes);
+    free(hist->p_params);
+    memset(hist, 0, sizeof(*hist));
+}
+
+void spec_history_push(spec_history *hist, const double *p_db)
+{
+    spec_quant_encode(p_db, hist->bins, hist->floor_db, hist->width
+                      ,history_row(hist, hist->head), &hist->p_params[hist->head]);
+
+    hist->head = hist->head + 1 < hist->num_frames ? hist->head + 1 : 0;
+    if(hist->count < hist->num_frames)
+    {
+        ++hist->count;
+    }
+}
+
+int spec_history_get(const spec_history *hist, unsigned int age, double *p_db)
+{
+    unsigned int row;
+
+    if(age >= hist->count)
+    {
+        return -1;
+    }
+
+    row = hist->head > age ? hist->head - 1 - age : hist->head + hist->num_frames - 1 - age;
+    spec_quant_decode(history_row(hist, row), hist->bins, hist->width, &hist->p_params[row], p_db);
+
+    return 0;
+}
+
+static void *history_row(const spec_history *hist, unsigned int row)
+{
+    return (unsigned char *) hist->p_codes + (size_t) row * hist->bins * hist->width;
+}
@@ -0,0 +1,137 @@
+#ifndef SPEC_QUANT_H
+#define SPEC_QUANT_H
+
+#include <stdint.h>
+
+/**
+ *  dB spectra packed into 8 or 16 bit codes.
+ *
+ *  Every frame gets its own offset (its lowest level, after
+ *  clamping to floor_db) and scale (its range over the number
+ *  of codes), so
+ *
+ *      dB = offset + code * scale
+ *
+ *  and the error is at most scale / 2: 0.2 dB for a 100 dB
+ *  range in u8, under 0.001 dB in u16.  Both passes are flat
+ *  loops over the bins with no data dependent branches; the
+ *  encoding pass vectorizes in a Release build.
+**/
+
+/** Default clamp for silent bins, below any real signal **/
+#define SPEC_QUANT_FLOOR_DB     -160.0
+
+typedef enum
+{
+    SPEC_QUANT_U8   = 1,
+    SPEC_QUANT_U16  = 2
+
+} spec_quant_width;
+
+/** Per frame parameters, stored or sent ahead of the codes **/
+typedef struct
+{
+    float offset;
+    float scale;
+
+} spec_quant_params;
+
+/**
+ *  Quantized spectrogram history: num_frames rows of bins codes
+ *  in a ring, with their parameters.  At u8 a row takes 1/8 of
+ *  the double magnitudes it was made from
+**/
+typedef struct
+{
+    spec_quant_width width;
+    unsigned int bins;
+    unsigned int num_frames;
+    double floor_db;
+
+    void *p_codes;
+    spec_quant_params *p_params;
+
+    /** Row the next push goes to, and rows filled so far **/
+    unsigned int head;
+    unsigned int count;
+
+} spec_history;
+
+/** ----------------------------------------------------
+ *  spec_quant_encode
+ *  ----------------------------------------------------
+ *      Quantizes bins dB values to width codes at
+ *      p_codes (uint8_t or uint16_t).  Values below
+ *      floor_db, including -inf, are clamped to it
+ *  ====================================================
+**/
+void spec_quant_encode
+(
+    const double *p_db
+    ,unsigned int bins
+    ,double floor_db
+    ,spec_quant_width width
+    ,void *p_codes
+    ,spec_quant_params *p_params
+);
+
+/** ----------------------------------------------------
+ *  spec_quant_decode
+ *  ----------------------------------------------------
+ *      Back to dB
+ *  ====================================================
+**/
+void spec_quant_decode
+(
+    const void *p_codes
+    ,unsigned int bins
+    ,spec_quant_width width
+    ,const spec_quant_params *p_params
+    ,double *p_db
+);
+
+/** ------------------------------------------
+ *  spec_history_init
+ *  ------------------------------------------
+ *      Room for num_frames spectra of bins
+ *      bins.  Returns 0 on success, -1 on
+ *      failure
+ *  ==========================================
+**/
+int spec_history_init
+(
+    spec_history *hist
+    ,unsigned int bins
+    ,unsigned int num_frames
+    ,spec_quant_width width
+    ,double floor_db
+);
+
+/** ------------------------------------------
+ *  spec_history_close
+ *  ------------------------------------------
+ *      Frees the ring
+ *  ==========================================
+**/
+void spec_history_close(spec_history *hist);
+
+/** ----------------------------------------------------
+ *  spec_history_push
+ *  ----------------------------------------------------
+ *      Quantizes one spectrum into the ring,
+ *      overwriting the oldest once full
+ *  ====================================================
+**/
+void spec_history_push(spec_history *hist, const double *p_db);
+
+/** ----------------------------------------------------
+ *  spec_history_get
+ *  ----------------------------------------------------
+ *      Decodes the spectrum age frames back (0 is the
+ *      newest) into p_db.  Returns 0, or -1 if the
+ *      ring does not go back that far
+ *  ====================================================
+**/
+int spec_history_get(const spec_history *hist, unsigned int age, double *p_db);
+
+#endif
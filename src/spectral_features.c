@@ -0,0 +1,343 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spectral_features.h"
+
+/* Added to every bin before taking logs so silence stays finite */
+#define SPECTRAL_FEATURES_FLOOR     1e-20
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void insert_peak(spectral_features_ctx *ctx, spectral_features *out,
+                        unsigned int bin, const double *p_power);
+/* ------------------------------------------------------------------------ */
+
+
+int spectral_features_init
+(
+    spectral_features_ctx *ctx
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+    ,unsigned int num_peaks
+    ,const double *band_edges
+    ,unsigned int num_bands
+)
+{
+    unsigned int i, bin, num_chunks;
+
+    if(!ctx || !samplerate || pcm_length < 4
+       || num_peaks > SPECTRAL_FEATURES_MAX_PEAKS
+       || num_bands > SPECTRAL_FEATURES_MAX_BANDS
+       || (num_bands && !band_edges))
+    {
+        return -1;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->pcm_length = pcm_length;
+    ctx->fft_length = pcm_length / 2 + 1;
+    ctx->bin_width = (double) samplerate / pcm_length;
+    ctx->num_peaks = num_peaks;
+    ctx->rolloff_fraction = 0.85;
+    /* Mean of the squared Hann window is 3/8 */
+    ctx->window_energy = 0.375 * pcm_length;
+    ctx->num_bands = num_bands;
+
+    /* Convert band edges to bins, clamped to the spectrum */
+    for(i = 0; num_bands && i <= num_bands; ++i)
+    {
+        bin = (unsigned int) (band_edges[i] / ctx->bin_width + 0.5);
+        if(bin > ctx->fft_length)
+        {
+            bin = ctx->fft_length;
+        }
+        if(i && bin < ctx->band_edges[i - 1])
+        {   /* Edges must be ascending */
+            return -1;
+        }
+        ctx->band_edges[i] = bin;
+    }
+
+    num_chunks = (ctx->fft_length + SPECTRAL_FEATURES_CHUNK - 1) / SPECTRAL_FEATURES_CHUNK;
+    ctx->p_power = (double *) malloc(sizeof(double) * ctx->fft_length);
+    ctx->p_bin = (double *) malloc(sizeof(double) * ctx->fft_length);
+    ctx->p_chunk_power = (double *) malloc(sizeof(double) * num_chunks);
+
+    if(!ctx->p_power || !ctx->p_bin || !ctx->p_chunk_power)
+    {
+        spectral_features_close(ctx);
+        return -1;
+    }
+
+    for(bin = 0; bin < ctx->fft_length; ++bin)
+    {
+        ctx->p_bin[bin] = bin;
+    }
+
+    return 0;
+}
+
+int spectral_features_set_window
+(
+    spectral_features_ctx *ctx
+    ,const double *p_window
+    ,unsigned int window_length
+)
+{
+    unsigned int i;
+    double energy = 0.0;
+
+    if(!p_window || !window_length || window_length > ctx->pcm_length)
+    {
+        return -1;
+    }
+
+    for(i = 0; i < window_length; ++i)
+    {
+        energy += p_window[i] * p_window[i];
+    }
+    if(energy <= 0.0)
+    {
+        return -1;
+    }
+
+    ctx->window_energy = energy;
+    return 0;
+}
+
+void spectral_features_close(spectral_features_ctx *ctx)
+{
+    if(!ctx)
+    {
+        return;
+    }
+
+    free(ctx->p_power);
+    free(ctx->p_bin);
+    free(ctx->p_chunk_power);
+    ctx->p_power = NULL;
+    ctx->p_bin = NULL;
+    ctx->p_chunk_power = NULL;
+}
+
+/**
+ *  Everything is derived from the power spectrum |X|^2 in one
+ *  walk over the FFT output.  Each chunk is converted to power,
+ *  summed, then scanned for peaks and band energy while still
+ *  in cache.
+ *
+ *  The sums are branch free and kept per lane, and the bin
+ *  index comes from a table rather than a conversion, so each
+ *  pass is plain loads, multiplies and adds.  Flatness takes
+ *  one log per SPECTRAL_FEATURES_GROUP bins and lane, of their
+ *  product; with the floor added a bin lies within about 1e-20
+ *  to 1e38, so the product stays in double range.
+**/
+void spectral_features_process
+(
+    spectral_features_ctx *ctx
+    ,const fftw_complex *in
+    ,spectral_features *p_out
+)
+{
+    unsigned int start, end, k, g, l, c, band, lo, hi, scan;
+    double total = 0.0, weighted = 0.0, log_sum = 0.0;
+    double chunk_sum, target, acc, full;
+    double lane_sum[SPECTRAL_FEATURES_LANES];
+    double lane_weighted[SPECTRAL_FEATURES_LANES];
+    double lane_product[SPECTRAL_FEATURES_LANES];
+    double * restrict p_power = ctx->p_power;
+    const double * restrict p_bin = ctx->p_bin;
+    const unsigned int n = ctx->fft_length;
+    const unsigned int stride = SPECTRAL_FEATURES_LANES * SPECTRAL_FEATURES_GROUP;
+
+    memset(p_out, 0, sizeof(*p_out));
+    p_out->frame = ctx->frame++;
+    p_out->num_bands = ctx->num_bands;
+
+    for(start = 0, c = 0; start < n; start += SPECTRAL_FEATURES_CHUNK, ++c)
+    {
+        end = start + SPECTRAL_FEATURES_CHUNK < n ? start + SPECTRAL_FEATURES_CHUNK : n;
+
+        /* Power of every bin in the chunk */
+        for(k = start; k < end; ++k)
+        {
+            p_power[k] = in[k][0] * in[k][0] + in[k][1] * in[k][1];
+        }
+
+        /* Linear sums, kept per lane */
+        for(l = 0; l < SPECTRAL_FEATURES_LANES; ++l)
+        {
+            lane_sum[l] = lane_weighted[l] = 0.0;
+        }
+        for(k = start; k + SPECTRAL_FEATURES_LANES <= end; k += SPECTRAL_FEATURES_LANES)
+        {
+            for(l = 0; l < SPECTRAL_FEATURES_LANES; ++l)
+            {
+                lane_sum[l] += p_power[k + l];
+                lane_weighted[l] += p_bin[k + l] * p_power[k + l];
+            }
+        }
+        for(; k < end; ++k)
+        {
+            lane_sum[0] += p_power[k];
+            lane_weighted[0] += p_bin[k] * p_power[k];
+        }
+
+        /* Log sum for flatness, one log per group of bins and lane */
+        for(k = start; k + stride <= end; k += stride)
+        {
+            for(l = 0; l < SPECTRAL_FEATURES_LANES; ++l)
+            {
+                lane_product[l] = 1.0;
+            }
+            for(g = k; g < k + stride; g += SPECTRAL_FEATURES_LANES)
+            {
+                for(l = 0; l < SPECTRAL_FEATURES_LANES; ++l)
+                {
+                    lane_product[l] *= p_power[g + l] + SPECTRAL_FEATURES_FLOOR;
+                }
+            }
+            for(l = 0; l < SPECTRAL_FEATURES_LANES; ++l)
+            {
+                log_sum += log(lane_product[l]);
+            }
+        }
+        for(; k < end; ++k)
+        {
+            log_sum += log(p_power[k] + SPECTRAL_FEATURES_FLOOR);
+        }
+
+        chunk_sum = 0.0;
+        for(l = 0; l < SPECTRAL_FEATURES_LANES; ++l)
+        {
+            chunk_sum += lane_sum[l];
+            weighted += lane_weighted[l];
+        }
+        ctx->p_chunk_power[c] = chunk_sum;
+        total += chunk_sum;
+
+        /**
+         *  Peak scan lags one bin behind so the right neighbour
+         *  of every candidate is already computed
+        **/
+        scan = start ? start - 1 : 1;
+        for(k = scan; ctx->num_peaks && k + 1 < end; ++k)
+        {
+            if(p_power[k] > p_power[k - 1] && p_power[k] >= p_power[k + 1])
+            {
+                insert_peak(ctx, p_out, k, p_power);
+            }
+        }
+
+        /* Accumulate the part of every band that falls in this chunk */
+        for(band = 0; band < ctx->num_bands; ++band)
+        {
+            lo = ctx->band_edges[band] > start ? ctx->band_edges[band] : start;
+            hi = ctx->band_edges[band + 1] < end ? ctx->band_edges[band + 1] : end;
+            for(k = lo; k < hi; ++k)
+            {
+                p_out->band_energy[band] += (float) p_power[k];
+            }
+        }
+    }
+
+    for(band = 0; band < ctx->num_bands; ++band)
+    {
+        p_out->band_energy[band] = (float) (10.0 * log10(p_out->band_energy[band]
+                                                         + SPECTRAL_FEATURES_FLOOR));
+    }
+
+    p_out->centroid = (float) (total > 0.0 ? ctx->bin_width * weighted / total : 0.0);
+    p_out->flatness = (float) (total > 0.0 ? exp(log_sum / n) / (total / n) : 0.0);
+
+    /**
+     *  Rolloff: walk the per chunk sums to the chunk where the
+     *  cumulative power crosses the target, then rescan only it
+    **/
+    target = ctx->rolloff_fraction * total;
+    acc = 0.0;
+    for(c = 0; acc + ctx->p_chunk_power[c] < target
+               && (c + 1) * SPECTRAL_FEATURES_CHUNK < n; ++c)
+    {
+        acc += ctx->p_chunk_power[c];
+    }
+    for(k = c * SPECTRAL_FEATURES_CHUNK; k + 1 < n && acc + p_power[k] < target; ++k)
+    {
+        acc += p_power[k];
+    }
+    p_out->rolloff = (float) (k * ctx->bin_width);
+
+    /**
+     *  Parseval: sum((w x)^2) = sum(|X|^2) / N over the two sided
+     *  spectrum.  DC and Nyquist appear once, every other bin twice.
+     *  Dividing by the window energy gives the mean of x^2 over the
+     *  windowed samples, whatever the window and padding
+    **/
+    full = 2.0 * total - p_power[0] - p_power[n - 1];
+    p_out->rms = (float) sqrt(full / (ctx->window_energy * ctx->pcm_length));
+
+    if(ctx->sink)
+    {
+        ctx->sink(p_out, ctx->sink_data);
+    }
+}
+
+void spectral_features_log_edges
+(
+    double *p_edges
+    ,unsigned int num_bands
+    ,double fmin
+    ,double fmax
+)
+{
+    unsigned int i;
+    double ratio = pow(fmax / fmin, 1.0 / num_bands);
+
+    p_edges[0] = fmin;
+    for(i = 1; i <= num_bands; ++i)
+    {
+        p_edges[i] = p_edges[i - 1] * ratio;
+    }
+}
+
+/**
+ *  Keep the strongest peaks sorted loudest first.  The peak is
+ *  refined by fitting a parabola through the log power of the
+ *  bin and its two neighbours
+**/
+static void insert_peak
+(
+    spectral_features_ctx *ctx
+    ,spectral_features *out
+    ,unsigned int bin
+    ,const double *p_power
+)
+{
+    unsigned int i;
+    double a, b, c, denom, delta, level;
+
+    a = 10.0 * log10(p_power[bin - 1] + SPECTRAL_FEATURES_FLOOR);
+    b = 10.0 * log10(p_power[bin] + SPECTRAL_FEATURES_FLOOR);
+    c = 10.0 * log10(p_power[bin + 1] + SPECTRAL_FEATURES_FLOOR);
+
+    denom = a - 2.0 * b + c;
+    delta = denom != 0.0 ? 0.5 * (a - c) / denom : 0.0;
+    level = b - 0.25 * (a - c) * delta;
+
+    if(out->num_peaks == ctx->num_peaks
+       && level <= out->peaks[out->num_peaks - 1].level)
+    {
+        return;
+    }
+
+    /* Shift quieter peaks down, dropping the last if full */
+    i = out->num_peaks < ctx->num_peaks ? out->num_peaks++ : out->num_peaks - 1;
+    for(; i > 0 && out->peaks[i - 1].level < level; --i)
+    {
+        out->peaks[i] = out->peaks[i - 1];
+    }
+
+    out->peaks[i].freq = (float) ((bin + delta) * ctx->bin_width);
+    out->peaks[i].level = (float) level;
+}
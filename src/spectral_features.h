@@ -0,0 +1,189 @@
+#ifndef SPECTRAL_FEATURES_H
+#define SPECTRAL_FEATURES_H
+
+#include "fftw3.h"
+
+#define SPECTRAL_FEATURES_MAX_PEAKS     16
+#define SPECTRAL_FEATURES_MAX_BANDS     32
+
+/**
+ *  Number of bins processed per chunk of the fused pass.
+ *  The chunk's power values stay in L1 while they are
+ *  scanned for peaks
+**/
+#define SPECTRAL_FEATURES_CHUNK         512
+
+/**
+ *  The sums keep this many independent lanes, so they can
+ *  run side by side in vector registers without reordering
+ *  any one sum.  Flatness multiplies SPECTRAL_FEATURES_GROUP
+ *  bins per lane before taking one log of the product
+**/
+#define SPECTRAL_FEATURES_LANES         4
+#define SPECTRAL_FEATURES_GROUP         8
+
+typedef struct
+{
+    /** Interpolated peak frequency in Hz **/
+    float freq;
+    /** Interpolated peak level in dB (power) **/
+    float level;
+} spectral_peak;
+
+/**
+ *  Compact per frame feature record.  A few hundred bytes
+ *  instead of the full spectrum
+**/
+typedef struct
+{
+    unsigned int frame;
+    unsigned int num_peaks;
+    unsigned int num_bands;
+
+    /** Strongest peaks, loudest first **/
+    spectral_peak peaks[SPECTRAL_FEATURES_MAX_PEAKS];
+
+    /** Power weighted mean frequency in Hz **/
+    float centroid;
+
+    /** Geometric / arithmetic mean of power, 0..1 **/
+    float flatness;
+
+    /** Frequency below which rolloff_fraction of the power lies **/
+    float rolloff;
+
+    /** RMS of the analysed block, window corrected **/
+    float rms;
+
+    /** Energy of every configured band in dB **/
+    float band_energy[SPECTRAL_FEATURES_MAX_BANDS];
+
+} spectral_features;
+
+typedef void (*spectral_features_sink)(const spectral_features *features, void *userData);
+
+typedef struct
+{
+    unsigned int pcm_length;
+    unsigned int fft_length;
+    double bin_width;
+
+    unsigned int num_peaks;
+    double rolloff_fraction;
+
+    /**
+     * Sum of the squared window coefficients, used to undo
+     * the window's attenuation and the zero padding in the
+     * RMS estimate.  Set by spectral_features_set_window
+    **/
+    double window_energy;
+
+    /**
+     * Band edges as bin indices, num_bands + 1 entries
+    **/
+    unsigned int num_bands;
+    unsigned int band_edges[SPECTRAL_FEATURES_MAX_BANDS + 1];
+
+    /**
+     * Power of every bin and the power summed per chunk.
+     * Kept so rolloff only rescans the chunk it falls in
+    **/
+    double *p_power;
+    double *p_chunk_power;
+
+    /**
+     * Index of every bin as a double, for the centroid
+    **/
+    double *p_bin;
+
+    unsigned int frame;
+
+    /**
+     * Optional consumer of every record produced
+    **/
+    spectral_features_sink sink;
+    void *sink_data;
+
+} spectral_features_ctx;
+
+/** ------------------------------------------
+ *  spectral_features_init
+ *  ------------------------------------------
+ *      Configures feature extraction for an
+ *      r2c transform of pcm_length samples.
+ *      band_edges holds num_bands + 1 edge
+ *      frequencies in Hz (may be NULL when
+ *      num_bands is 0).
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int spectral_features_init
+(
+    spectral_features_ctx *ctx
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+    ,unsigned int num_peaks
+    ,const double *band_edges
+    ,unsigned int num_bands
+);
+
+/** ------------------------------------------
+ *  spectral_features_set_window
+ *  ------------------------------------------
+ *      Describes the window the frames were
+ *      taken with: window_length coefficients
+ *      at the start of the pcm_length frame.
+ *      Until it is called a Hann window over
+ *      the whole frame is assumed.  Does not
+ *      allocate, so it may run on the audio
+ *      thread.  Returns 0, or -1 if the
+ *      window is empty or too long
+ *  ==========================================
+**/
+int spectral_features_set_window
+(
+    spectral_features_ctx *ctx
+    ,const double *p_window
+    ,unsigned int window_length
+);
+
+/** ------------------------------------------
+ *  spectral_features_close
+ *  ------------------------------------------
+ *      Frees memory owned by the context
+ *  ==========================================
+**/
+void spectral_features_close(spectral_features_ctx *ctx);
+
+/** ----------------------------------------------------
+ *  spectral_features_process
+ *  ----------------------------------------------------
+ *      Computes every feature in one pass over the
+ *      complex spectrum, fills p_out and hands it to
+ *      the sink if one is set
+ *  ====================================================
+**/
+void spectral_features_process
+(
+    spectral_features_ctx *ctx
+    ,const fftw_complex *in
+    ,spectral_features *p_out
+);
+
+/** ----------------------------------------------------
+ *  spectral_features_log_edges
+ *  ----------------------------------------------------
+ *      Fills p_edges with num_bands + 1 logarithmically
+ *      spaced band edges from fmin to fmax Hz, for use
+ *      as the band_edges of spectral_features_init
+ *  ====================================================
+**/
+void spectral_features_log_edges
+(
+    double *p_edges
+    ,unsigned int num_bands
+    ,double fmin
+    ,double fmax
+);
+
+#endif
@@ -0,0 +1,577 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "spectrum_pub.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef MSG_NOSIGNAL
+#define SPECTRUM_PUB_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SPECTRUM_PUB_SEND_FLAGS 0
+#endif
+
+enum
+{
+    SLOT_FREE   = 0,
+    SLOT_FULL   = 1
+};
+
+/* ------------------------ Function Prototypes --------------------------- */
+static unsigned char *reserve_frame(spectrum_pub *pub, spectrum_pub_type type, uint32_t payload_bytes);
+static int finish_frame(spectrum_pub *pub);
+static void *sender_main(void *arg);
+static void accept_subscribers(spectrum_pub *pub);
+static int send_pending(spectrum_pub *pub, spectrum_pub_subscriber *sub);
+static int queue_batch(spectrum_pub *pub, spectrum_pub_subscriber *sub, const spectrum_pub_slot *slot);
+static void drop_subscriber(spectrum_pub *pub, unsigned int index);
+/* ------------------------------------------------------------------------ */
+
+
+int spectrum_pub_open
+(
+    spectrum_pub *pub
+    ,const char *path
+    ,unsigned int batch_frames
+    ,uint32_t max_payload_bytes
+    ,spectrum_pub_policy policy
+)
+{
+    struct sockaddr_un addr;
+    unsigned int i;
+
+    if(!pub || !path || !batch_frames || !max_payload_bytes || strlen(path) >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+
+    memset(pub, 0, sizeof(*pub));
+    pub->batch_frames = batch_frames;
+    pub->batch_capacity = (size_t) batch_frames * (sizeof(spectrum_pub_header) + max_payload_bytes);
+    pub->policy = policy;
+    pub->content = SPECTRUM_PUB_SEND_SPECTRUM;
+    pub->quant_floor_db = SPEC_QUANT_FLOOR_DB;
+    strcpy(pub->path, path);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    pub->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(pub->listen_fd < 0)
+    {
+        return -1;
+    }
+
+    /* A socket file left behind by a previous run would block bind */
+    unlink(path);
+
+    pub->p_thread = malloc(sizeof(pthread_t));
+    if(!pub->p_thread
+       || bind(pub->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+       || listen(pub->listen_fd, SPECTRUM_PUB_MAX_SUBSCRIBERS) < 0
+       || fcntl(pub->listen_fd, F_SETFL, O_NONBLOCK) < 0)
+    {
+        spectrum_pub_close(pub);
+        return -1;
+    }
+
+    /* Touched here so the audio thread never takes their page faults */
+    for(i = 0; i < SPECTRUM_PUB_SLOTS; ++i)
+    {
+        atomic_init(&pub->slots[i].state, SLOT_FREE);
+        pub->slots[i].p_batch = (unsigned char *) malloc(pub->batch_capacity);
+        if(!pub->slots[i].p_batch)
+        {
+            spectrum_pub_close(pub);
+            return -1;
+        }
+        memset(pub->slots[i].p_batch, 0, pub->batch_capacity);
+    }
+
+    atomic_store(&pub->b_running, 1);
+    if(pthread_create((pthread_t *) pub->p_thread, NULL, sender_main, pub))
+    {
+        atomic_store(&pub->b_running, 0);
+        spectrum_pub_close(pub);
+        return -1;
+    }
+
+    return 0;
+}
+
+void spectrum_pub_close(spectrum_pub *pub)
+{
+    unsigned int i;
+
+    if(!pub || pub->listen_fd < 0)
+    {
+        return;
+    }
+
+    /* The sender makes one last pass after it is told to stop */
+    if(atomic_load(&pub->b_running))
+    {
+        spectrum_pub_flush(pub);
+        atomic_store(&pub->b_running, 0);
+        pthread_join(*(pthread_t *) pub->p_thread, NULL);
+    }
+
+    while(pub->num_subscribers)
+    {
+        drop_subscriber(pub, 0);
+    }
+
+    close(pub->listen_fd);
+    unlink(pub->path);
+    for(i = 0; i < SPECTRUM_PUB_SLOTS; ++i)
+    {
+        free(pub->slots[i].p_batch);
+        pub->slots[i].p_batch = NULL;
+    }
+    free(pub->p_thread);
+
+    pub->listen_fd = -1;
+    pub->p_thread = NULL;
+}
+
+int spectrum_pub_frame
+(
+    spectrum_pub *pub
+    ,spectrum_pub_type type
+    ,const void *payload
+    ,uint32_t payload_bytes
+)
+{
+    unsigned char *p = reserve_frame(pub, type, payload_bytes);
+
+    if(!p)
+    {
+        return -1;
+    }
+
+    memcpy(p, payload, payload_bytes);
+    return finish_frame(pub);
+}
+
+int spectrum_pub_spectrum
+(
+    spectrum_pub *pub
+    ,const double *p_mag
+    ,unsigned int length
+)
+{
+    unsigned int i;
+    float *p = (float *) reserve_frame(pub, SPECTRUM_PUB_SPECTRUM, sizeof(float) * length);
+
+    if(!p)
+    {
+        return -1;
+    }
+
+    for(i = 0; i < length; ++i)
+    {
+        p[i] = (float) p_mag[i];
+    }
+
+    return finish_frame(pub);
+}
+
+int spectrum_pub_spectrum_quant
+(
+    spectrum_pub *pub
+    ,const double *p_mag
+    ,unsigned int length
+    ,spec_quant_width width
+)
+{
+    const spectrum_pub_type type = width == SPEC_QUANT_U8 ? SPECTRUM_PUB_SPECTRUM_U8 : SPECTRUM_PUB_SPECTRUM_U16;
+    const uint32_t code_bytes = (width * length + 3) & ~3u;
+    spectrum_pub_quant *q = (spectrum_pub_quant *) reserve_frame(pub, type, sizeof(*q) + code_bytes);
+
+    if(!q)
+    {
+        return -1;
+    }
+
+    q->bins = length;
+    q->reserved = 0;
+    memset((unsigned char *) (q + 1) + width * length, 0, code_bytes - width * length);
+    spec_quant_encode(p_mag, length, pub->quant_floor_db, width, q + 1, &q->params);
+
+    return finish_frame(pub);
+}
+
+int spectrum_pub_features
+(
+    spectrum_pub *pub
+    ,const spectral_features *features
+)
+{
+    if((pub->content & SPECTRUM_PUB_SEND_BANDS) && features->num_bands
+       && spectrum_pub_frame(pub, SPECTRUM_PUB_BANDS, features->band_energy,
+                             sizeof(float) * features->num_bands) < 0)
+    {
+        return -1;
+    }
+
+    if((pub->content & SPECTRUM_PUB_SEND_FEATURES)
+       && spectrum_pub_frame(pub, SPECTRUM_PUB_FEATURES, features, sizeof(*features)) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+void spectrum_pub_flush(spectrum_pub *pub)
+{
+    if(!pub->frames_in_batch)
+    {
+        return;
+    }
+
+    atomic_store_explicit(&pub->slots[pub->fill_slot].state, SLOT_FULL, memory_order_release);
+    pub->fill_slot = (pub->fill_slot + 1) % SPECTRUM_PUB_SLOTS;
+    pub->frames_in_batch = 0;
+}
+
+/**
+ *  Append a header to the batch in the fill slot and return
+ *  where the payload goes, or NULL to drop the frame when the
+ *  slot is still being sent or the frame does not fit
+**/
+static unsigned char *reserve_frame
+(
+    spectrum_pub *pub
+    ,spectrum_pub_type type
+    ,uint32_t payload_bytes
+)
+{
+    spectrum_pub_slot *slot = &pub->slots[pub->fill_slot];
+    spectrum_pub_header header;
+    struct timespec ts;
+    unsigned char *p;
+
+    if(atomic_load_explicit(&slot->state, memory_order_acquire) != SLOT_FREE)
+    {
+        ++pub->frames_dropped;
+        return NULL;
+    }
+    if(!pub->frames_in_batch)
+    {
+        slot->batch_bytes = 0;
+    }
+    if(slot->batch_bytes + sizeof(header) + payload_bytes > pub->batch_capacity)
+    {
+        ++pub->frames_dropped;
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    header.magic = SPECTRUM_PUB_MAGIC;
+    header.version = SPECTRUM_PUB_VERSION;
+    header.type = (uint16_t) type;
+    header.sequence = pub->sequence++;
+    header.payload_bytes = payload_bytes;
+    header.timestamp_ns = (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+
+    p = slot->p_batch + slot->batch_bytes;
+    memcpy(p, &header, sizeof(header));
+    slot->batch_bytes += sizeof(header) + payload_bytes;
+
+    return p + sizeof(header);
+}
+
+static int finish_frame(spectrum_pub *pub)
+{
+    ++pub->frames_published;
+
+    if(++pub->frames_in_batch >= pub->batch_frames)
+    {
+        spectrum_pub_flush(pub);
+    }
+
+    return 0;
+}
+
+/* -------------------------------- sender -------------------------------- */
+
+/**
+ *  Accepts subscribers, keeps their queues moving and hands
+ *  them the full slots in the order they were filled
+**/
+static void *sender_main(void *arg)
+{
+    spectrum_pub *pub = (spectrum_pub *) arg;
+    spectrum_pub_slot *slot;
+    unsigned int i;
+    int b_running, found;
+    struct timespec ts;
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = SPECTRUM_PUB_POLL_MS * 1000000L;
+
+    do
+    {
+        /* Read before scanning, so a stop request still gets one full pass */
+        b_running = atomic_load(&pub->b_running);
+
+        accept_subscribers(pub);
+
+        found = 0;
+        slot = &pub->slots[pub->send_slot];
+        while(atomic_load_explicit(&slot->state, memory_order_acquire) == SLOT_FULL)
+        {
+            for(i = 0; i < pub->num_subscribers; )
+            {
+                if(send_pending(pub, &pub->subscribers[i]) < 0
+                   || queue_batch(pub, &pub->subscribers[i], slot) < 0)
+                {   /* Gone or too slow; the last subscriber moves into slot i */
+                    drop_subscriber(pub, i);
+                    continue;
+                }
+                ++i;
+            }
+            atomic_store_explicit(&slot->state, SLOT_FREE, memory_order_release);
+
+            pub->send_slot = (pub->send_slot + 1) % SPECTRUM_PUB_SLOTS;
+            slot = &pub->slots[pub->send_slot];
+            found = 1;
+        }
+
+        if(!found)
+        {
+            /* Whatever the kernel did not take last time */
+            for(i = 0; i < pub->num_subscribers; )
+            {
+                if(send_pending(pub, &pub->subscribers[i]) < 0)
+                {
+                    drop_subscriber(pub, i);
+                    continue;
+                }
+                ++i;
+            }
+            if(b_running)
+            {
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+    while(b_running);
+
+    return NULL;
+}
+
+static void accept_subscribers(spectrum_pub *pub)
+{
+    int fd;
+    spectrum_pub_subscriber *sub;
+
+    while((fd = accept(pub->listen_fd, NULL, NULL)) >= 0)
+    {
+        if(pub->num_subscribers == SPECTRUM_PUB_MAX_SUBSCRIBERS
+           || fcntl(fd, F_SETFL, O_NONBLOCK) < 0)
+        {
+            close(fd);
+            continue;
+        }
+
+#ifdef SO_NOSIGPIPE
+        {
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+        }
+#endif
+
+        sub = &pub->subscribers[pub->num_subscribers];
+        memset(sub, 0, sizeof(*sub));
+        sub->pending_capacity = SPECTRUM_PUB_QUEUE_BATCHES * pub->batch_capacity;
+        sub->p_pending = (unsigned char *) malloc(sub->pending_capacity);
+        if(!sub->p_pending)
+        {
+            close(fd);
+            continue;
+        }
+        sub->fd = fd;
+        ++pub->num_subscribers;
+    }
+}
+
+/**
+ *  Push queued bytes to the subscriber.  Only the BLOCK policy
+ *  waits for the socket to drain, and only until the publisher
+ *  is closed; otherwise whatever the kernel does not take stays
+ *  queued.  Returns -1 if the peer is gone
+**/
+static int send_pending
+(
+    spectrum_pub *pub
+    ,spectrum_pub_subscriber *sub
+)
+{
+    ssize_t n;
+    size_t sent = 0;
+    struct pollfd pfd;
+
+    while(sent < sub->pending_bytes)
+    {
+        n = send(sub->fd, sub->p_pending + sent, sub->pending_bytes - sent, SPECTRUM_PUB_SEND_FLAGS);
+        if(n > 0)
+        {
+            sent += (size_t) n;
+        }
+        else if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            if(pub->policy != SPECTRUM_PUB_BLOCK || !atomic_load(&pub->b_running))
+            {
+                break;
+            }
+            pfd.fd = sub->fd;
+            pfd.events = POLLOUT;
+            if(poll(&pfd, 1, SPECTRUM_PUB_POLL_MS) < 0 && errno != EINTR)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    memmove(sub->p_pending, sub->p_pending + sent, sub->pending_bytes - sent);
+    sub->pending_bytes -= sent;
+
+    return 0;
+}
+
+/**
+ *  Hand a batch to one subscriber, applying the drop policy if
+ *  it already has SPECTRUM_PUB_QUEUE_BATCHES worth queued
+**/
+static int queue_batch
+(
+    spectrum_pub *pub
+    ,spectrum_pub_subscriber *sub
+    ,const spectrum_pub_slot *slot
+)
+{
+    if(sub->pending_bytes + slot->batch_bytes > sub->pending_capacity)
+    {
+        if(pub->policy == SPECTRUM_PUB_DISCONNECT)
+        {
+            return -1;
+        }
+        ++sub->batches_dropped;
+        atomic_fetch_add(&pub->batches_dropped, 1);
+        return 0;
+    }
+
+    memcpy(sub->p_pending + sub->pending_bytes, slot->p_batch, slot->batch_bytes);
+    sub->pending_bytes += slot->batch_bytes;
+
+    return send_pending(pub, sub);
+}
+
+static void drop_subscriber
+(
+    spectrum_pub *pub
+    ,unsigned int index
+)
+{
+    spectrum_pub_subscriber *sub = &pub->subscribers[index];
+
+    close(sub->fd);
+    free(sub->p_pending);
+
+    *sub = pub->subscribers[--pub->num_subscribers];
+}
+
+#else
+
+int spectrum_pub_open
+(
+    spectrum_pub *pub
+    ,const char *path
+    ,unsigned int batch_frames
+    ,uint32_t max_payload_bytes
+    ,spectrum_pub_policy policy
+)
+{
+    /* Unix domain sockets and POSIX threads only */
+    (void) pub; (void) path; (void) batch_frames; (void) max_payload_bytes; (void) policy;
+    return -1;
+}
+
+void spectrum_pub_close(spectrum_pub *pub) { (void) pub; }
+void spectrum_pub_flush(spectrum_pub *pub) { (void) pub; }
+
+int spectrum_pub_frame(spectrum_pub *pub, spectrum_pub_type type, const void *payload, uint32_t payload_bytes)
+{
+    (void) pub; (void) type; (void) payload; (void) payload_bytes;
+    return -1;
+}
+
+int spectrum_pub_spectrum(spectrum_pub *pub, const double *p_mag, unsigned int length)
+{
+    (void) pub; (void) p_mag; (void) length;
+    return -1;
+}
+
+int spectrum_pub_spectrum_quant(spectrum_pub *pub, const double *p_mag, unsigned int length, spec_quant_width width)
+{
+    (void) pub; (void) p_mag; (void) length; (void) width;
+    return -1;
+}
+
+int spectrum_pub_features(spectrum_pub *pub, const spectral_features *features)
+{
+    (void) pub; (void) features;
+    return -1;
+}
+
+#endif /* _WIN32 */
+
+long spectrum_pub_parse
+(
+    const void *buf
+    ,size_t length
+    ,spectrum_pub_header *p_header
+    ,const void **p_payload
+)
+{
+    if(length < sizeof(spectrum_pub_header))
+    {
+        return 0;
+    }
+
+    memcpy(p_header, buf, sizeof(*p_header));
+
+    if(p_header->magic != SPECTRUM_PUB_MAGIC || p_header->version != SPECTRUM_PUB_VERSION)
+    {
+        return -1;
+    }
+
+    if(length < sizeof(spectrum_pub_header) + p_header->payload_bytes)
+    {
+        return 0;
+    }
+
+    *p_payload = (const unsigned char *) buf + sizeof(spectrum_pub_header);
+    return (long) (sizeof(spectrum_pub_header) + p_header->payload_bytes);
+}
@@ -0,0 +1,284 @@
+#ifndef SPECTRUM_PUB_H
+#define SPECTRUM_PUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "spectral_features.h"
+#include "spec_quant.h"
+
+/**
+ *  Wire format, version 1
+ *
+ *  The stream is a sequence of frames, each a fixed header
+ *  followed by payload_bytes of payload.  All fields are in
+ *  host byte order (publisher and subscribers share a host).
+ *  Several frames are batched into a single write, but a
+ *  subscriber never receives part of a batch: when it falls
+ *  behind whole batches are dropped.
+**/
+#define SPECTRUM_PUB_MAGIC              0x31424646u /* "FFB1" */
+#define SPECTRUM_PUB_VERSION            1
+
+#define SPECTRUM_PUB_MAX_SUBSCRIBERS    16
+
+/**
+ *  Bytes a subscriber may have queued before the drop
+ *  policy kicks in, expressed in batches
+**/
+#define SPECTRUM_PUB_QUEUE_BATCHES      4
+
+/**
+ *  Batches are filled in a ring of this many slots and sent by
+ *  a sender thread, which looks for full ones every
+ *  SPECTRUM_PUB_POLL_MS.  While the slot to fill next is still
+ *  being sent, frames are dropped and counted
+**/
+#define SPECTRUM_PUB_SLOTS              4
+#define SPECTRUM_PUB_POLL_MS            5
+
+typedef enum
+{
+    /** float32 magnitudes in dB, one per bin **/
+    SPECTRUM_PUB_SPECTRUM   = 1,
+    /** float32 band levels in dB **/
+    SPECTRUM_PUB_BANDS      = 2,
+    /** one spectral_features record **/
+    SPECTRUM_PUB_FEATURES   = 3,
+    /** spectrum_pub_quant, then one uint8_t code per bin **/
+    SPECTRUM_PUB_SPECTRUM_U8    = 4,
+    /** spectrum_pub_quant, then one uint16_t code per bin **/
+    SPECTRUM_PUB_SPECTRUM_U16   = 5
+
+} spectrum_pub_type;
+
+/** Bit mask of what fft_block publishes every frame **/
+#define SPECTRUM_PUB_SEND_SPECTRUM  (1u << SPECTRUM_PUB_SPECTRUM)
+#define SPECTRUM_PUB_SEND_BANDS     (1u << SPECTRUM_PUB_BANDS)
+#define SPECTRUM_PUB_SEND_FEATURES  (1u << SPECTRUM_PUB_FEATURES)
+#define SPECTRUM_PUB_SEND_SPECTRUM_U8   (1u << SPECTRUM_PUB_SPECTRUM_U8)
+#define SPECTRUM_PUB_SEND_SPECTRUM_U16  (1u << SPECTRUM_PUB_SPECTRUM_U16)
+
+typedef enum
+{
+    /** Drop batches for a subscriber whose queue is full **/
+    SPECTRUM_PUB_DROP       = 0,
+    /** Disconnect a subscriber whose queue is full **/
+    SPECTRUM_PUB_DISCONNECT = 1,
+    /**
+     * Wait for slow subscribers.  Only the sender thread waits;
+     * the publisher drops frames once every slot is taken
+    **/
+    SPECTRUM_PUB_BLOCK      = 2
+
+} spectrum_pub_policy;
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t sequence;
+    uint32_t payload_bytes;
+    /** CLOCK_MONOTONIC time the frame was queued, in ns **/
+    uint64_t timestamp_ns;
+
+} spectrum_pub_header;
+
+/**
+ *  Leads a quantized spectrum payload.  The codes are padded to
+ *  a multiple of 4 bytes so the frames after them stay aligned
+ *  for float32 readers
+**/
+typedef struct
+{
+    spec_quant_params params;
+    uint32_t bins;
+    uint32_t reserved;
+
+} spectrum_pub_quant;
+
+typedef struct
+{
+    int fd;
+
+    /** Bytes of whole batches still to be sent **/
+    unsigned char *p_pending;
+    size_t pending_bytes;
+    size_t pending_capacity;
+
+    unsigned long batches_dropped;
+
+} spectrum_pub_subscriber;
+
+/** A batch being filled or waiting for the sender **/
+typedef struct
+{
+    unsigned char *p_batch;
+    size_t batch_bytes;
+    atomic_int state;
+
+} spectrum_pub_slot;
+
+typedef struct
+{
+    int listen_fd;
+    char path[108];
+
+    spectrum_pub_policy policy;
+
+    /** SPECTRUM_PUB_SEND_* flags used by fft_block **/
+    unsigned int content;
+
+    /** Level quantized spectra clamp silent bins to **/
+    double quant_floor_db;
+
+    /**
+     * Frames are appended to the fill slot and handed to
+     * the sender once batch_frames have accumulated
+    **/
+    spectrum_pub_slot slots[SPECTRUM_PUB_SLOTS];
+    unsigned int fill_slot;
+    unsigned int send_slot;
+    size_t batch_capacity;
+    unsigned int batch_frames;
+    unsigned int frames_in_batch;
+
+    uint32_t sequence;
+
+    /** Sender thread only **/
+    unsigned int num_subscribers;
+    spectrum_pub_subscriber subscribers[SPECTRUM_PUB_MAX_SUBSCRIBERS];
+
+    void *p_thread;
+    atomic_int b_running;
+
+    unsigned long frames_published;
+    unsigned long frames_dropped;
+    atomic_ulong batches_dropped;
+
+} spectrum_pub;
+
+/** ------------------------------------------
+ *  spectrum_pub_open
+ *  ------------------------------------------
+ *      Listens on a Unix domain socket at path
+ *      (replacing a stale socket file), starts
+ *      the sender thread and writes every
+ *      batch_frames frames as one batch.  The
+ *      batch buffers are allocated here for
+ *      payloads of up to max_payload_bytes;
+ *      larger frames are dropped.  Returns 0
+ *      on success, -1 on failure
+ *  ==========================================
+**/
+int spectrum_pub_open
+(
+    spectrum_pub *pub
+    ,const char *path
+    ,unsigned int batch_frames
+    ,uint32_t max_payload_bytes
+    ,spectrum_pub_policy policy
+);
+
+/** ------------------------------------------
+ *  spectrum_pub_close
+ *  ------------------------------------------
+ *      Hands over the current batch, stops the
+ *      sender after it has sent what it can
+ *      without blocking, disconnects everyone
+ *      and removes the socket file
+ *  ==========================================
+**/
+void spectrum_pub_close(spectrum_pub *pub);
+
+/** ----------------------------------------------------
+ *  spectrum_pub_frame
+ *  ----------------------------------------------------
+ *      Queues a frame with an opaque payload.  Hands
+ *      the batch to the sender thread when it is full.
+ *      Never blocks or allocates.  Returns 0 on
+ *      success, -1 if the frame was dropped
+ *  ====================================================
+**/
+int spectrum_pub_frame
+(
+    spectrum_pub *pub
+    ,spectrum_pub_type type
+    ,const void *payload
+    ,uint32_t payload_bytes
+);
+
+/** ----------------------------------------------------
+ *  spectrum_pub_spectrum
+ *  ----------------------------------------------------
+ *      Queues a SPECTRUM_PUB_SPECTRUM frame, narrowing
+ *      the magnitudes to float32 straight into the
+ *      batch buffer
+ *  ====================================================
+**/
+int spectrum_pub_spectrum
+(
+    spectrum_pub *pub
+    ,const double *p_mag
+    ,unsigned int length
+);
+
+/** ----------------------------------------------------
+ *  spectrum_pub_spectrum_quant
+ *  ----------------------------------------------------
+ *      Queues a SPECTRUM_PUB_SPECTRUM_U8 or _U16 frame,
+ *      quantizing the dB magnitudes straight into the
+ *      batch buffer: 1/4 or 1/2 of the float32 frame
+ *  ====================================================
+**/
+int spectrum_pub_spectrum_quant
+(
+    spectrum_pub *pub
+    ,const double *p_mag
+    ,unsigned int length
+    ,spec_quant_width width
+);
+
+/** ----------------------------------------------------
+ *  spectrum_pub_features
+ *  ----------------------------------------------------
+ *      Queues the record as a SPECTRUM_PUB_FEATURES
+ *      frame and its bands as a SPECTRUM_PUB_BANDS
+ *      frame, as selected by pub->content
+ *  ====================================================
+**/
+int spectrum_pub_features
+(
+    spectrum_pub *pub
+    ,const spectral_features *features
+);
+
+/** ----------------------------------------------------
+ *  spectrum_pub_flush
+ *  ----------------------------------------------------
+ *      Hands the current batch (even if not full) to
+ *      the sender thread
+ *  ====================================================
+**/
+void spectrum_pub_flush(spectrum_pub *pub);
+
+/** ----------------------------------------------------
+ *  spectrum_pub_parse
+ *  ----------------------------------------------------
+ *      Subscriber side helper.  Decodes the frame at
+ *      the start of buf.  Returns the number of bytes
+ *      it occupies, 0 if more data is needed, or -1
+ *      if the stream is corrupt or of another version
+ *  ====================================================
+**/
+long spectrum_pub_parse
+(
+    const void *buf
+    ,size_t length
+    ,spectrum_pub_header *p_header
+    ,const void **p_payload
+);
+
+#endif
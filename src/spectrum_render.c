@@ -0,0 +1,696 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spectrum_render.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#endif
+
+/* Largest payload of one stored (uncompressed) deflate block */
+#define DEFLATE_STORED_MAX  65535
+
+enum
+{
+    SLOT_FREE   = 0,
+    SLOT_FULL   = 1
+};
+
+/* ------------------------ Function Prototypes --------------------------- */
+static uint32_t rgba(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+static void build_palette(uint32_t *palette);
+static void compose_into(const spectrum_render *r, uint32_t *p_dst);
+static int write_raw_pixels(const spectrum_render *r, const uint32_t *p_pixels, FILE *fp);
+static int write_png_pixels(const spectrum_render *r, const uint32_t *p_pixels, const char *path);
+#ifndef _WIN32
+static void *writer_main(void *arg);
+#endif
+static uint32_t crc32_update(uint32_t crc, const unsigned char *buf, size_t len);
+static void adler32_update(uint32_t *a, uint32_t *b, const unsigned char *buf, size_t len);
+static int write_chunk_start(FILE *fp, const char *type, uint32_t length, uint32_t *crc);
+static int write_crc_bytes(FILE *fp, const void *buf, size_t len, uint32_t *crc);
+static int write_be32(FILE *fp, uint32_t value, uint32_t *crc);
+/* ------------------------------------------------------------------------ */
+
+
+int spectrum_render_init
+(
+    spectrum_render *r
+    ,unsigned int width
+    ,unsigned int height
+    ,unsigned int spectrum_height
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+)
+{
+    unsigned int x, y, decade;
+    double ratio;
+
+    if(!r || !width || !height || !spectrum_height || spectrum_height > height || !pcm_length)
+    {
+        return -1;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->width = width;
+    r->height = height;
+    r->spectrum_height = spectrum_height;
+    r->wf_height = height - spectrum_height;
+    r->fmin = 20.0;
+    r->fmax = 20000.0;
+    r->db_min = 0.0;
+    r->db_max = 100.0;
+    r->png_interval = 1;
+
+    r->p_pixels = (uint32_t *) calloc((size_t) width * height, sizeof(uint32_t));
+    r->p_waterfall = (uint32_t *) calloc((size_t) width * (r->wf_height + 1), sizeof(uint32_t));
+    r->p_col_lo = (unsigned int *) malloc(sizeof(unsigned int) * width);
+    r->p_col_hi = (unsigned int *) malloc(sizeof(unsigned int) * width);
+    r->p_col_level = (double *) malloc(sizeof(double) * width);
+    r->p_col_top = (unsigned int *) malloc(sizeof(unsigned int) * width);
+    r->p_grid_col = (unsigned char *) calloc(width, 1);
+    r->p_grid_row = (unsigned char *) calloc(spectrum_height, 1);
+
+    if(!r->p_pixels || !r->p_waterfall || !r->p_col_lo || !r->p_col_hi
+       || !r->p_col_level || !r->p_col_top || !r->p_grid_col || !r->p_grid_row)
+    {
+        spectrum_render_close(r);
+        return -1;
+    }
+
+    spectrum_render_map(r, samplerate, pcm_length);
+
+    /* Grid at 100 Hz, 1 kHz, 10 kHz and every 10 dB */
+    ratio = r->fmax / r->fmin;
+    for(decade = 100; decade <= 10000; decade *= 10)
+    {
+        x = (unsigned int) (width * log(decade / r->fmin) / log(ratio));
+        if(x < width)
+        {
+            r->p_grid_col[x] = 1;
+        }
+    }
+    for(y = 0; y < 10; ++y)
+    {
+        r->p_grid_row[(spectrum_height - 1) * y / 10] = 1;
+    }
+
+    build_palette(r->palette);
+
+    return 0;
+}
+
+void spectrum_render_map
+(
+    spectrum_render *r
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+)
+{
+    unsigned int x;
+    double bin_width, f_lo, f_hi, ratio;
+    const unsigned int width = r->width;
+
+    r->fft_length = pcm_length / 2 + 1;
+
+    /** ------------------------------------------------------
+     *  Map every column to the bins it covers on a log axis.
+     *  Low columns may share a single bin, high ones span many
+     *  ======================================================
+    **/
+    bin_width = (double) samplerate / pcm_length;
+    ratio = r->fmax / r->fmin;
+    for(x = 0; x < width; ++x)
+    {
+        f_lo = r->fmin * pow(ratio, (double) x / width);
+        f_hi = r->fmin * pow(ratio, (double) (x + 1) / width);
+
+        r->p_col_lo[x] = (unsigned int) (f_lo / bin_width);
+        r->p_col_hi[x] = (unsigned int) ceil(f_hi / bin_width);
+        if(r->p_col_lo[x] >= r->fft_length)
+        {
+            r->p_col_lo[x] = r->fft_length - 1;
+        }
+        if(r->p_col_hi[x] <= r->p_col_lo[x])
+        {
+            r->p_col_hi[x] = r->p_col_lo[x] + 1;
+        }
+        if(r->p_col_hi[x] > r->fft_length)
+        {
+            r->p_col_hi[x] = r->fft_length;
+        }
+    }
+}
+
+#ifndef _WIN32
+
+int spectrum_render_start
+(
+    spectrum_render *r
+    ,FILE *raw_fp
+    ,const char *png_path
+    ,unsigned int png_interval
+)
+{
+    unsigned int i;
+    const size_t pixels = (size_t) r->width * r->height;
+
+    if(r->p_thread || (!raw_fp && !png_path))
+    {
+        return -1;
+    }
+
+    for(i = 0; i < SPECTRUM_RENDER_SLOTS; ++i)
+    {
+        atomic_init(&r->slots[i].state, SLOT_FREE);
+        /* Touched now so the first frames do not fault pages in */
+        r->slots[i].p_pixels = (uint32_t *) malloc(sizeof(uint32_t) * pixels);
+        if(!r->slots[i].p_pixels)
+        {
+            return -1;
+        }
+        memset(r->slots[i].p_pixels, 0, sizeof(uint32_t) * pixels);
+    }
+
+    r->raw_fp = raw_fp;
+    r->png_path = png_path;
+    r->png_interval = png_interval ? png_interval : 1;
+    r->fill_slot = 0;
+    r->write_slot = 0;
+
+    r->p_thread = malloc(sizeof(pthread_t));
+    if(!r->p_thread)
+    {
+        return -1;
+    }
+
+    atomic_store(&r->b_running, 1);
+    if(pthread_create((pthread_t *) r->p_thread, NULL, writer_main, r))
+    {
+        atomic_store(&r->b_running, 0);
+        free(r->p_thread);
+        r->p_thread = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+#else
+
+int spectrum_render_start
+(
+    spectrum_render *r
+    ,FILE *raw_fp
+    ,const char *png_path
+    ,unsigned int png_interval
+)
+{
+    /* Needs POSIX threads for the writer */
+    (void) r; (void) raw_fp; (void) png_path; (void) png_interval;
+    return -1;
+}
+
+#endif
+
+void spectrum_render_close(spectrum_render *r)
+{
+    unsigned int i;
+
+    if(!r)
+    {
+        return;
+    }
+
+#ifndef _WIN32
+    /* The writer empties the full slots before it exits */
+    if(atomic_exchange(&r->b_running, 0))
+    {
+        pthread_join(*(pthread_t *) r->p_thread, NULL);
+    }
+#endif
+    free(r->p_thread);
+    for(i = 0; i < SPECTRUM_RENDER_SLOTS; ++i)
+    {
+        free(r->slots[i].p_pixels);
+    }
+
+    free(r->p_pixels);
+    free(r->p_waterfall);
+    free(r->p_col_lo);
+    free(r->p_col_hi);
+    free(r->p_col_level);
+    free(r->p_col_top);
+    free(r->p_grid_col);
+    free(r->p_grid_row);
+    memset(r, 0, sizeof(*r));
+}
+
+void spectrum_render_frame
+(
+    spectrum_render *r
+    ,const double *p_mag
+    ,unsigned int length
+)
+{
+    unsigned int x, y, k, hi, top;
+    double level, scale;
+    const unsigned int w = r->width;
+    const double range = r->db_max - r->db_min;
+    const uint32_t bg = rgba(16, 16, 24, 255);
+    const uint32_t grid = rgba(48, 48, 64, 255);
+    const uint32_t fill = rgba(32, 96, 160, 255);
+    const uint32_t line = rgba(120, 200, 255, 255);
+    uint32_t *p_row, row_bg, above, below, *p_wf;
+    spectrum_render_slot *p_slot;
+    int b_raw, b_png;
+
+    /* Peak level of the bins behind every column */
+    for(x = 0; x < w; ++x)
+    {
+        hi = r->p_col_hi[x] < length ? r->p_col_hi[x] : length;
+        level = r->db_min;
+        for(k = r->p_col_lo[x]; k < hi; ++k)
+        {
+            level = p_mag[k] > level ? p_mag[k] : level;
+        }
+        r->p_col_level[x] = level;
+
+        scale = (r->db_max - level) / range;
+        scale = scale < 0.0 ? 0.0 : scale;
+        top = (unsigned int) (scale * (r->spectrum_height - 1));
+        r->p_col_top[x] = top;
+    }
+
+    /**
+     *  Draw row by row.  Every pixel is a select between
+     *  background, grid, edge line and fill colour with no data
+     *  dependent branches, so the inner loop vectorizes
+    **/
+    for(y = 0; y < r->spectrum_height; ++y)
+    {
+        p_row = r->p_pixels + (size_t) y * w;
+        row_bg = r->p_grid_row[y] ? grid : bg;
+        for(x = 0; x < w; ++x)
+        {
+            top = r->p_col_top[x];
+            above = r->p_grid_col[x] ? grid : row_bg;
+            below = y < top + 2 ? line : fill;
+            p_row[x] = y < top ? above : below;
+        }
+    }
+
+    /* New waterfall row, newest first */
+    if(r->wf_height)
+    {
+        r->wf_pos = r->wf_pos ? r->wf_pos - 1 : r->wf_height - 1;
+        p_wf = r->p_waterfall + (size_t) r->wf_pos * w;
+        for(x = 0; x < w; ++x)
+        {
+            scale = (r->p_col_level[x] - r->db_min) / range;
+            scale = scale < 0.0 ? 0.0 : (scale > 1.0 ? 1.0 : scale);
+            p_wf[x] = r->palette[(unsigned int) (scale * 255.0)];
+        }
+    }
+
+    ++r->frames;
+
+    /* Outputs due: compose a copy for the writer, or drop it */
+    b_raw = r->raw_fp != NULL;
+    b_png = r->png_path && r->frames % r->png_interval == 0;
+    if(!(b_raw || b_png) || !atomic_load_explicit(&r->b_running, memory_order_relaxed))
+    {
+        return;
+    }
+
+    p_slot = &r->slots[r->fill_slot];
+    if(atomic_load_explicit(&p_slot->state, memory_order_acquire) != SLOT_FREE)
+    {
+        ++r->images_dropped;
+        return;
+    }
+
+    compose_into(r, p_slot->p_pixels);
+    p_slot->b_raw = b_raw;
+    p_slot->b_png = b_png;
+    atomic_store_explicit(&p_slot->state, SLOT_FULL, memory_order_release);
+    r->fill_slot = (r->fill_slot + 1) % SPECTRUM_RENDER_SLOTS;
+}
+
+void spectrum_render_compose(spectrum_render *r)
+{
+    compose_into(r, r->p_pixels);
+}
+
+int spectrum_render_write_raw(spectrum_render *r, FILE *fp)
+{
+    spectrum_render_compose(r);
+
+    return write_raw_pixels(r, r->p_pixels, fp);
+}
+
+int spectrum_render_write_png(spectrum_render *r, const char *path)
+{
+    spectrum_render_compose(r);
+
+    return write_png_pixels(r, r->p_pixels, path);
+}
+
+/**
+ *  Spectrum rows (unless p_dst is p_pixels itself), then the
+ *  waterfall ring, newest row first
+**/
+static void compose_into(const spectrum_render *r, uint32_t *p_dst)
+{
+    unsigned int first;
+    const size_t row_bytes = sizeof(uint32_t) * r->width;
+
+    if(p_dst != r->p_pixels)
+    {
+        memcpy(p_dst, r->p_pixels, row_bytes * r->spectrum_height);
+    }
+    if(!r->wf_height)
+    {
+        return;
+    }
+    p_dst += (size_t) r->spectrum_height * r->width;
+
+    /* The ring splits into at most two contiguous runs */
+    first = r->wf_height - r->wf_pos;
+    memcpy(p_dst, r->p_waterfall + (size_t) r->wf_pos * r->width, row_bytes * first);
+    memcpy(p_dst + (size_t) first * r->width, r->p_waterfall, row_bytes * r->wf_pos);
+}
+
+static int write_raw_pixels(const spectrum_render *r, const uint32_t *p_pixels, FILE *fp)
+{
+    const size_t pixels = (size_t) r->width * r->height;
+
+    return fwrite(p_pixels, sizeof(uint32_t), pixels, fp) == pixels ? 0 : -1;
+}
+
+/**
+ *  PNG with the image data in stored deflate blocks.  Larger
+ *  than a compressed PNG but costs little more than a memcpy
+ *  and needs no zlib
+**/
+static int write_png_pixels(const spectrum_render *r, const uint32_t *p_pixels, const char *path)
+{
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    static const unsigned char zlib_header[2] = { 0x78, 0x01 };
+    unsigned char ihdr[13] = { 0 };
+    unsigned char block[5];
+    unsigned char filter = 0;
+    const unsigned char *p_src;
+    uint32_t crc, adler_a = 1, adler_b = 0;
+    size_t raw_bytes, row_bytes, done, take, row_left, n, i;
+    size_t num_blocks, idat_bytes;
+    unsigned int y = 0;
+    FILE *fp;
+    int ok = 1;
+
+    row_bytes = (size_t) r->width * 4;
+    raw_bytes = (row_bytes + 1) * r->height;
+    num_blocks = (raw_bytes + DEFLATE_STORED_MAX - 1) / DEFLATE_STORED_MAX;
+    idat_bytes = 2 + raw_bytes + 5 * num_blocks + 4;
+
+    fp = fopen(path, "wb");
+    if(!fp)
+    {
+        return -1;
+    }
+
+    ok &= fwrite(signature, 1, sizeof(signature), fp) == sizeof(signature);
+
+    /* IHDR: 8 bit RGBA, no interlace */
+    ihdr[0] = (unsigned char) (r->width >> 24);
+    ihdr[1] = (unsigned char) (r->width >> 16);
+    ihdr[2] = (unsigned char) (r->width >> 8);
+    ihdr[3] = (unsigned char) r->width;
+    ihdr[4] = (unsigned char) (r->height >> 24);
+    ihdr[5] = (unsigned char) (r->height >> 16);
+    ihdr[6] = (unsigned char) (r->height >> 8);
+    ihdr[7] = (unsigned char) r->height;
+    ihdr[8] = 8;
+    ihdr[9] = 6;
+    ok &= write_chunk_start(fp, "IHDR", sizeof(ihdr), &crc) == 0;
+    ok &= write_crc_bytes(fp, ihdr, sizeof(ihdr), &crc) == 0;
+    ok &= write_be32(fp, crc ^ 0xffffffffu, NULL) == 0;
+
+    /**
+     *  IDAT: the scanlines (each prefixed by filter type 0) cut
+     *  into stored blocks, wrapped in a zlib stream
+    **/
+    ok &= write_chunk_start(fp, "IDAT", (uint32_t) idat_bytes, &crc) == 0;
+    ok &= write_crc_bytes(fp, zlib_header, sizeof(zlib_header), &crc) == 0;
+
+    row_left = 0;
+    p_src = NULL;
+    for(done = 0; ok && done < raw_bytes; done += take)
+    {
+        take = raw_bytes - done < DEFLATE_STORED_MAX ? raw_bytes - done : DEFLATE_STORED_MAX;
+        block[0] = done + take == raw_bytes ? 1 : 0;
+        block[1] = (unsigned char) take;
+        block[2] = (unsigned char) (take >> 8);
+        block[3] = (unsigned char) ~take;
+        block[4] = (unsigned char) (~take >> 8);
+        ok &= write_crc_bytes(fp, block, sizeof(block), &crc) == 0;
+
+        for(i = 0; ok && i < take; i += n)
+        {
+            if(!row_left)
+            {   /* Start of a scanline: emit its filter byte */
+                ok &= write_crc_bytes(fp, &filter, 1, &crc) == 0;
+                adler32_update(&adler_a, &adler_b, &filter, 1);
+                p_src = (const unsigned char *) (p_pixels + (size_t) y++ * r->width);
+                row_left = row_bytes;
+                n = 1;
+                continue;
+            }
+
+            n = take - i < row_left ? take - i : row_left;
+            ok &= write_crc_bytes(fp, p_src, n, &crc) == 0;
+            adler32_update(&adler_a, &adler_b, p_src, n);
+            p_src += n;
+            row_left -= n;
+        }
+    }
+
+    ok &= write_be32(fp, (adler_b << 16) | adler_a, &crc) == 0;
+    ok &= write_be32(fp, crc ^ 0xffffffffu, NULL) == 0;
+
+    ok &= write_chunk_start(fp, "IEND", 0, &crc) == 0;
+    ok &= write_be32(fp, crc ^ 0xffffffffu, NULL) == 0;
+
+    if(fclose(fp) != 0)
+    {
+        ok = 0;
+    }
+
+    return ok ? 0 : -1;
+}
+
+#ifndef _WIN32
+
+/**
+ *  Writes full slots in the order they were filled, so the raw
+ *  stream keeps its frame order
+**/
+static void *writer_main(void *arg)
+{
+    spectrum_render *r = (spectrum_render *) arg;
+    spectrum_render_slot *p_slot;
+    int b_running, ok;
+    struct timespec ts;
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = SPECTRUM_RENDER_POLL_MS * 1000000L;
+
+    do
+    {
+        /* Read before draining, so a stop request still gets one full pass */
+        b_running = atomic_load(&r->b_running);
+
+        p_slot = &r->slots[r->write_slot];
+        while(atomic_load_explicit(&p_slot->state, memory_order_acquire) == SLOT_FULL)
+        {
+            ok = 1;
+            if(p_slot->b_raw)
+            {
+                ok &= write_raw_pixels(r, p_slot->p_pixels, r->raw_fp) == 0;
+            }
+            if(p_slot->b_png)
+            {
+                ok &= write_png_pixels(r, p_slot->p_pixels, r->png_path) == 0;
+            }
+            if(!ok)
+            {
+                atomic_fetch_add(&r->write_errors, 1);
+            }
+
+            atomic_store_explicit(&p_slot->state, SLOT_FREE, memory_order_release);
+            r->write_slot = (r->write_slot + 1) % SPECTRUM_RENDER_SLOTS;
+            p_slot = &r->slots[r->write_slot];
+        }
+
+        if(b_running)
+        {
+            nanosleep(&ts, NULL);
+        }
+    }
+    while(b_running);
+
+    return NULL;
+}
+
+#endif
+
+static uint32_t rgba
+(
+    unsigned char r
+    ,unsigned char g
+    ,unsigned char b
+    ,unsigned char a
+)
+{
+    const unsigned char bytes[4] = { r, g, b, a };
+    uint32_t value;
+
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+/**
+ *  Black -> blue -> red -> yellow -> white
+**/
+static void build_palette(uint32_t *palette)
+{
+    unsigned int i;
+    double t;
+
+    for(i = 0; i < 256; ++i)
+    {
+        t = i / 255.0;
+        palette[i] = rgba((unsigned char) (255.0 * (t < 0.33 ? 0.0 : (t < 0.66 ? (t - 0.33) / 0.33 : 1.0))),
+                          (unsigned char) (255.0 * (t < 0.66 ? 0.0 : (t - 0.66) / 0.34)),
+                          (unsigned char) (255.0 * (t < 0.33 ? t / 0.33 : (t < 0.66 ? (0.66 - t) / 0.33
+                                                                            : (t - 0.66) / 0.34))),
+                          255);
+    }
+}
+
+static uint32_t crc32_update
+(
+    uint32_t crc
+    ,const unsigned char *buf
+    ,size_t len
+)
+{
+    static uint32_t table[256];
+    static int b_table = 0;
+    uint32_t c;
+    unsigned int n, k;
+
+    if(!b_table)
+    {
+        for(n = 0; n < 256; ++n)
+        {
+            c = n;
+            for(k = 0; k < 8; ++k)
+            {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        b_table = 1;
+    }
+
+    while(len--)
+    {
+        crc = table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+/**
+ *  Sums are reduced every 5552 bytes, the most that cannot
+ *  overflow 32 bits
+**/
+static void adler32_update
+(
+    uint32_t *a
+    ,uint32_t *b
+    ,const unsigned char *buf
+    ,size_t len
+)
+{
+    size_t n;
+
+    while(len)
+    {
+        n = len < 5552 ? len : 5552;
+        len -= n;
+        while(n--)
+        {
+            *a += *buf++;
+            *b += *a;
+        }
+        *a %= 65521;
+        *b %= 65521;
+    }
+}
+
+/**
+ *  Length is not covered by the chunk CRC, the type is
+**/
+static int write_chunk_start
+(
+    FILE *fp
+    ,const char *type
+    ,uint32_t length
+    ,uint32_t *crc
+)
+{
+    if(write_be32(fp, length, NULL) < 0)
+    {
+        return -1;
+    }
+
+    *crc = 0xffffffffu;
+    return write_crc_bytes(fp, type, 4, crc);
+}
+
+static int write_crc_bytes
+(
+    FILE *fp
+    ,const void *buf
+    ,size_t len
+    ,uint32_t *crc
+)
+{
+    if(crc)
+    {
+        *crc = crc32_update(*crc, (const unsigned char *) buf, len);
+    }
+
+    return fwrite(buf, 1, len, fp) == len ? 0 : -1;
+}
+
+static int write_be32
+(
+    FILE *fp
+    ,uint32_t value
+    ,uint32_t *crc
+)
+{
+    unsigned char bytes[4];
+
+    bytes[0] = (unsigned char) (value >> 24);
+    bytes[1] = (unsigned char) (value >> 16);
+    bytes[2] = (unsigned char) (value >> 8);
+    bytes[3] = (unsigned char) value;
+
+    return write_crc_bytes(fp, bytes, sizeof(bytes), crc);
+}
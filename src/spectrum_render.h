@@ -0,0 +1,212 @@
+#ifndef SPECTRUM_RENDER_H
+#define SPECTRUM_RENDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ *  Finished images are handed to a writer thread through a
+ *  ring of this many slots, which it checks every
+ *  SPECTRUM_RENDER_POLL_MS.  With every slot still waiting to
+ *  be written an image is dropped and counted, so the audio
+ *  thread never waits for the disk
+**/
+#define SPECTRUM_RENDER_SLOTS       4
+#define SPECTRUM_RENDER_POLL_MS     5
+
+/** A composed image waiting for the writer, and what to write it as **/
+typedef struct
+{
+    uint32_t *p_pixels;
+    int b_raw;
+    int b_png;
+    atomic_int state;
+
+} spectrum_render_slot;
+
+typedef struct
+{
+    /**
+     * RGBA image, width * height pixels, 4 bytes each in
+     * R, G, B, A order.  The spectrum is drawn in the top
+     * spectrum_height rows, the waterfall fills the rest
+    **/
+    uint32_t *p_pixels;
+    unsigned int width;
+    unsigned int height;
+    unsigned int spectrum_height;
+
+    /**
+     * Waterfall history, newest row at wf_pos.  Kept as a
+     * ring so adding a row never moves the others
+    **/
+    uint32_t *p_waterfall;
+    unsigned int wf_height;
+    unsigned int wf_pos;
+
+    /**
+     * Axis ranges, matching the gnuplot window: log
+     * frequency from 20 Hz to 20 kHz, 0 to 100 dB
+    **/
+    double fmin;
+    double fmax;
+    double db_min;
+    double db_max;
+
+    /**
+     * Bins [p_col_lo[x], p_col_hi[x]) map to column x
+    **/
+    unsigned int *p_col_lo;
+    unsigned int *p_col_hi;
+    unsigned int fft_length;
+
+    /** Per column scratch: peak level and first filled row **/
+    double *p_col_level;
+    unsigned int *p_col_top;
+
+    /** Per column / per row grid flags **/
+    unsigned char *p_grid_col;
+    unsigned char *p_grid_row;
+
+    uint32_t palette[256];
+
+    /**
+     * Optional outputs, set with spectrum_render_start: a
+     * raw RGBA stream (e.g. a pipe to an encoder) fed every
+     * frame and a PNG rewritten every png_interval frames
+    **/
+    FILE *raw_fp;
+    const char *png_path;
+    unsigned int png_interval;
+    unsigned long frames;
+
+    /**
+     * Writer thread and its slots.  The audio thread fills
+     * slots in turn from fill_slot, the writer empties them
+     * in the same order from write_slot
+    **/
+    spectrum_render_slot slots[SPECTRUM_RENDER_SLOTS];
+    unsigned int fill_slot;
+    unsigned int write_slot;
+    void *p_thread;
+    atomic_int b_running;
+
+    unsigned long images_dropped;
+    atomic_ulong write_errors;
+
+} spectrum_render;
+
+/** ------------------------------------------
+ *  spectrum_render_init
+ *  ------------------------------------------
+ *      Allocates a width x height image for
+ *      spectra of fft_length bins (pcm_length
+ *      samples at samplerate).  The top
+ *      spectrum_height rows show the current
+ *      spectrum, the rest the waterfall.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int spectrum_render_init
+(
+    spectrum_render *r
+    ,unsigned int width
+    ,unsigned int height
+    ,unsigned int spectrum_height
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+);
+
+/** ------------------------------------------
+ *  spectrum_render_map
+ *  ------------------------------------------
+ *      Recomputes which bins feed each column
+ *      for a new pcm_length.  Does not
+ *      allocate, so it can run between
+ *      frames on the audio thread
+ *  ==========================================
+**/
+void spectrum_render_map
+(
+    spectrum_render *r
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+);
+
+/** ------------------------------------------
+ *  spectrum_render_start
+ *  ------------------------------------------
+ *      Starts the writer thread for a raw
+ *      stream (raw_fp, may be NULL) and a PNG
+ *      written every png_interval frames
+ *      (png_path, may be NULL).  Returns 0 on
+ *      success, -1 on failure
+ *  ==========================================
+**/
+int spectrum_render_start
+(
+    spectrum_render *r
+    ,FILE *raw_fp
+    ,const char *png_path
+    ,unsigned int png_interval
+);
+
+/** ------------------------------------------
+ *  spectrum_render_close
+ *  ------------------------------------------
+ *      Writes the images still queued, stops
+ *      the writer and frees the image.  Open
+ *      outputs belong to the caller
+ *  ==========================================
+**/
+void spectrum_render_close(spectrum_render *r);
+
+/** ----------------------------------------------------
+ *  spectrum_render_frame
+ *  ----------------------------------------------------
+ *      Draws one magnitude frame (dB) into the
+ *      spectrum area and pushes a waterfall row.
+ *      When an output is due the image is composed
+ *      into a free slot for the writer thread; no
+ *      file is touched on the calling thread
+ *  ====================================================
+**/
+void spectrum_render_frame
+(
+    spectrum_render *r
+    ,const double *p_mag
+    ,unsigned int length
+);
+
+/** ----------------------------------------------------
+ *  spectrum_render_compose
+ *  ----------------------------------------------------
+ *      Copies the waterfall ring, newest row first,
+ *      below the spectrum so p_pixels is complete.
+ *      The writers below call this themselves, and
+ *      like them it must not run concurrently with
+ *      spectrum_render_frame
+ *  ====================================================
+**/
+void spectrum_render_compose(spectrum_render *r);
+
+/** ----------------------------------------------------
+ *  spectrum_render_write_png
+ *  ----------------------------------------------------
+ *      Writes the image as an uncompressed PNG.
+ *      Returns 0 on success, -1 on failure
+ *  ====================================================
+**/
+int spectrum_render_write_png(spectrum_render *r, const char *path);
+
+/** ----------------------------------------------------
+ *  spectrum_render_write_raw
+ *  ----------------------------------------------------
+ *      Appends the image as width * height * 4 bytes
+ *      of RGBA.  Returns 0 on success, -1 on failure
+ *  ====================================================
+**/
+int spectrum_render_write_raw(spectrum_render *r, FILE *fp);
+
+#endif
@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "spectrum_shm.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Slots start on cache line boundaries so frames never share lines */
+#define SPECTRUM_SHM_ALIGN  64
+
+#define ALIGN_UP(x) (((x) + SPECTRUM_SHM_ALIGN - 1) & ~(size_t) (SPECTRUM_SHM_ALIGN - 1))
+
+/* ------------------------ Function Prototypes --------------------------- */
+static spectrum_shm_slot *get_slot(const spectrum_shm *shm, uint64_t frame);
+/* ------------------------------------------------------------------------ */
+
+
+int spectrum_shm_create
+(
+    spectrum_shm *shm
+    ,const char *name
+    ,unsigned int bins
+    ,unsigned int num_slots
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+)
+{
+    int fd;
+    size_t slot_offset, slot_bytes;
+    spectrum_shm_header *p_header;
+
+    if(!shm || !name || !bins || !num_slots || strlen(name) >= sizeof(shm->name))
+    {
+        return -1;
+    }
+
+    memset(shm, 0, sizeof(*shm));
+
+    slot_offset = ALIGN_UP(sizeof(spectrum_shm_header));
+    slot_bytes = ALIGN_UP(sizeof(spectrum_shm_slot) + sizeof(float) * bins);
+    shm->map_bytes = slot_offset + slot_bytes * num_slots;
+
+    /* Readers still mapping an old segment keep their copy */
+    shm_unlink(name);
+
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0)
+    {
+        return -1;
+    }
+
+    if(ftruncate(fd, (off_t) shm->map_bytes) < 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    p_header = (spectrum_shm_header *) mmap(NULL, shm->map_bytes, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(p_header == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return -1;
+    }
+
+    /* ftruncate zero fills, so every slot starts with sequence 0 */
+    p_header->version = SPECTRUM_SHM_VERSION;
+    p_header->slot_offset = (uint32_t) slot_offset;
+    p_header->slot_bytes = (uint32_t) slot_bytes;
+    p_header->num_slots = num_slots;
+    p_header->bins = bins;
+    p_header->samplerate = samplerate;
+    p_header->pcm_length = pcm_length;
+    atomic_store_explicit(&p_header->frames_written, 0, memory_order_relaxed);
+
+    /* Magic last: a reader seeing it also sees a complete header */
+    atomic_store_explicit(&p_header->magic, SPECTRUM_SHM_MAGIC, memory_order_release);
+
+    strcpy(shm->name, name);
+    shm->is_writer = 1;
+    shm->p_header = p_header;
+
+    return 0;
+}
+
+int spectrum_shm_attach(spectrum_shm *shm, const char *name)
+{
+    int fd;
+    struct stat st;
+    spectrum_shm_header *p_header;
+
+    if(!shm || !name || strlen(name) >= sizeof(shm->name))
+    {
+        return -1;
+    }
+
+    memset(shm, 0, sizeof(*shm));
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0)
+    {
+        return -1;
+    }
+
+    if(fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(spectrum_shm_header))
+    {
+        close(fd);
+        return -1;
+    }
+
+    p_header = (spectrum_shm_header *) mmap(NULL, (size_t) st.st_size, PROT_READ,
+                                            MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(p_header == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    /* Acquire pairs with the creator's release, so the header below is complete */
+    if(atomic_load_explicit(&p_header->magic, memory_order_acquire) != SPECTRUM_SHM_MAGIC
+       || p_header->version != SPECTRUM_SHM_VERSION
+       || (size_t) p_header->slot_offset + (size_t) p_header->slot_bytes * p_header->num_slots
+          > (size_t) st.st_size)
+    {
+        munmap(p_header, (size_t) st.st_size);
+        return -1;
+    }
+
+    strcpy(shm->name, name);
+    shm->map_bytes = (size_t) st.st_size;
+    shm->p_header = p_header;
+
+    return 0;
+}
+
+void spectrum_shm_close(spectrum_shm *shm)
+{
+    if(!shm || !shm->p_header)
+    {
+        return;
+    }
+
+    munmap(shm->p_header, shm->map_bytes);
+
+    if(shm->is_writer)
+    {
+        shm_unlink(shm->name);
+    }
+
+    shm->p_header = NULL;
+}
+
+void spectrum_shm_publish
+(
+    spectrum_shm *shm
+    ,const double *p_mag
+    ,unsigned int length
+)
+{
+    unsigned int i;
+    struct timespec ts;
+    spectrum_shm_header *p_header = shm->p_header;
+    uint64_t frame = atomic_load_explicit(&p_header->frames_written, memory_order_relaxed);
+    spectrum_shm_slot *slot = get_slot(shm, frame);
+    float *p_data = (float *) (slot + 1);
+
+    if(length > p_header->bins)
+    {
+        length = p_header->bins;
+    }
+
+    /* Odd sequence: readers of this slot will retry or give up */
+    atomic_store_explicit(&slot->sequence, 2 * frame + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    slot->timestamp_ns = (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+
+    for(i = 0; i < length; ++i)
+    {
+        p_data[i] = (float) p_mag[i];
+    }
+
+    atomic_store_explicit(&slot->sequence, 2 * frame + 2, memory_order_release);
+    atomic_store_explicit(&p_header->frames_written, frame + 1, memory_order_release);
+}
+
+const float *spectrum_shm_frame(const spectrum_shm *shm, uint64_t frame)
+{
+    spectrum_shm_slot *slot = get_slot(shm, frame);
+
+    if(atomic_load_explicit(&slot->sequence, memory_order_acquire) != 2 * frame + 2)
+    {
+        return NULL;
+    }
+
+    return (const float *) (slot + 1);
+}
+
+int spectrum_shm_valid(const spectrum_shm *shm, uint64_t frame)
+{
+    spectrum_shm_slot *slot = get_slot(shm, frame);
+
+    /* Order the caller's reads of the data before the re-check */
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&slot->sequence, memory_order_relaxed) == 2 * frame + 2;
+}
+
+int64_t spectrum_shm_read(const spectrum_shm *shm, float *p_out)
+{
+    uint64_t written, frame;
+    const float *p_data;
+
+    for(;;)
+    {
+        written = atomic_load_explicit(&shm->p_header->frames_written, memory_order_acquire);
+        if(!written)
+        {
+            return -1;
+        }
+
+        frame = written - 1;
+        p_data = spectrum_shm_frame(shm, frame);
+        if(!p_data)
+        {   /* Writer already lapped us, start over from the newest */
+            continue;
+        }
+
+        memcpy(p_out, p_data, sizeof(float) * shm->p_header->bins);
+
+        if(spectrum_shm_valid(shm, frame))
+        {
+            return (int64_t) frame;
+        }
+    }
+}
+
+static spectrum_shm_slot *get_slot(const spectrum_shm *shm, uint64_t frame)
+{
+    const spectrum_shm_header *p_header = shm->p_header;
+
+    return (spectrum_shm_slot *) ((unsigned char *) p_header + p_header->slot_offset
+                                  + (size_t) p_header->slot_bytes * (frame % p_header->num_slots));
+}
+
+#else
+
+/* POSIX shared memory only */
+int spectrum_shm_create(spectrum_shm *shm, const char *name, unsigned int bins,
+                        unsigned int num_slots, unsigned int samplerate, unsigned int pcm_length)
+{
+    (void) shm; (void) name; (void) bins; (void) num_slots; (void) samplerate; (void) pcm_length;
+    return -1;
+}
+
+int spectrum_shm_attach(spectrum_shm *shm, const char *name)
+{
+    (void) shm; (void) name;
+    return -1;
+}
+
+void spectrum_shm_close(spectrum_shm *shm) { (void) shm; }
+
+void spectrum_shm_publish(spectrum_shm *shm, const double *p_mag, unsigned int length)
+{
+    (void) shm; (void) p_mag; (void) length;
+}
+
+const float *spectrum_shm_frame(const spectrum_shm *shm, uint64_t frame)
+{
+    (void) shm; (void) frame;
+    return NULL;
+}
+
+int spectrum_shm_valid(const spectrum_shm *shm, uint64_t frame)
+{
+    (void) shm; (void) frame;
+    return 0;
+}
+
+int64_t spectrum_shm_read(const spectrum_shm *shm, float *p_out)
+{
+    (void) shm; (void) p_out;
+    return -1;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,142 @@
+#ifndef SPECTRUM_SHM_H
+#define SPECTRUM_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ *  Shared memory layout, version 1
+ *
+ *      [ spectrum_shm_header ][ slot 0 ][ slot 1 ] ... [ slot n-1 ]
+ *
+ *  Every slot is a spectrum_shm_slot followed by `bins` float32
+ *  magnitudes in dB.  Frame f is written to slot f % num_slots.
+ *  A slot's sequence is odd while the writer is inside it and
+ *  2 * f + 2 once frame f is complete, so readers detect torn
+ *  reads without ever taking a lock.
+**/
+#define SPECTRUM_SHM_MAGIC      0x4d485346u /* "FSHM" */
+#define SPECTRUM_SHM_VERSION    1
+
+typedef struct
+{
+    /** Stored last with release order once the rest of the header is set **/
+    _Atomic uint32_t magic;
+    uint32_t version;
+
+    /** Offset of slot 0 and distance between slots, in bytes **/
+    uint32_t slot_offset;
+    uint32_t slot_bytes;
+
+    uint32_t num_slots;
+    uint32_t bins;
+    uint32_t samplerate;
+    uint32_t pcm_length;
+
+    /** Number of frames completed so far **/
+    _Atomic uint64_t frames_written;
+
+} spectrum_shm_header;
+
+typedef struct
+{
+    _Atomic uint64_t sequence;
+    /** CLOCK_MONOTONIC time the frame was written, in ns **/
+    uint64_t timestamp_ns;
+
+} spectrum_shm_slot;
+
+typedef struct
+{
+    char name[64];
+    int is_writer;
+    size_t map_bytes;
+    spectrum_shm_header *p_header;
+
+} spectrum_shm;
+
+/** ------------------------------------------
+ *  spectrum_shm_create
+ *  ------------------------------------------
+ *      Creates (or replaces) the POSIX shared
+ *      memory object name, e.g. "/fft_block",
+ *      holding num_slots frames of bins values.
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int spectrum_shm_create
+(
+    spectrum_shm *shm
+    ,const char *name
+    ,unsigned int bins
+    ,unsigned int num_slots
+    ,unsigned int samplerate
+    ,unsigned int pcm_length
+);
+
+/** ------------------------------------------
+ *  spectrum_shm_attach
+ *  ------------------------------------------
+ *      Maps an existing segment read only.
+ *      Returns 0 on success, -1 if it does not
+ *      exist or has an unknown layout
+ *  ==========================================
+**/
+int spectrum_shm_attach(spectrum_shm *shm, const char *name);
+
+/** ------------------------------------------
+ *  spectrum_shm_close
+ *  ------------------------------------------
+ *      Unmaps the segment.  The writer also
+ *      removes the name
+ *  ==========================================
+**/
+void spectrum_shm_close(spectrum_shm *shm);
+
+/** ----------------------------------------------------
+ *  spectrum_shm_publish
+ *  ----------------------------------------------------
+ *      Writer side.  Stores the next frame, narrowing
+ *      the magnitudes to float32.  Never blocks
+ *  ====================================================
+**/
+void spectrum_shm_publish
+(
+    spectrum_shm *shm
+    ,const double *p_mag
+    ,unsigned int length
+);
+
+/** ----------------------------------------------------
+ *  spectrum_shm_frame
+ *  ----------------------------------------------------
+ *      Reader side, zero copy.  Returns a pointer to
+ *      frame's magnitudes inside the mapping, or NULL
+ *      if the frame is not (or no longer) in the ring.
+ *      The data must be checked with
+ *      spectrum_shm_valid after it has been used
+ *  ====================================================
+**/
+const float *spectrum_shm_frame(const spectrum_shm *shm, uint64_t frame);
+
+/** ----------------------------------------------------
+ *  spectrum_shm_valid
+ *  ----------------------------------------------------
+ *      Returns 1 if frame was not overwritten while
+ *      it was being read, 0 otherwise
+ *  ====================================================
+**/
+int spectrum_shm_valid(const spectrum_shm *shm, uint64_t frame);
+
+/** ----------------------------------------------------
+ *  spectrum_shm_read
+ *  ----------------------------------------------------
+ *      Reader side helper that copies the newest frame
+ *      to p_out (bins values).  Returns its frame
+ *      number, or -1 if nothing was written yet
+ *  ====================================================
+**/
+int64_t spectrum_shm_read(const spectrum_shm *shm, float *p_out);
+
+#endif
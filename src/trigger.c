@@ -0,0 +1,484 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "trigger.h"
+
+#ifndef _WIN32
+
+#include <pthread.h>
+#include <time.h>
+
+enum
+{
+    SLOT_FREE   = 0,
+    SLOT_FULL   = 1
+};
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void hand_over(trigger_engine *trig);
+static int check_condition(trigger_engine *trig, unsigned int c, const double *p_db, unsigned int bins,
+                           double bin_hz, double *p_value);
+static void *writer_main(void *arg);
+static int write_slot(const trigger_engine *trig, const trigger_slot *slot);
+/* ------------------------------------------------------------------------ */
+
+
+void trigger_default_config(trigger_config *config, unsigned int samplerate, unsigned int bins)
+{
+    memset(config, 0, sizeof(*config));
+    config->samplerate = samplerate;
+    config->bins = bins;
+    config->frame_hop = bins;
+    config->pre_samples = samplerate;
+    config->post_samples = samplerate;
+    config->max_block = 4096;
+    config->average_frames = 50;
+    config->num_slots = 4;
+    config->directory = ".";
+}
+
+int trigger_add_condition
+(
+    trigger_config *config
+    ,trigger_kind kind
+    ,double lo_hz
+    ,double hi_hz
+    ,double threshold_db
+)
+{
+    trigger_condition *c;
+
+    if(config->num_conditions == TRIGGER_MAX_CONDITIONS)
+    {
+        return -1;
+    }
+
+    c = &config->conditions[config->num_conditions++];
+    c->kind = kind;
+    c->lo_hz = lo_hz;
+    c->hi_hz = hi_hz;
+    c->threshold_db = threshold_db;
+
+    return 0;
+}
+
+int trigger_init(trigger_engine *trig, const trigger_config *config)
+{
+    unsigned int i;
+    unsigned long capacity = 1;
+    const unsigned long span = config->pre_samples + config->post_samples;
+
+    if(!trig || !config || !config->samplerate || !config->bins || !config->frame_hop
+       || !span || !config->max_block || !config->num_slots || !config->directory)
+    {
+        return -1;
+    }
+
+    memset(trig, 0, sizeof(*trig));
+    trig->config = *config;
+    if(!trig->config.average_frames)
+    {
+        trig->config.average_frames = 1;
+    }
+
+    /* An event is handed over at most one block after it ends */
+    while(capacity < span + config->max_block)
+    {
+        capacity <<= 1;
+    }
+    trig->ring_mask = capacity - 1;
+    trig->frame_capacity = (unsigned int) (capacity / config->frame_hop) + 2;
+    trig->slot_frames = (unsigned int) (span / config->frame_hop) + 2;
+
+    trig->p_ring = (float *) calloc(capacity, sizeof(float));
+    trig->p_frame_pos = (uint64_t *) calloc(trig->frame_capacity, sizeof(uint64_t));
+    trig->p_frame_db = (float *) malloc(sizeof(float) * trig->frame_capacity * config->bins);
+    trig->p_slots = (trigger_slot *) calloc(config->num_slots, sizeof(trigger_slot));
+    trig->p_thread = malloc(sizeof(pthread_t));
+    if(!trig->p_ring || !trig->p_frame_pos || !trig->p_frame_db || !trig->p_slots || !trig->p_thread)
+    {
+        trigger_close(trig);
+        return -1;
+    }
+
+    for(i = 0; i < config->num_slots; ++i)
+    {
+        atomic_init(&trig->p_slots[i].state, SLOT_FREE);
+        trig->p_slots[i].p_samples = (float *) malloc(sizeof(float) * span);
+        trig->p_slots[i].p_positions = (uint64_t *) malloc(sizeof(uint64_t) * trig->slot_frames);
+        trig->p_slots[i].p_frames = (float *) malloc(sizeof(float) * trig->slot_frames * config->bins);
+        if(!trig->p_slots[i].p_samples || !trig->p_slots[i].p_positions || !trig->p_slots[i].p_frames)
+        {
+            trigger_close(trig);
+            return -1;
+        }
+    }
+
+    atomic_store(&trig->b_running, 1);
+    if(pthread_create((pthread_t *) trig->p_thread, NULL, writer_main, trig))
+    {
+        atomic_store(&trig->b_running, 0);
+        trigger_close(trig);
+        return -1;
+    }
+
+    return 0;
+}
+
+void trigger_stop(trigger_engine *trig)
+{
+    /* The writer drains full slots before it exits */
+    if(atomic_exchange(&trig->b_running, 0))
+    {
+        pthread_join(*(pthread_t *) trig->p_thread, NULL);
+    }
+}
+
+void trigger_close(trigger_engine *trig)
+{
+    unsigned int i;
+
+    if(!trig)
+    {
+        return;
+    }
+
+    trigger_stop(trig);
+
+    if(trig->p_slots)
+    {
+        for(i = 0; i < trig->config.num_slots; ++i)
+        {
+            free(trig->p_slots[i].p_samples);
+            free(trig->p_slots[i].p_positions);
+            free(trig->p_slots[i].p_frames);
+        }
+    }
+
+    free(trig->p_ring);
+    free(trig->p_frame_pos);
+    free(trig->p_frame_db);
+    free(trig->p_slots);
+    free(trig->p_thread);
+    memset(trig, 0, sizeof(*trig));
+}
+
+void trigger_push(trigger_engine *trig, const float *samples, unsigned long n)
+{
+    unsigned long take, at, first;
+
+    while(n)
+    {
+        if(trig->b_pending && trig->written >= trig->event_end)
+        {
+            hand_over(trig);
+        }
+
+        take = n < trig->config.max_block ? n : trig->config.max_block;
+        at = (unsigned long) (trig->written & trig->ring_mask);
+        first = take < trig->ring_mask + 1 - at ? take : trig->ring_mask + 1 - at;
+
+        memcpy(trig->p_ring + at, samples, sizeof(float) * first);
+        memcpy(trig->p_ring, samples + first, sizeof(float) * (take - first));
+
+        trig->written += take;
+        samples += take;
+        n -= take;
+    }
+}
+
+int trigger_frame
+(
+    trigger_engine *trig
+    ,const double *p_db
+    ,unsigned int bins
+    ,double bin_hz
+    ,uint64_t position
+)
+{
+    unsigned int c, k, fired = 0;
+    double value, fired_value = 0.0;
+    float *p_row;
+    struct timespec ts;
+
+    /* Spectra of another length (after a switch) are not kept */
+    if(bins != trig->config.bins)
+    {
+        return 0;
+    }
+
+    k = (unsigned int) (trig->frames % trig->frame_capacity);
+    trig->p_frame_pos[k] = position;
+    p_row = trig->p_frame_db + (size_t) k * bins;
+    for(k = 0; k < bins; ++k)
+    {
+        p_row[k] = (float) p_db[k];
+    }
+    ++trig->frames;
+
+    /* Every condition runs every frame so the averages keep up */
+    for(c = 0; c < trig->config.num_conditions; ++c)
+    {
+        if(check_condition(trig, c, p_db, bins, bin_hz, &value) && !fired)
+        {
+            fired = c + 1;
+            fired_value = value;
+        }
+    }
+
+    if(!fired || trig->b_pending || position < trig->rearm_at)
+    {
+        return 0;
+    }
+
+    trig->b_pending = 1;
+    trig->event_start = position > trig->config.pre_samples ? position - trig->config.pre_samples : 0;
+    trig->event_end = position + trig->config.post_samples;
+    ++trig->events_fired;
+
+    memset(&trig->pending, 0, sizeof(trig->pending));
+    trig->pending.magic = TRIGGER_EVENT_MAGIC;
+    trig->pending.version = TRIGGER_EVENT_VERSION;
+    trig->pending.samplerate = trig->config.samplerate;
+    trig->pending.bins = bins;
+    trig->pending.sequence = trig->sequence++;
+    trig->pending.pre_samples = position - trig->event_start;
+    trig->pending.condition = fired - 1;
+    trig->pending.value_db = (float) fired_value;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    trig->pending.trigger_ns = (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+
+    return 1;
+}
+
+/**
+ *  Copy the finished event out of the rings into a free slot
+ *  for the writer.  Called once written has reached event_end,
+ *  so its samples and frames are all in and none overwritten
+**/
+static void hand_over(trigger_engine *trig)
+{
+    unsigned int i, k;
+    uint64_t f, pos, oldest;
+    unsigned long at, first, num_samples;
+    trigger_slot *slot = NULL;
+    const unsigned int bins = trig->config.bins;
+
+    trig->b_pending = 0;
+    trig->rearm_at = trig->event_end + (uint64_t) trig->config.holdoff_frames * trig->config.frame_hop;
+
+    for(i = 0; i < trig->config.num_slots; ++i)
+    {
+        if(atomic_load_explicit(&trig->p_slots[i].state, memory_order_acquire) == SLOT_FREE)
+        {
+            slot = &trig->p_slots[i];
+            break;
+        }
+    }
+    /* A block longer than max_block may already have overwritten the pre-trigger samples */
+    if(!slot || trig->written - trig->event_start > trig->ring_mask + 1)
+    {
+        ++trig->events_dropped;
+        return;
+    }
+
+    slot->header = trig->pending;
+    num_samples = (unsigned long) (trig->event_end - trig->event_start);
+    slot->header.num_samples = num_samples;
+
+    at = (unsigned long) (trig->event_start & trig->ring_mask);
+    first = num_samples < trig->ring_mask + 1 - at ? num_samples : trig->ring_mask + 1 - at;
+    memcpy(slot->p_samples, trig->p_ring + at, sizeof(float) * first);
+    memcpy(slot->p_samples + first, trig->p_ring, sizeof(float) * (num_samples - first));
+
+    oldest = trig->frames > trig->frame_capacity ? trig->frames - trig->frame_capacity : 0;
+    for(f = oldest; f < trig->frames && slot->header.num_frames < trig->slot_frames; ++f)
+    {
+        k = (unsigned int) (f % trig->frame_capacity);
+        pos = trig->p_frame_pos[k];
+        if(pos > trig->event_start && pos <= trig->event_end)
+        {
+            slot->p_positions[slot->header.num_frames] = pos - trig->event_start;
+            memcpy(slot->p_frames + (size_t) slot->header.num_frames * bins,
+                   trig->p_frame_db + (size_t) k * bins, sizeof(float) * bins);
+            ++slot->header.num_frames;
+        }
+    }
+
+    atomic_store_explicit(&slot->state, SLOT_FULL, memory_order_release);
+}
+
+static int check_condition
+(
+    trigger_engine *trig
+    ,unsigned int c
+    ,const double *p_db
+    ,unsigned int bins
+    ,double bin_hz
+    ,double *p_value
+)
+{
+    unsigned int k, lo, hi;
+    double sum, e;
+    const trigger_condition *cond = &trig->config.conditions[c];
+
+    lo = (unsigned int) ceil(cond->lo_hz / bin_hz);
+    hi = cond->hi_hz / bin_hz < bins - 1 ? (unsigned int) (cond->hi_hz / bin_hz) : bins - 1;
+    if(lo > hi)
+    {
+        return 0;
+    }
+
+    if(cond->kind == TRIGGER_LEVEL)
+    {
+        for(*p_value = p_db[lo], k = lo + 1; k <= hi; ++k)
+        {
+            *p_value = p_db[k] > *p_value ? p_db[k] : *p_value;
+        }
+        return *p_value >= cond->threshold_db;
+    }
+
+    /* Band power from dB magnitudes, floored so silence stays finite */
+    for(sum = 0.0, k = lo; k <= hi; ++k)
+    {
+        sum += pow(10.0, p_db[k] / 10.0);
+    }
+    e = sum > 1e-30 ? 10.0 * log10(sum) : -300.0;
+
+    if(!trig->b_average_valid[c])
+    {
+        trig->average_db[c] = e;
+        trig->b_average_valid[c] = 1;
+        return 0;
+    }
+
+    *p_value = e - trig->average_db[c];
+    trig->average_db[c] += *p_value / trig->config.average_frames;
+
+    return fabs(*p_value) >= cond->threshold_db;
+}
+
+/* -------------------------------- writer -------------------------------- */
+
+static void *writer_main(void *arg)
+{
+    trigger_engine *trig = (trigger_engine *) arg;
+    unsigned int i, found;
+    int b_running;
+    struct timespec ts;
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = TRIGGER_WRITER_POLL_MS * 1000000L;
+
+    do
+    {
+        /* Read before scanning, so a stop request still gets one full pass */
+        b_running = atomic_load(&trig->b_running);
+
+        for(found = 0, i = 0; i < trig->config.num_slots; ++i)
+        {
+            if(atomic_load_explicit(&trig->p_slots[i].state, memory_order_acquire) == SLOT_FULL)
+            {
+                if(write_slot(trig, &trig->p_slots[i]) < 0)
+                {
+                    atomic_fetch_add(&trig->write_errors, 1);
+                }
+                else
+                {
+                    atomic_fetch_add(&trig->events_written, 1);
+                }
+                atomic_store_explicit(&trig->p_slots[i].state, SLOT_FREE, memory_order_release);
+                found = 1;
+            }
+        }
+
+        if(!found && b_running)
+        {
+            nanosleep(&ts, NULL);
+        }
+    }
+    while(b_running);
+
+    return NULL;
+}
+
+static int write_slot(const trigger_engine *trig, const trigger_slot *slot)
+{
+    char path[1024];
+    FILE *fp;
+    uint64_t f;
+    int result = 0;
+    const trigger_event_header *h = &slot->header;
+
+    snprintf(path, sizeof(path), "%s/event_%06llu.trg", trig->config.directory, (unsigned long long) h->sequence);
+
+    fp = fopen(path, "wb");
+    if(!fp)
+    {
+        return -1;
+    }
+
+    if(fwrite(h, sizeof(*h), 1, fp) != 1
+       || fwrite(slot->p_samples, sizeof(float), (size_t) h->num_samples, fp) != h->num_samples)
+    {
+        result = -1;
+    }
+
+    for(f = 0; f < h->num_frames && result == 0; ++f)
+    {
+        if(fwrite(&slot->p_positions[f], sizeof(uint64_t), 1, fp) != 1
+           || fwrite(slot->p_frames + f * h->bins, sizeof(float), h->bins, fp) != h->bins)
+        {
+            result = -1;
+        }
+    }
+
+    if(fclose(fp) != 0)
+    {
+        result = -1;
+    }
+
+    return result;
+}
+
+#else /* _WIN32 */
+
+/* Needs POSIX threads for the writer */
+
+void trigger_default_config(trigger_config *config, unsigned int samplerate, unsigned int bins)
+{
+    memset(config, 0, sizeof(*config));
+    config->samplerate = samplerate;
+    config->bins = bins;
+}
+
+int trigger_add_condition(trigger_config *config, trigger_kind kind, double lo_hz, double hi_hz, double threshold_db)
+{
+    (void) config; (void) kind; (void) lo_hz; (void) hi_hz; (void) threshold_db;
+    return -1;
+}
+
+int trigger_init(trigger_engine *trig, const trigger_config *config)
+{
+    (void) trig; (void) config;
+    return -1;
+}
+
+void trigger_stop(trigger_engine *trig) { (void) trig; }
+void trigger_close(trigger_engine *trig) { (void) trig; }
+
+void trigger_push(trigger_engine *trig, const float *samples, unsigned long n)
+{
+    (void) trig; (void) samples; (void) n;
+}
+
+int trigger_frame(trigger_engine *trig, const double *p_db, unsigned int bins, double bin_hz, uint64_t position)
+{
+    (void) trig; (void) p_db; (void) bins; (void) bin_hz; (void) position;
+    return 0;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,245 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ *  Event triggered capture.
+ *
+ *  Raw samples go into an always running ring, and every
+ *  spectrum frame into a ring of frames.  Each frame is checked
+ *  against the conditions; when one holds, the pre_samples
+ *  before the frame and the post_samples after it, with the
+ *  frames inside that span, are copied into a free event slot
+ *  once the post window has gone by.  A writer thread saves full
+ *  slots to <directory>/event_<n>.trg and frees them, so the
+ *  audio thread never waits for the disk.  With every slot
+ *  still being written an event is dropped and counted.
+ *
+ *  Event file, version 1, host byte order:
+ *
+ *      [ trigger_event_header ]
+ *      [ num_samples float32 samples ]
+ *      [ num_frames x (uint64 position, bins float32 dB) ]
+ *
+ *  Positions count samples from the start of the event; the
+ *  trigger frame ends at pre_samples.
+**/
+#define TRIGGER_EVENT_MAGIC     0x31475254u /* "TRG1" */
+#define TRIGGER_EVENT_VERSION   1
+
+#define TRIGGER_MAX_CONDITIONS  8
+
+/* How often the writer looks for full slots */
+#define TRIGGER_WRITER_POLL_MS  20
+
+typedef enum
+{
+    /** Loudest bin in the band at or above threshold_db **/
+    TRIGGER_LEVEL       = 0,
+    /**
+     * Band energy at least threshold_db above or below its
+     * running average over average_frames frames
+    **/
+    TRIGGER_BAND_CHANGE = 1
+
+} trigger_kind;
+
+typedef struct
+{
+    trigger_kind kind;
+    double lo_hz;
+    double hi_hz;
+    double threshold_db;
+
+} trigger_condition;
+
+typedef struct
+{
+    unsigned int samplerate;
+    unsigned int bins;
+    /** Samples between spectrum frames, to size the frame ring **/
+    unsigned int frame_hop;
+
+    unsigned long pre_samples;
+    unsigned long post_samples;
+    /**
+     * Largest block passed to trigger_push at once, which
+     * sizes the raw ring.  Must cover the caller's whole
+     * block: spectra of a block arrive after it was pushed
+    **/
+    unsigned long max_block;
+
+    trigger_condition conditions[TRIGGER_MAX_CONDITIONS];
+    unsigned int num_conditions;
+    unsigned int average_frames;
+    /** Frames to stay quiet after an event completes **/
+    unsigned int holdoff_frames;
+
+    unsigned int num_slots;
+    const char *directory;
+
+} trigger_config;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t samplerate;
+    uint32_t bins;
+    uint64_t sequence;
+    /** Wall clock time of the trigger frame, ns since the epoch **/
+    uint64_t trigger_ns;
+    uint64_t pre_samples;
+    uint64_t num_samples;
+    uint64_t num_frames;
+    /** Index of the condition that fired and its value in dB **/
+    uint32_t condition;
+    float value_db;
+
+} trigger_event_header;
+
+/** A preallocated event, owned by the audio thread while FREE **/
+typedef struct
+{
+    atomic_int state;
+    trigger_event_header header;
+    float *p_samples;
+    uint64_t *p_positions;
+    float *p_frames;
+
+} trigger_slot;
+
+typedef struct
+{
+    trigger_config config;
+
+    /** Raw ring, a power of two long, and samples written so far **/
+    float *p_ring;
+    unsigned long ring_mask;
+    uint64_t written;
+
+    /** Frame ring: end positions and bins dB values per frame **/
+    uint64_t *p_frame_pos;
+    float *p_frame_db;
+    unsigned int frame_capacity;
+    uint64_t frames;
+
+    /** Running band energies for TRIGGER_BAND_CHANGE **/
+    double average_db[TRIGGER_MAX_CONDITIONS];
+    int b_average_valid[TRIGGER_MAX_CONDITIONS];
+
+    /**
+     * Event in progress: sample span [event_start, event_end)
+     * and the header it will be written with.  Triggers are
+     * ignored until written passes rearm_at
+    **/
+    int b_pending;
+    uint64_t event_start;
+    uint64_t event_end;
+    uint64_t rearm_at;
+    trigger_event_header pending;
+
+    /** Slots hold up to slot_frames frames **/
+    trigger_slot *p_slots;
+    unsigned int slot_frames;
+    uint64_t sequence;
+
+    void *p_thread;
+    atomic_int b_running;
+
+    unsigned long events_fired;
+    unsigned long events_dropped;
+    atomic_ulong events_written;
+    atomic_ulong write_errors;
+
+} trigger_engine;
+
+/** ------------------------------------------
+ *  trigger_default_config
+ *  ------------------------------------------
+ *      1 s before and after, frames taken
+ *      as bins samples apart (ample for a real
+ *      transform), no conditions, 4 slots
+ *      written to the current directory
+ *  ==========================================
+**/
+void trigger_default_config(trigger_config *config, unsigned int samplerate, unsigned int bins);
+
+/** ------------------------------------------
+ *  trigger_add_condition
+ *  ------------------------------------------
+ *      Returns 0, or -1 when full
+ *  ==========================================
+**/
+int trigger_add_condition
+(
+    trigger_config *config
+    ,trigger_kind kind
+    ,double lo_hz
+    ,double hi_hz
+    ,double threshold_db
+);
+
+/** ------------------------------------------
+ *  trigger_init
+ *  ------------------------------------------
+ *      Allocates the rings and slots and starts
+ *      the writer.  Returns 0 on success, -1
+ *      on failure
+ *  ==========================================
+**/
+int trigger_init(trigger_engine *trig, const trigger_config *config);
+
+/** ------------------------------------------
+ *  trigger_stop
+ *  ------------------------------------------
+ *      Stops the writer after it has saved
+ *      every full slot, leaving the counters
+ *      final.  An event still collecting its
+ *      post window is lost
+ *  ==========================================
+**/
+void trigger_stop(trigger_engine *trig);
+
+/** ------------------------------------------
+ *  trigger_close
+ *  ------------------------------------------
+ *      Stops the writer if need be and frees
+ *      everything
+ *  ==========================================
+**/
+void trigger_close(trigger_engine *trig);
+
+/** ----------------------------------------------------
+ *  trigger_push
+ *  ----------------------------------------------------
+ *      Appends raw samples to the ring, first handing
+ *      over an event whose post window has completed.
+ *      Blocks longer than max_block are taken in
+ *      pieces; an event whose pre-trigger samples they
+ *      overwrote is dropped and counted, not written
+ *  ====================================================
+**/
+void trigger_push(trigger_engine *trig, const float *samples, unsigned long n);
+
+/** ----------------------------------------------------
+ *  trigger_frame
+ *  ----------------------------------------------------
+ *      Records one spectrum of bins dB values, bin_hz
+ *      apart, whose newest sample is at position (a
+ *      count of pushed samples) and checks the
+ *      conditions.  Returns 1 if it fired, else 0
+ *  ====================================================
+**/
+int trigger_frame
+(
+    trigger_engine *trig
+    ,const double *p_db
+    ,unsigned int bins
+    ,double bin_hz
+    ,uint64_t position
+);
+
+#endif
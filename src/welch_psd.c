@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "welch_psd.h"
+
+/* Keeps log10 finite for empty bins */
+#define WELCH_PSD_FLOOR     1e-30
+
+/* ------------------------ Function Prototypes --------------------------- */
+static void welch_psd_segment(welch_psd *psd);
+/* ------------------------------------------------------------------------ */
+
+
+int welch_psd_init
+(
+    welch_psd *psd
+    ,unsigned int samplerate
+    ,unsigned int segment_length
+    ,unsigned int hop
+)
+{
+    unsigned int i;
+
+    if(!psd || !samplerate || segment_length < 2 || !hop || hop > segment_length)
+    {
+        return -1;
+    }
+
+    memset(psd, 0, sizeof(*psd));
+    psd->samplerate = samplerate;
+    psd->segment_length = segment_length;
+    psd->hop = hop;
+    psd->num_bins = segment_length / 2 + 1;
+    psd->full_scale = 1.0;
+
+    psd->p_window = (double *) malloc(sizeof(double) * segment_length);
+    psd->p_ring = (double *) malloc(sizeof(double) * segment_length);
+    psd->p_segment = (double *) fftw_malloc(sizeof(double) * segment_length);
+    psd->p_spec = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * psd->num_bins);
+    psd->p_mean = (double *) malloc(sizeof(double) * psd->num_bins);
+
+    if(!psd->p_window || !psd->p_ring || !psd->p_segment || !psd->p_spec || !psd->p_mean)
+    {
+        welch_psd_close(psd);
+        return -1;
+    }
+
+    psd->plan = fftw_plan_dft_r2c_1d((int) segment_length, psd->p_segment, psd->p_spec, FFTW_ESTIMATE);
+    if(!psd->plan)
+    {
+        welch_psd_close(psd);
+        return -1;
+    }
+
+    /* Periodic Hann: overlaps to a constant at 50% hop */
+    for(i = 0; i < segment_length; ++i)
+    {
+        psd->p_window[i] = 0.5 * (1.0 - cos(2 * M_PI * i / segment_length));
+        psd->window_sum += psd->p_window[i];
+        psd->window_energy += psd->p_window[i] * psd->p_window[i];
+    }
+
+    welch_psd_reset(psd);
+
+    return 0;
+}
+
+void welch_psd_close(welch_psd *psd)
+{
+    if(!psd)
+    {
+        return;
+    }
+
+    if(psd->plan)
+    {
+        fftw_destroy_plan(psd->plan);
+    }
+    free(psd->p_window);
+    free(psd->p_ring);
+    fftw_free(psd->p_segment);
+    fftw_free(psd->p_spec);
+    free(psd->p_mean);
+    memset(psd, 0, sizeof(*psd));
+}
+
+void welch_psd_reset(welch_psd *psd)
+{
+    memset(psd->p_ring, 0, sizeof(double) * psd->segment_length);
+    memset(psd->p_mean, 0, sizeof(double) * psd->num_bins);
+    psd->ring_pos = 0;
+    psd->since_segment = 0;
+    psd->samples_seen = 0;
+    psd->num_segments = 0;
+}
+
+void welch_psd_process
+(
+    welch_psd *psd
+    ,const float *input
+    ,unsigned long framesPerBuffer
+)
+{
+    unsigned long i;
+
+    for(i = 0; i < framesPerBuffer; ++i)
+    {
+        psd->p_ring[psd->ring_pos] = input[i];
+        if(++psd->ring_pos == psd->segment_length)
+        {
+            psd->ring_pos = 0;
+        }
+        ++psd->samples_seen;
+
+        /* First segment once the ring is full, then every hop */
+        if(++psd->since_segment >= psd->hop && psd->samples_seen >= psd->segment_length)
+        {
+            welch_psd_segment(psd);
+            psd->since_segment = 0;
+        }
+    }
+}
+
+unsigned long welch_psd_estimate
+(
+    const welch_psd *psd
+    ,welch_psd_units units
+    ,double *p_out
+)
+{
+    unsigned int k;
+    double scale, ref;
+    const unsigned int last = psd->num_bins - 1;
+
+    if(!psd->num_segments)
+    {
+        return 0;
+    }
+
+    /**
+     *  One sided: every bin but DC and Nyquist (N even) stands
+     *  for two, so gets doubled.
+     *      PSD    = 2 |X|^2 / (fs * sum(w^2))
+     *      power  = 2 |X|^2 / sum(w)^2, a sine of amplitude A
+     *               giving A^2 / 2 in its bin
+    **/
+    if(units == WELCH_PSD_DBFS)
+    {
+        ref = psd->full_scale * psd->full_scale / 2.0;
+        scale = 2.0 / (psd->window_sum * psd->window_sum * ref);
+    }
+    else
+    {
+        scale = 2.0 / (psd->samplerate * psd->window_energy);
+    }
+
+    for(k = 0; k < psd->num_bins; ++k)
+    {
+        p_out[k] = scale * psd->p_mean[k];
+    }
+    p_out[0] *= 0.5;
+    if(psd->segment_length % 2 == 0)
+    {
+        p_out[last] *= 0.5;
+    }
+
+    if(units != WELCH_PSD_LINEAR)
+    {
+        for(k = 0; k < psd->num_bins; ++k)
+        {
+            p_out[k] = 10.0 * log10(p_out[k] + WELCH_PSD_FLOOR);
+        }
+    }
+
+    return psd->num_segments;
+}
+
+/**
+ *  Window the newest segment out of the ring, transform it and
+ *  fold |X|^2 into the running mean
+**/
+static void welch_psd_segment(welch_psd *psd)
+{
+    unsigned int i, k;
+    const unsigned int n = psd->segment_length;
+    const unsigned int first = n - psd->ring_pos;
+    double inv, power;
+
+    /* ring_pos is the oldest sample; unroll in two runs */
+    for(i = 0; i < first; ++i)
+    {
+        psd->p_segment[i] = psd->p_ring[psd->ring_pos + i] * psd->p_window[i];
+    }
+    for(i = first; i < n; ++i)
+    {
+        psd->p_segment[i] = psd->p_ring[i - first] * psd->p_window[i];
+    }
+
+    fftw_execute(psd->plan);
+
+    ++psd->num_segments;
+    inv = 1.0 / psd->num_segments;
+    for(k = 0; k < psd->num_bins; ++k)
+    {
+        power = psd->p_spec[k][0] * psd->p_spec[k][0] + psd->p_spec[k][1] * psd->p_spec[k][1];
+        psd->p_mean[k] += (power - psd->p_mean[k]) * inv;
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef WELCH_PSD_H
+#define WELCH_PSD_H
+
+#include "fftw3.h"
+
+typedef enum
+{
+    /** One sided power spectral density, V^2/Hz **/
+    WELCH_PSD_LINEAR    = 0,
+    /** 10 * log10 of the above, dB re 1 V^2/Hz **/
+    WELCH_PSD_DB        = 1,
+    /**
+     * Power spectrum in dB relative to a full scale sine:
+     * a sine of amplitude full_scale reads 0 dBFS in its
+     * bin, independent of FFT size and window
+    **/
+    WELCH_PSD_DBFS      = 2
+
+} welch_psd_units;
+
+typedef struct
+{
+    unsigned int samplerate;
+    unsigned int segment_length;
+    unsigned int hop;
+    unsigned int num_bins;
+
+    /**
+     * Periodic Hann window with its sum and sum of squares,
+     * used to undo its gain (dBFS) and noise bandwidth (PSD)
+    **/
+    double *p_window;
+    double window_sum;
+    double window_energy;
+
+    /**
+     * Last segment_length input samples.  A segment is taken
+     * every hop samples once the ring has filled
+    **/
+    double *p_ring;
+    unsigned int ring_pos;
+    unsigned int since_segment;
+    unsigned long samples_seen;
+
+    double *p_segment;
+    fftw_complex *p_spec;
+    fftw_plan plan;
+
+    /**
+     * Running mean of |X|^2 over all segments so far.
+     * Updated in place, so averaging forever needs no
+     * more memory than one segment
+    **/
+    double *p_mean;
+    unsigned long num_segments;
+
+    /** Amplitude that reads 0 dBFS, 1.0 for float audio **/
+    double full_scale;
+
+} welch_psd;
+
+/** ------------------------------------------
+ *  welch_psd_init
+ *  ------------------------------------------
+ *      Segments of segment_length samples taken
+ *      every hop samples (hop < segment_length
+ *      overlaps them; segment_length / 2 is
+ *      the usual choice).
+ *      Returns 0 on success, -1 on failure
+ *  ==========================================
+**/
+int welch_psd_init
+(
+    welch_psd *psd
+    ,unsigned int samplerate
+    ,unsigned int segment_length
+    ,unsigned int hop
+);
+
+/** ------------------------------------------
+ *  welch_psd_close
+ *  ------------------------------------------
+ *      Destroys the plan and frees buffers
+ *  ==========================================
+**/
+void welch_psd_close(welch_psd *psd);
+
+/** ------------------------------------------
+ *  welch_psd_reset
+ *  ------------------------------------------
+ *      Restarts the average
+ *  ==========================================
+**/
+void welch_psd_reset(welch_psd *psd);
+
+/** ----------------------------------------------------
+ *  welch_psd_process
+ *  ----------------------------------------------------
+ *      Feeds samples; every completed segment is
+ *      folded into the running average
+ *  ====================================================
+**/
+void welch_psd_process
+(
+    welch_psd *psd
+    ,const float *input
+    ,unsigned long framesPerBuffer
+);
+
+/** ----------------------------------------------------
+ *  welch_psd_estimate
+ *  ----------------------------------------------------
+ *      Writes num_bins values of the current average
+ *      in the requested units to p_out.  Returns the
+ *      number of segments averaged (0 means p_out was
+ *      not written)
+ *  ====================================================
+**/
+unsigned long welch_psd_estimate
+(
+    const welch_psd *psd
+    ,welch_psd_units units
+    ,double *p_out
+);
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ *  Offline spectra for a set of raw mono float32 recordings,
+ *  sharded over a thread pool.  Writes <file>.spec next to
+ *  each input and prints throughput and per worker load:
+ *
+ *      fft_batch_run -j 8 -n 4096 -h 1024 take1.f32 take2.f32
+ *
+ *  -p compact|spread pins workers and their buffers to NUMA
+ *  nodes; -N gives the node nearest each input, in order:
+ *
+ *      fft_batch_run -j 32 -p spread -N 0,1 sock0.f32 sock1.f32
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "batch_driver.h"
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-j threads] [-n fft_length] [-h hop] [-s shard_frames]"
+                    " [-p none|compact|spread] [-N node,node,...] file...\n", name);
+}
+
+/* Comma separated nodes, -1 for none.  Returns how many were read */
+static unsigned int parse_nodes(const char *list, int *p_nodes, unsigned int max)
+{
+    unsigned int count = 0;
+    char *p_end;
+
+    while(*list && count < max)
+    {
+        p_nodes[count++] = (int) strtol(list, &p_end, 10);
+        if(p_end == list || (*p_end && *p_end != ','))
+        {
+            return 0;
+        }
+        list = *p_end ? p_end + 1 : p_end;
+    }
+
+    return count;
+}
+
+int main(int argc, char * argv[])
+{
+    int opt;
+    unsigned int i, num_files, num_nodes = 0;
+    const char *p_node_list = NULL;
+    int *p_nodes = NULL;
+    int status = 0;
+    batch_driver_config config;
+    batch_driver_stats stats;
+    double seconds;
+
+    batch_driver_default_config(&config);
+
+    while((opt = getopt(argc, argv, "j:n:h:s:p:N:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'j': config.num_threads = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'n': config.frame_length = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'h': config.hop = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 's': config.shard_frames = (unsigned int) strtoul(optarg, NULL, 10); break;
+            case 'p':
+                if(placement_parse_policy(optarg, &config.placement))
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'N': p_node_list = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    if(optind >= argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    num_files = (unsigned int) (argc - optind);
+    if(p_node_list)
+    {
+        p_nodes = (int *) malloc(sizeof(int) * num_files);
+        num_nodes = p_nodes ? parse_nodes(p_node_list, p_nodes, num_files) : 0;
+        if(num_nodes != num_files)
+        {
+            fprintf(stderr, "-N needs one node per file\n");
+            free(p_nodes);
+            return 1;
+        }
+        config.p_file_nodes = p_nodes;
+    }
+
+    status = batch_driver_run(&config, (const char * const *) (argv + optind), num_files, &stats);
+    free(p_nodes);
+    if(status)
+    {
+        fprintf(stderr, "batch run failed\n");
+        return 1;
+    }
+
+    seconds = stats.wall_seconds > 0.0 ? stats.wall_seconds : 1e-9;
+    printf("%lu files  %lu shards  %lu frames in %.3f s\n", stats.files, stats.shards, stats.frames, seconds);
+    printf("%.0f frames/s  %.1f MB/s in\n", stats.frames / seconds, stats.bytes_read / seconds / 1e6);
+
+    for(i = 0; i < stats.num_workers; ++i)
+    {
+        printf("worker %2u  cpu %4d  node %2d  %5lu shards (%lu remote)  %8lu frames  busy %5.1f%%\n", i
+               ,stats.workers[i].cpu, stats.workers[i].node
+               ,stats.workers[i].shards, stats.workers[i].remote_shards, stats.workers[i].frames
+               ,100.0 * stats.workers[i].busy_seconds / seconds);
+    }
+
+    return 0;
+}
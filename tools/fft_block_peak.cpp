@@ -0,0 +1,94 @@
+/**
+ *  Prints the peak of every 65536 point frame of raw float32
+ *  mono PCM read from stdin, using the header-only FftBlock
+ *  template.  With -f the single precision block is used
+ *  (only when built against fftw3f):
+ *
+ *      sox in.wav -t f32 -c 1 - | fft_block_peak -r 48000
+**/
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "fft_block.hpp"
+
+namespace
+{
+
+/* fft_block's default length, so the largest common size is compiled */
+const std::size_t PEAK_FFT_LENGTH = 65536;
+const std::size_t PEAK_READ_FRAMES = 512;
+
+void usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s [-r samplerate] [-f] < pcm.f32\n", name);
+}
+
+/**
+ *  Feeds stdin through block and prints one line per spectrum
+**/
+template <typename Block>
+int run(Block &block)
+{
+    float in[PEAK_READ_FRAMES], out[PEAK_READ_FRAMES];
+    std::size_t got, k, peak;
+    unsigned long frames = 0;
+
+    while((got = std::fread(in, sizeof(float), PEAK_READ_FRAMES, stdin)) > 0)
+    {
+        if(!block.process(in, out, got))
+        {
+            continue;
+        }
+
+        for(peak = 1, k = 2; k < Block::fft_length; ++k)
+        {
+            if(block.magnitude()[k] > block.magnitude()[peak])
+            {
+                peak = k;
+            }
+        }
+        std::printf("%lu %.1f Hz %.1f dB\n", frames++, static_cast<double>(block.freq_bins()[peak]),
+                    static_cast<double>(block.magnitude()[peak]));
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int opt, b_float = 0;
+    unsigned int samplerate = 48000;
+
+    while((opt = getopt(argc, argv, "r:f")) != -1)
+    {
+        switch(opt)
+        {
+        case 'r': samplerate = static_cast<unsigned int>(std::strtoul(optarg, NULL, 10)); break;
+        case 'f': b_float = 1; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+
+    if(!samplerate || optind != argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(b_float)
+    {
+#ifdef FFT_BLOCK_PEAK_FLOAT
+        static fft_block::FftBlock<PEAK_FFT_LENGTH, float> block(samplerate);
+        return run(block);
+#else
+        std::fprintf(stderr, "Built without fftw3f, -f is not available\n");
+        return 1;
+#endif
+    }
+
+    static fft_block::FftBlock<PEAK_FFT_LENGTH> block(samplerate);
+    return run(block);
+}
@@ -0,0 +1,106 @@
+/**
+ *  Prints the frames of a spectrogram archive between two
+ *  times (seconds since the epoch, fractions allowed), one
+ *  line per frame with its peak.  With -a every bin is
+ *  printed instead.  Seeking is by the index, so only the
+ *  chunks in range are decoded:
+ *
+ *      spec_archive_cat -f 1760000000 -t 1760000060 fft_block.arc
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "spec_archive.h"
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-f from_s] [-t to_s] [-a] archive\n", name);
+}
+
+int main(int argc, char * argv[])
+{
+    int opt, b_all = 0;
+    unsigned int k, peak;
+    uint64_t from_ns = 0, to_ns = UINT64_MAX, t;
+    unsigned long long frames = 0, stored = 0;
+    uint64_t c;
+    spec_archive_reader reader;
+    spec_archive_pos pos;
+    double *p_db;
+
+    while((opt = getopt(argc, argv, "f:t:a")) != -1)
+    {
+        switch(opt)
+        {
+        case 'f': from_ns = (uint64_t) (strtod(optarg, NULL) * 1e9); break;
+        case 't': to_ns = (uint64_t) (strtod(optarg, NULL) * 1e9); break;
+        case 'a': b_all = 1; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+
+    if(optind != argc - 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(spec_archive_reader_open(&reader, argv[optind]))
+    {
+        fprintf(stderr, "Cannot open archive %s\n", argv[optind]);
+        return 1;
+    }
+
+    for(c = 0; c < reader.num_chunks; ++c)
+    {
+        stored += reader.p_index[c].num_frames;
+    }
+    printf("# %u bins, %llu frames in %llu chunks, %.2f dB steps above %.1f dB, %.1f bytes per frame\n",
+           reader.bins, stored, (unsigned long long) reader.num_chunks, reader.step_db, reader.floor_db,
+           stored ? (double) reader.data_bytes / stored : 0.0);
+
+    p_db = (double *) malloc(sizeof(double) * reader.bins);
+    if(p_db && spec_archive_reader_seek(&reader, from_ns, &pos) == 0)
+    {
+        do
+        {
+            if(spec_archive_reader_get(&reader, &pos, p_db, &t) < 0)
+            {
+                fprintf(stderr, "Corrupt chunk %llu\n", (unsigned long long) pos.chunk);
+                break;
+            }
+            if(t > to_ns)
+            {
+                break;
+            }
+
+            printf("%llu.%09llu", (unsigned long long) (t / 1000000000u), (unsigned long long) (t % 1000000000u));
+            if(b_all)
+            {
+                for(k = 0; k < reader.bins; ++k)
+                {
+                    printf(" %.1f", p_db[k]);
+                }
+            }
+            else
+            {
+                for(peak = 0, k = 1; k < reader.bins; ++k)
+                {
+                    peak = p_db[k] > p_db[peak] ? k : peak;
+                }
+                printf("  peak bin %u %.1f dB", peak, p_db[peak]);
+            }
+            printf("\n");
+            ++frames;
+        }
+        while(spec_archive_reader_next(&reader, &pos) == 0);
+    }
+
+    fprintf(stderr, "%llu frames\n", frames);
+
+    free(p_db);
+    spec_archive_reader_close(&reader);
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ *  Minimal subscriber for the spectrum publisher.  Connects to
+ *  the socket given on the command line and prints one line per
+ *  frame received.  Handy for checking a publisher locally:
+ *
+ *      spectrum_sub /tmp/fft_block.sock
+**/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "spectrum_pub.h"
+
+#define SUB_BUFFER_BYTES    (1 << 20)
+
+static unsigned char buffer[SUB_BUFFER_BYTES];
+
+static unsigned int quant_code(const spectrum_pub_quant *quant, spec_quant_width width, unsigned int k)
+{
+    return width == SPEC_QUANT_U8 ? ((const uint8_t *) (quant + 1))[k] : ((const uint16_t *) (quant + 1))[k];
+}
+
+static void print_frame(const spectrum_pub_header *header, const void *payload)
+{
+    const spectral_features *features;
+    const spectrum_pub_quant *quant;
+    const spec_quant_width width = header->type == SPECTRUM_PUB_SPECTRUM_U8 ? SPEC_QUANT_U8 : SPEC_QUANT_U16;
+    unsigned int k, peak = 0;
+    double level;
+
+    printf("seq %u  t %llu ns  type %u  %u bytes", header->sequence,
+           (unsigned long long) header->timestamp_ns, header->type, header->payload_bytes);
+
+    if(header->type == SPECTRUM_PUB_FEATURES && header->payload_bytes == sizeof(*features))
+    {
+        features = (const spectral_features *) payload;
+        printf("  centroid %.1f Hz  rms %.4f", features->centroid, features->rms);
+        if(features->num_peaks)
+        {
+            printf("  peak %.1f Hz %.1f dB", features->peaks[0].freq, features->peaks[0].level);
+        }
+    }
+
+    if((header->type == SPECTRUM_PUB_SPECTRUM_U8 || header->type == SPECTRUM_PUB_SPECTRUM_U16)
+       && header->payload_bytes >= sizeof(*quant))
+    {
+        quant = (const spectrum_pub_quant *) payload;
+        if(sizeof(*quant) + width * quant->bins <= header->payload_bytes)
+        {
+            /* Codes are monotonic in dB: find the largest, decode only it */
+            for(k = 1; k < quant->bins; ++k)
+            {
+                if(quant_code(quant, width, k) > quant_code(quant, width, peak))
+                {
+                    peak = k;
+                }
+            }
+            level = quant->params.offset + quant->params.scale * quant_code(quant, width, peak);
+            printf("  %u bins  peak bin %u %.2f dB  step %.4f dB", quant->bins, peak, level, quant->params.scale);
+        }
+    }
+
+    printf("\n");
+}
+
+int main(int argc, const char * argv[])
+{
+    int fd;
+    struct sockaddr_un addr;
+    size_t have = 0;
+    ssize_t n;
+    long used;
+    spectrum_pub_header header;
+    const void *payload;
+
+    if(argc != 2 || strlen(argv[1]) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "usage: %s <socket path>\n", argv[0]);
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, argv[1]);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        return 1;
+    }
+
+    while((n = read(fd, buffer + have, sizeof(buffer) - have)) > 0)
+    {
+        have += (size_t) n;
+
+        /* Decode every complete frame, keep the partial tail */
+        while((used = spectrum_pub_parse(buffer, have, &header, &payload)) > 0)
+        {
+            print_frame(&header, payload);
+            memmove(buffer, buffer + used, have - (size_t) used);
+            have -= (size_t) used;
+        }
+
+        if(used < 0)
+        {
+            fprintf(stderr, "corrupt stream or unsupported version\n");
+            break;
+        }
+    }
+
+    close(fd);
+    return 0;
+}